@@ -0,0 +1,403 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Microbenchmark of the generic containers in src/lib that every compiler phase
+// is built on. It times vector pushes and reads; map insertions, hits, and
+// misses at several load factors and key lengths; removal churn on a map whose
+// size stays fixed; graph insertions and searches at the vertex counts of real
+// import graphs; and channel throughput for 1 to 8 producers and consumers at
+// several buffer lengths. Results are printed to stdout as JSON in nanoseconds
+// per operation; the build script runs this file via the bench rule and merges
+// the output into its report.
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "channel.h"
+#include "graph.h"
+#include "map.h"
+#include "vector.h"
+
+make_vector(uint64_t, Word, static)
+make_map(uint64_t, Word, static)
+make_graph(uint64_t, Vertex, static)
+make_channel(uint64_t, Word, static)
+
+static const size_t vector_sizes[] = {64, 4096, 262144};
+
+//the map rehashes once its load factor exceeds 0.5
+static const double load_factors[] = {0.125, 0.25, 0.375, 0.5};
+static const size_t key_lengths[] = {8, 32, 128};
+
+static const size_t graph_sizes[] = {16, 256, 4096};
+
+static const size_t workers[] = {1, 2, 4, 8};
+static const size_t buffers[] = {1, 16, 256};
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+#define VECTOR_PASSES 16
+#define MAP_CAPACITY ((size_t) 16384)
+#define MAP_CHURN ((size_t) 1 << 20)
+#define LOOKUPS ((size_t) 1 << 20)
+#define KEY_STRIDE ((size_t) 129)
+#define MESSAGES ((size_t) 1 << 16)
+
+static uint64_t Clock(void);
+static void CreateKeys(cstring *, const size_t, const size_t, uint64_t);
+static void Print(const char *, const char *, const size_t, const double);
+static void MeasureVector(void);
+static void MeasureMap(cstring *, cstring *);
+static void MeasureChurn(cstring *);
+static void MeasureGraph(cstring *, cstring *);
+static void MeasureChannel(void);
+static void *Produce(void *);
+static void *Consume(void *);
+
+//------------------------------------------------------------------------------
+
+static uint64_t Clock(void)
+{
+	struct timespec now = {0};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+//n lower-case keys of exactly len characters from an xorshift64 stream, each
+//in a slot of KEY_STRIDE bytes; streams with distinct seeds are disjoint in
+//practice and hence provide misses
+static void CreateKeys
+(
+	cstring *keys,
+	const size_t n,
+	const size_t len,
+	uint64_t seed
+)
+{
+	for (size_t i = 0; i < n; i++) {
+		cstring *key = keys + i * KEY_STRIDE;
+
+		for (size_t j = 0; j < len; j++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+
+			key[j] = (char) ('a' + seed % 26);
+		}
+
+		key[len] = '\0';
+	}
+}
+
+//prints one "group_operation": value entry of the report, opening a group
+//whenever the group changes
+static void Print
+(
+	const char *group,
+	const char *operation,
+	const size_t n,
+	const double value
+)
+{
+	static const char *prev = NULL;
+
+	if (prev != group) {
+		printf("%s\n\t\"%s\": {\n", prev ? "\n\t}," : "", group);
+		prev = group;
+	} else {
+		printf(",\n");
+	}
+
+	printf("\t\t\"%s_%zu\": %.2f", operation, n, value);
+}
+
+//the volatile sink keeps the reads from being discarded
+static volatile uint64_t sink = 0;
+
+//------------------------------------------------------------------------------
+
+//vectors start at the default capacity, as the parser's do, so the pushes
+//include every reallocation
+static void MeasureVector(void)
+{
+	for (size_t i = 0; i < COUNT(vector_sizes); i++) {
+		const size_t n = vector_sizes[i];
+		const size_t total = n * VECTOR_PASSES;
+		uint64_t push = 0;
+		uint64_t get = 0;
+		uint64_t sum = 0;
+
+		for (size_t pass = 0; pass < VECTOR_PASSES; pass++) {
+			const size_t cap = VECTOR_DEFAULT_CAPACITY;
+			vector(Word) words = WordVectorInit(0, cap);
+
+			uint64_t start = Clock();
+
+			for (size_t j = 0; j < n; j++) {
+				WordVectorPush(&words, j);
+			}
+
+			push += Clock() - start;
+			start = Clock();
+
+			for (size_t j = 0; j < n; j++) {
+				sum += WordVectorGet(&words, j);
+			}
+
+			get += Clock() - start;
+		}
+
+		sink += sum;
+
+		const double ops = (double) total;
+
+		Print("vector_ns_per_op", "push", n, (double) push / ops);
+		Print("vector_ns_per_op", "get", n, (double) get / ops);
+	}
+}
+
+//each table has MAP_CAPACITY slots and is filled to the load factor; entries
+//are named by the load factor in percent and the key length
+static void MeasureMap(cstring *keys, cstring *misses)
+{
+	for (size_t i = 0; i < COUNT(key_lengths); i++) {
+		const size_t len = key_lengths[i];
+
+		CreateKeys(keys, MAP_CAPACITY, len, 0x9E3779B97F4A7C15ULL);
+		CreateKeys(misses, MAP_CAPACITY, len, 0xD1B54A32D192ED03ULL);
+
+		for (size_t j = 0; j < COUNT(load_factors); j++) {
+			const double load = load_factors[j];
+			const size_t n = (size_t) (load * MAP_CAPACITY);
+			const size_t percent = (size_t) (load * 100);
+			map(Word) table = WordMapInit(MAP_CAPACITY);
+			char name[32] = {0};
+
+			uint64_t start = Clock();
+
+			for (size_t k = 0; k < n; k++) {
+				const cstring *key = keys + k * KEY_STRIDE;
+				(void) WordMapInsert(&table, key, k);
+			}
+
+			const double insert = (double) (Clock() - start) / (double) n;
+
+			(void) snprintf(name, sizeof(name), "insert_key%zu_load",
+					len);
+
+			Print("container_map_ns_per_op", name, percent, insert);
+
+			for (int pass = 0; pass < 2; pass++) {
+				const cstring *set = pass ? misses : keys;
+				uint64_t found = 0;
+				start = Clock();
+
+				for (size_t k = 0; k < LOOKUPS; k++) {
+					const cstring *key = set + (k % n) * KEY_STRIDE;
+					found += WordMapGet(&table, key, NULL);
+				}
+
+				const double ns = (double) (Clock() - start) / LOOKUPS;
+				sink += found;
+
+				(void) snprintf(name, sizeof(name), "%s_key%zu_load",
+						pass ? "miss" : "hit", len);
+
+				Print("container_map_ns_per_op", name, percent, ns);
+			}
+		}
+	}
+}
+
+//each round removes the oldest key and inserts a new one, so the table stays
+//at a load factor of 0.375 while removed slots accumulate and are compacted
+static void MeasureChurn(cstring *keys)
+{
+	CreateKeys(keys, MAP_CAPACITY, 16, 0x2545F4914F6CDD1DULL);
+
+	const size_t live = MAP_CAPACITY * 3 / 8;
+	map(Word) table = WordMapInit(MAP_CAPACITY);
+
+	for (size_t i = 0; i < live; i++) {
+		(void) WordMapInsert(&table, keys + i * KEY_STRIDE, i);
+	}
+
+	uint64_t removed = 0;
+	const uint64_t start = Clock();
+
+	for (size_t i = live; i < live + MAP_CHURN; i++) {
+		const size_t prev = (i - live) % MAP_CAPACITY;
+		const size_t next = i % MAP_CAPACITY;
+		const cstring *oldest = keys + prev * KEY_STRIDE;
+		const cstring *newest = keys + next * KEY_STRIDE;
+
+		removed += WordMapRemove(&table, oldest);
+		(void) WordMapInsert(&table, newest, i);
+	}
+
+	const double ns = (double) (Clock() - start) / MAP_CHURN;
+	sink += removed;
+
+	Print("container_map_ns_per_op", "churn_load", 37, ns);
+}
+
+//graphs grow from the default capacity as the dependency graph does
+static void MeasureGraph(cstring *keys, cstring *misses)
+{
+	CreateKeys(keys, MAP_CAPACITY, 8, 0x9E3779B97F4A7C15ULL);
+	CreateKeys(misses, MAP_CAPACITY, 8, 0xD1B54A32D192ED03ULL);
+
+	for (size_t i = 0; i < COUNT(graph_sizes); i++) {
+		const size_t n = graph_sizes[i];
+		graph(Vertex) net = VertexGraphInit();
+
+		uint64_t start = Clock();
+
+		for (size_t j = 0; j < n; j++) {
+			(void) VertexGraphInsert(&net, keys + j * KEY_STRIDE, j);
+		}
+
+		const double insert = (double) (Clock() - start) / (double) n;
+
+		Print("graph_ns_per_op", "insert", n, insert);
+
+		for (int pass = 0; pass < 2; pass++) {
+			const cstring *set = pass ? misses : keys;
+			uint64_t found = 0;
+			start = Clock();
+
+			for (size_t j = 0; j < LOOKUPS; j++) {
+				const cstring *key = set + (j % n) * KEY_STRIDE;
+				found += VertexGraphSearch(&net, key, NULL);
+			}
+
+			const double ns = (double) (Clock() - start) / LOOKUPS;
+			sink += found;
+
+			Print("graph_ns_per_op", pass ? "miss" : "hit", n, ns);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+
+//@total: messages sent or received by one thread
+typedef struct endpoint {
+	channel(Word) *chan;
+	size_t total;
+	uint64_t sum;
+} endpoint;
+
+//pthread_create argument
+static void *Produce(void *pthread_payload)
+{
+	endpoint *self = (endpoint *) pthread_payload;
+
+	for (size_t i = 0; i < self->total; i++) {
+		(void) WordChannelSend(self->chan, i);
+	}
+
+	return NULL;
+}
+
+//pthread_create argument
+static void *Consume(void *pthread_payload)
+{
+	endpoint *self = (endpoint *) pthread_payload;
+	uint64_t datum = 0;
+
+	for (size_t i = 0; i < self->total; i++) {
+		(void) WordChannelRecv(self->chan, &datum);
+		self->sum += datum;
+	}
+
+	return NULL;
+}
+
+//every configuration has as many consumers as producers; the channel is never
+//closed, since MESSAGES divides evenly among the threads and each consumer
+//knows how many messages it will receive. Entries are named by the thread
+//count on each side and the buffer length.
+static void MeasureChannel(void)
+{
+	const size_t most = workers[COUNT(workers) - 1];
+	endpoint producers[most];
+	endpoint consumers[most];
+	pthread_t threads[2 * most];
+
+	for (size_t i = 0; i < COUNT(workers); i++) {
+		const size_t n = workers[i];
+
+		for (size_t j = 0; j < COUNT(buffers); j++) {
+			channel(Word) chan;
+			WordChannelInit(&chan, buffers[j]);
+
+			const uint64_t start = Clock();
+			size_t created = 0;
+
+			for (size_t k = 0; k < n; k++) {
+				producers[k] = (endpoint) {&chan, MESSAGES / n, 0};
+				consumers[k] = (endpoint) {&chan, MESSAGES / n, 0};
+
+				created += !pthread_create(threads + created, NULL,
+							   Produce, producers + k);
+				created += !pthread_create(threads + created, NULL,
+							   Consume, consumers + k);
+			}
+
+			if (created != 2 * n) {
+				fprintf(stderr, "cannot create channel threads\n");
+				exit(1);
+			}
+
+			for (size_t k = 0; k < created; k++) {
+				(void) pthread_join(threads[k], NULL);
+			}
+
+			const double ns = (double) (Clock() - start) / MESSAGES;
+
+			for (size_t k = 0; k < n; k++) {
+				sink += consumers[k].sum;
+			}
+
+			(void) WordChannelShutdown(&chan);
+
+			char name[32] = {0};
+			(void) snprintf(name, sizeof(name), "threads%zu_cap", n);
+
+			Print("channel_ns_per_message", name, buffers[j], ns);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+	if (!ArenaInit(MiB(256))) {
+		fprintf(stderr, "cannot initialize arena\n");
+		return 1;
+	}
+
+	cstring *keys = allocate(MAP_CAPACITY * KEY_STRIDE);
+	cstring *misses = allocate(MAP_CAPACITY * KEY_STRIDE);
+
+	printf("{");
+
+	MeasureVector();
+	MeasureMap(keys, misses);
+	MeasureChurn(keys);
+	MeasureGraph(keys, misses);
+	MeasureChannel();
+
+	printf("\n\t}\n}\n");
+
+	ArenaFree();
+
+	return 0;
+}
@@ -0,0 +1,160 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Microbenchmark of the generated keyword recognizer in src/assets/kmap.c
+// against the gperf map it replaced, which is kept in bench/kmap_gperf.c. The
+// lexemes are laid out in a buffer separated by spaces as they would be in
+// source code, and they mix keywords with identifiers that share a keyword's
+// length, first character, or prefix. Both lookups must agree on every lexeme.
+// Results are printed to stdout as JSON in nanoseconds per lookup.
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "kmap.h"
+
+struct kv_pair { char *name; token_type typ; };
+
+const struct kv_pair *gperf_lookup(const char *str, size_t len);
+
+static const char *words[] = {
+	"for", "while", "break", "continue", "if", "else", "switch", "case",
+	"default", "fallthrough", "goto", "label", "let", "mut", "struct",
+	"import", "pub", "func", "method", "return", "null", "void", "self",
+	"true", "false",
+	"form", "whilst", "i", "elsewhere", "cast", "defaults", "fall", "got",
+	"lets", "mutable", "structure", "imports", "public", "fun", "methods",
+	"ret", "nil", "voids", "selfie", "tru", "f", "x", "node", "value",
+	"count", "buffer", "length", "index", "result", "left", "right", "tmp",
+	"capacity", "fallthrougi", "fallthroughs", "contains", "continued"
+};
+
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+#define LEXEMES ((size_t) 4096)
+#define PASSES 512
+
+typedef struct lexeme {
+	const char *view;
+	size_t len;
+} lexeme;
+
+static uint64_t Clock(void);
+static size_t CreateLexemes(cstring *text, lexeme *lexemes);
+static int Check(const lexeme *lexemes);
+
+//------------------------------------------------------------------------------
+
+static uint64_t Clock(void)
+{
+	struct timespec now = {0};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+//words are drawn from an xorshift64 stream; returns the keyword count
+static size_t CreateLexemes(cstring *text, lexeme *lexemes)
+{
+	uint64_t seed = 0x9E3779B97F4A7C15ULL;
+	size_t keywords = 0;
+
+	for (size_t i = 0; i < LEXEMES; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+
+		const char *word = words[seed % WORD_COUNT];
+		const size_t len = strlen(word);
+
+		memcpy(text, word, len);
+		text[len] = ' ';
+
+		lexemes[i] = (lexeme) {
+			.view = text,
+			.len = len
+		};
+
+		keywords += kmap_lookup(text, len) != _IDENTIFIER;
+		text += len + 1;
+	}
+
+	*text = '\0';
+
+	return keywords;
+}
+
+static int Check(const lexeme *lexemes)
+{
+	for (size_t i = 0; i < LEXEMES; i++) {
+		const lexeme lex = lexemes[i];
+		const struct kv_pair *kv = gperf_lookup(lex.view, lex.len);
+		const token_type expected = kv ? kv->typ : _IDENTIFIER;
+
+		if (kmap_lookup(lex.view, lex.len) != expected) {
+			fprintf(stderr, "mismatch on '%.*s'\n", (int) lex.len,
+				lex.view);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+//the volatile sink keeps the lookups from being discarded
+static volatile uint64_t sink = 0;
+
+int main(void)
+{
+	if (!ArenaInit(MiB(16))) {
+		fprintf(stderr, "cannot initialize arena\n");
+		return 1;
+	}
+
+	cstring *text = allocate(LEXEMES * 16);
+	lexeme *lexemes = allocate(sizeof(lexeme) * LEXEMES);
+	const size_t keywords = CreateLexemes(text, lexemes);
+
+	if (Check(lexemes)) {
+		ArenaFree();
+		return 1;
+	}
+
+	double results[2] = {0};
+
+	for (int pass = 0; pass < 2; pass++) {
+		uint64_t found = 0;
+		uint64_t start = Clock();
+
+		for (size_t j = 0; j < PASSES; j++) {
+			for (size_t i = 0; i < LEXEMES; i++) {
+				const lexeme lex = lexemes[i];
+
+				if (pass == 0) {
+					found += gperf_lookup(lex.view, lex.len)
+						 != NULL;
+				} else {
+					found += kmap_lookup(lex.view, lex.len)
+						 != _IDENTIFIER;
+				}
+			}
+		}
+
+		const double total = (double) LEXEMES * PASSES;
+		results[pass] = (double) (Clock() - start) / total;
+		sink += found;
+	}
+
+	printf("{\n\t\"kmap_ns_per_lookup\": {\n");
+	printf("\t\t\"keyword_fraction\": %.2f,\n",
+	       (double) keywords / (double) LEXEMES);
+	printf("\t\t\"gperf\": %.2f,\n", results[0]);
+	printf("\t\t\"generated\": %.2f\n", results[1]);
+	printf("\t}\n}\n");
+
+	ArenaFree();
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Microbenchmark of the two hash table backends, map.h and flatmap.h. Each
+// table is presized for its keys, as the symbol tables are, and filled with
+// identifiers shaped like those in Lemon source code. The inner loops then time
+// successful and failed lookups. Results are printed to stdout as JSON in
+// nanoseconds per operation; the build script runs this file via the bench
+// rule and merges the output into its report.
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "arena.h"
+#include "flatmap.h"
+#include "map.h"
+
+//same size as the symbol struct in symtable.h on x86-64; only its size matters
+typedef struct payload {
+	uint64_t words[8];
+} payload;
+
+make_map(payload, Linear, static)
+make_flatmap(payload, Flat, static)
+
+//table sizes bracket the symbol table of a small function up to the global
+//table of a large module
+static const uint64_t sizes[] = {8, 64, 512, 4096, 32768};
+
+#define SIZE_COUNT (sizeof(sizes) / sizeof(sizes[0]))
+#define KEY_LENGTH 16
+#define LOOKUPS ((uint64_t) 1 << 21)
+
+static uint64_t Clock(void);
+static void CreateKeys(cstring *keys, uint64_t n, uint64_t seed);
+static void Print(const char *name, uint64_t n, double *results);
+
+//------------------------------------------------------------------------------
+
+static uint64_t Clock(void)
+{
+	struct timespec now = {0};
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+//lower-case identifiers of 4 to 15 characters from an xorshift64 stream; two
+//streams with distinct seeds are disjoint in practice and hence provide misses
+static void CreateKeys(cstring *keys, uint64_t n, uint64_t seed)
+{
+	for (uint64_t i = 0; i < n; i++) {
+		cstring *key = keys + i * KEY_LENGTH;
+		uint64_t len = 4 + seed % (KEY_LENGTH - 4);
+
+		for (uint64_t j = 0; j < len; j++) {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+
+			key[j] = (char) ('a' + seed % 26);
+		}
+
+		key[len] = '\0';
+	}
+}
+
+//the volatile sink keeps the lookups from being discarded
+static volatile uint64_t sink = 0;
+
+//declares pfix##Measure, which times n insertions into a presized table and
+//then LOOKUPS hits and LOOKUPS misses; results holds the ns per operation
+#define make_measure(pfix)						       \
+static void pfix##Measure						       \
+(uint64_t n, const cstring *keys, const cstring *misses, double *results)      \
+{									       \
+	pfix##_map table = pfix##MapInit(MAP_MINIMUM_CAPACITY(n));	       \
+	const payload datum = {{0}};					       \
+	uint64_t start = Clock();					       \
+									       \
+	for (uint64_t i = 0; i < n; i++) {				       \
+		(void) pfix##MapInsert(&table, keys + i * KEY_LENGTH, datum);  \
+	}								       \
+									       \
+	results[0] = (double) (Clock() - start) / (double) n;		       \
+									       \
+	for (int pass = 1; pass <= 2; pass++) {				       \
+		const cstring *set = pass == 1 ? keys : misses;		       \
+		uint64_t found = 0;					       \
+		start = Clock();					       \
+									       \
+		for (uint64_t i = 0; i < LOOKUPS; i++) {		       \
+			const cstring *key = set + (i % n) * KEY_LENGTH;       \
+			found += pfix##MapGet(&table, key, NULL);	       \
+		}							       \
+									       \
+		results[pass] = (double) (Clock() - start) / LOOKUPS;	       \
+		sink += found;						       \
+	}								       \
+}
+
+make_measure(Linear)
+make_measure(Flat)
+
+static void Print(const char *name, uint64_t n, double *results)
+{
+	static const char *format = "\t\t\"%s_%s_%" PRIu64 "\": %.2f";
+	static const char *operations[] = {"insert", "hit", "miss"};
+	static bool first = true;
+
+	for (int i = 0; i < 3; i++) {
+		printf("%s\n", first ? "" : ",");
+		printf(format, name, operations[i], n, results[i]);
+		first = false;
+	}
+}
+
+int main(void)
+{
+	const uint64_t largest = sizes[SIZE_COUNT - 1];
+
+	if (!ArenaInit(MiB(256))) {
+		fprintf(stderr, "cannot initialize arena\n");
+		return 1;
+	}
+
+	cstring *keys = allocate(largest * KEY_LENGTH);
+	cstring *misses = allocate(largest * KEY_LENGTH);
+
+	CreateKeys(keys, largest, 0x9E3779B97F4A7C15ULL);
+	CreateKeys(misses, largest, 0xD1B54A32D192ED03ULL);
+
+	printf("{\n\t\"map_ns_per_op\": {");
+
+	for (size_t i = 0; i < SIZE_COUNT; i++) {
+		double linear[3] = {0};
+		double flat[3] = {0};
+
+		LinearMeasure(sizes[i], keys, misses, linear);
+		FlatMeasure(sizes[i], keys, misses, flat);
+
+		Print("map", sizes[i], linear);
+		Print("flatmap", sizes[i], flat);
+	}
+
+	printf("\n\t}\n}\n");
+
+	ArenaFree();
+
+	return 0;
+}
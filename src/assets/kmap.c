@@ -1,177 +1,138 @@
-#pragma GCC diagnostic push
-
-#pragma GCC diagnostic ignored "-Wconversion"
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Generated by kmap.py from keywords.txt; do not edit.
 
+#include <stdint.h>
 #include <string.h>
 
 #include "kmap.h"
 
-/* ANSI-C code produced by gperf version 3.1 */
-/* Command-line: gperf -t -C --null-strings --lookup-function-name=kmap_lookup keywords.txt  */
-/* Computed positions: -k'1-2' */
-
-#if !((' ' == 32) && ('!' == 33) && ('"' == 34) && ('#' == 35) \
-      && ('%' == 37) && ('&' == 38) && ('\'' == 39) && ('(' == 40) \
-      && (')' == 41) && ('*' == 42) && ('+' == 43) && (',' == 44) \
-      && ('-' == 45) && ('.' == 46) && ('/' == 47) && ('0' == 48) \
-      && ('1' == 49) && ('2' == 50) && ('3' == 51) && ('4' == 52) \
-      && ('5' == 53) && ('6' == 54) && ('7' == 55) && ('8' == 56) \
-      && ('9' == 57) && (':' == 58) && (';' == 59) && ('<' == 60) \
-      && ('=' == 61) && ('>' == 62) && ('?' == 63) && ('A' == 65) \
-      && ('B' == 66) && ('C' == 67) && ('D' == 68) && ('E' == 69) \
-      && ('F' == 70) && ('G' == 71) && ('H' == 72) && ('I' == 73) \
-      && ('J' == 74) && ('K' == 75) && ('L' == 76) && ('M' == 77) \
-      && ('N' == 78) && ('O' == 79) && ('P' == 80) && ('Q' == 81) \
-      && ('R' == 82) && ('S' == 83) && ('T' == 84) && ('U' == 85) \
-      && ('V' == 86) && ('W' == 87) && ('X' == 88) && ('Y' == 89) \
-      && ('Z' == 90) && ('[' == 91) && ('\\' == 92) && (']' == 93) \
-      && ('^' == 94) && ('_' == 95) && ('a' == 97) && ('b' == 98) \
-      && ('c' == 99) && ('d' == 100) && ('e' == 101) && ('f' == 102) \
-      && ('g' == 103) && ('h' == 104) && ('i' == 105) && ('j' == 106) \
-      && ('k' == 107) && ('l' == 108) && ('m' == 109) && ('n' == 110) \
-      && ('o' == 111) && ('p' == 112) && ('q' == 113) && ('r' == 114) \
-      && ('s' == 115) && ('t' == 116) && ('u' == 117) && ('v' == 118) \
-      && ('w' == 119) && ('x' == 120) && ('y' == 121) && ('z' == 122) \
-      && ('{' == 123) && ('|' == 124) && ('}' == 125) && ('~' == 126))
-/* The character set is not based on ISO-646.  */
-#error "gperf generated tables don't work with this execution character set. Please report a bug to <bug-gperf@gnu.org>."
-#endif
+#define MAX_WORD_LENGTH 11
+#define MULTIPLIER UINT64_C(0xc4cb70b5b651035b)
+#define SHIFT 58
 
-#line 1 "keywords.txt"
+//smallest page size on any supported target
+#define PAGE_SIZE ((uintptr_t) 4096)
 
-#include "kmap.h"
-#line 4 "keywords.txt"
-//kv_pair defined in kmap.h
+//@head: first 8 bytes of the keyword as a little-endian word
+//@tail: remaining bytes, if any, in the same form
+//@len: zero in a slot without a keyword
+typedef struct slot {
+	uint64_t head;
+	uint64_t tail;
+	size_t len;
+	token_type type;
+} slot;
 
-#define TOTAL_KEYWORDS 25
-#define MIN_WORD_LENGTH 2
-#define MAX_WORD_LENGTH 11
-#define MIN_HASH_VALUE 3
-#define MAX_HASH_VALUE 39
-/* maximum key range = 37, duplicates = 0 */
-
-#ifdef __GNUC__
-__inline
-#else
-#ifdef __cplusplus
-inline
-#endif
-#endif
-static unsigned int
-hash (register const char *str, register size_t len)
+static const slot slots[] = {
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x6e7275746572), 0, 6, _RETURN},
+	{UINT64_C(0x746375727473), 0, 6, _STRUCT},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x636e7566), 0, 4, _FUNC},
+	{UINT64_C(0x65756e69746e6f63), 0, 8, _CONTINUE},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x64696f76), 0, 4, _VOID},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x6f7268746c6c6166), UINT64_C(0x686775), 11, _FALLTHROUGH},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x627570), 0, 3, _PUB},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x6f746f67), 0, 4, _GOTO},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x74726f706d69), 0, 6, _IMPORT},
+	{UINT64_C(0x74656c), 0, 3, _LET},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x6b61657262), 0, 5, _BREAK},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x65736163), 0, 4, _CASE},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x65736c6166), 0, 5, _FALSE},
+	{UINT64_C(0x666c6573), 0, 4, _SELF},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x646f6874656d), 0, 6, _METHOD},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x6c6c756e), 0, 4, _NULL},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x6669), 0, 2, _IF},
+	{UINT64_C(0x65736c65), 0, 4, _ELSE},
+	{UINT64_C(0x726f66), 0, 3, _FOR},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x74756d), 0, 3, _MUT},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x6c6562616c), 0, 5, _LABEL},
+	{0, 0, 0, _IDENTIFIER},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x746c7561666564), 0, 7, _DEFAULT},
+	{0, 0, 0, _IDENTIFIER},
+	{UINT64_C(0x656c696877), 0, 5, _WHILE},
+	{UINT64_C(0x686374697773), 0, 6, _SWITCH},
+	{UINT64_C(0x65757274), 0, 4, _TRUE},
+	{0, 0, 0, _IDENTIFIER},
+};
+
+//returns the n <= 8 bytes at str as a little-endian word with the high bytes
+//cleared. A full word is read unless it would cross a page boundary; bytes
+//past the lexeme on the same page are always readable, even when the source is
+//an mmap that ends on that page.
+static inline uint64_t Load(const char *str, const size_t n)
 {
-  static const unsigned char asso_values[] =
-    {
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40,  0,  0, 20,
-       0,  0,  5, 30,  0, 20, 40, 40,  0,  0,
-      25,  5, 10, 40, 15,  5,  0,  5, 20, 20,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
-      40, 40, 40, 40, 40, 40
-    };
-  return len + asso_values[(unsigned char)str[1]] + asso_values[(unsigned char)str[0]];
+	uint64_t word = 0;
+
+	if (((uintptr_t) str & (PAGE_SIZE - 1)) <= PAGE_SIZE - sizeof(word)) {
+		memcpy(&word, str, sizeof(word));
+	} else {
+		memcpy(&word, str, n);
+	}
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
+
+	if (n < sizeof(word)) {
+		word &= (UINT64_C(1) << (8 * n)) - 1;
+	}
+
+	return word;
 }
 
-const struct kv_pair *
-kmap_lookup (register const char *str, register size_t len)
+token_type kmap_lookup(const char *str, size_t len)
 {
-  static const struct kv_pair wordlist[] =
-    {
-      {(char*)0}, {(char*)0}, {(char*)0},
-#line 18 "keywords.txt"
-      {"let", _LET},
-#line 11 "keywords.txt"
-      {"else", _ELSE,},
-#line 17 "keywords.txt"
-      {"label", _LABEL},
-#line 24 "keywords.txt"
-      {"method", _METHOD},
-#line 14 "keywords.txt"
-      {"default", _DEFAULT},
-#line 19 "keywords.txt"
-      {"mut", _MUT},
-#line 28 "keywords.txt"
-      {"self", _SELF},
-#line 30 "keywords.txt"
-      {"false", _FALSE},
-#line 20 "keywords.txt"
-      {"struct", _STRUCT},
-      {(char*)0},
-#line 6 "keywords.txt"
-      {"for", _FOR},
-#line 23 "keywords.txt"
-      {"func", _FUNC},
-      {(char*)0},
-#line 15 "keywords.txt"
-      {"fallthrough", _FALLTHROUGH},
-      {(char*)0},
-#line 22 "keywords.txt"
-      {"pub", _PUB},
-#line 29 "keywords.txt"
-      {"true", _TRUE},
-#line 8 "keywords.txt"
-      {"break", _BREAK,},
-#line 25 "keywords.txt"
-      {"return", _RETURN},
-      {(char*)0}, {(char*)0},
-#line 13 "keywords.txt"
-      {"case", _CASE},
-#line 7 "keywords.txt"
-      {"while", _WHILE,},
-#line 21 "keywords.txt"
-      {"import", _IMPORT},
-#line 10 "keywords.txt"
-      {"if", _IF},
-      {(char*)0},
-#line 27 "keywords.txt"
-      {"void", _VOID},
-      {(char*)0},
-#line 12 "keywords.txt"
-      {"switch", _SWITCH},
-      {(char*)0},
-#line 9 "keywords.txt"
-      {"continue", _CONTINUE,},
-#line 26 "keywords.txt"
-      {"null", _NULL},
-      {(char*)0}, {(char*)0}, {(char*)0}, {(char*)0},
-#line 16 "keywords.txt"
-      {"goto", _GOTO}
-    };
-
-  if (len <= MAX_WORD_LENGTH && len >= MIN_WORD_LENGTH)
-    {
-      register unsigned int key = hash (str, len);
-
-      if (key <= MAX_HASH_VALUE)
-        {
-          register const char *s = wordlist[key].name;
-
-          if (s && !strncmp(str, s, len))
-            return &wordlist[key];
-        }
-    }
-  return 0;
-}
+	if (len > MAX_WORD_LENGTH) {
+		return _IDENTIFIER;
+	}
+
+	const size_t first = len < sizeof(uint64_t) ? len : sizeof(uint64_t);
+	const uint64_t word = Load(str, first);
+	const slot *entry = &slots[(word * MULTIPLIER) >> SHIFT];
 
+	if (entry->head != word || entry->len != len) {
+		return _IDENTIFIER;
+	}
 
-#pragma GCC diagnostic pop
+	if (len > first && Load(str + first, len - first) != entry->tail) {
+		return _IDENTIFIER;
+	}
+
+	return entry->type;
+}
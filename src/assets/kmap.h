@@ -1,6 +1,6 @@
 // Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
 //
-// Encapsulation for the gperf auto-generated C code.
+// Keyword recognizer generated by kmap.py.
 
 #pragma once
 
@@ -8,9 +8,7 @@
 
 #include <stddef.h>
 
-typedef struct kv_pair {
-	char *name;
-	token_type typ;
-} kv_pair;
-
-const struct kv_pair *kmap_lookup(const char *str, size_t len);
+//returns the keyword token type of the len bytes at str, or _IDENTIFIER if they
+//are not a keyword. Up to 8 bytes past the lexeme may be read, but never past
+//the page which holds its final byte.
+token_type kmap_lookup(const char *str, size_t len);
@@ -2,76 +2,166 @@
 
 # Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
 #
-# The C code generated by gperf has a few issues. It triggers the -Wconversion
-# error during compilation. It redelcares the struct defined in the kmap API.
-# It uses strcmp() which will not work with the scanner's pointer to the
-# in-memory source code. And, it doesn't include the string.h header file. This
-# script fixes all of these issues.
+# Generates kmap.c, the keyword recognizer used by the scanner, from the keyword
+# list in keywords.txt. The first 8 bytes of a lexeme are loaded as one masked
+# little-endian word and hashed with a single multiply; the multiplier is found
+# here so that no two keywords share a slot. A lexeme is then a keyword only if
+# its word and length match the slot, plus a second word for keywords longer
+# than 8 bytes. Unlike the gperf map which it replaced there is no string table
+# and no strncmp, and unlike a switch on length and first character there are
+# no indirect jumps to mispredict.
+#
+# keywords.txt retains the gperf input format; only the lines after the %%
+# separator are read, each of the form "keyword, token_type".
 
-from subprocess import run
+from random import Random
 
-# the code generated by gperf may be different depending on the version so we
-# check that gperf is at version 3.1.
-def check_gperf() -> None:
-    cmd = "gperf --version"
-    proc_status = run(cmd, check=True, shell=True, capture_output=True)
+word_size = 8
+word_mask = (1 << 64) - 1
+search_seed = 2021
+search_attempts = 100000
 
-    version = proc_status.stdout.decode()
+header = """\
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Generated by kmap.py from keywords.txt; do not edit.
 
-    flag = version.find("3.1", 0, version.find('\n'))
+#include <stdint.h>
+#include <string.h>
 
-    if flag == -1:
-        raise ValueError("gperf is not version 3.1")
+#include "kmap.h"
 
-# execute gperf on the shell and capture the generated C code from stdout.
-# stdout is captured as a python bytes object, hence the decode call.
-def exec_gperf() -> str:
-    options = "-t -C --null-strings"
-    hashname = "--lookup-function-name=kmap_lookup"
-    input = "keywords.txt"
-    cmd = "gperf {} {} {}".format(options, hashname, input)
+#define MAX_WORD_LENGTH {0}
+#define MULTIPLIER UINT64_C(0x{1:x})
+#define SHIFT {2}
 
-    proc_status = run(cmd, check=True, shell=True, capture_output=True)
+//smallest page size on any supported target
+#define PAGE_SIZE ((uintptr_t) 4096)
 
-    return proc_status.stdout.decode()
+//@head: first 8 bytes of the keyword as a little-endian word
+//@tail: remaining bytes, if any, in the same form
+//@len: zero in a slot without a keyword
+typedef struct slot {{
+	uint64_t head;
+	uint64_t tail;
+	size_t len;
+	token_type type;
+}} slot;
 
-# include the strings.h header which is required by strncmp and the kmap.h
-# API that the ../scanner.c file requires.
-def add_include(text: str) -> str:
-    str_directive = "#include <string.h>"
-    api_directive = "#include \"kmap.h\""
+static const slot slots[] = {{
+"""
 
-    return "\n\n".join([str_directive, api_directive, text])
+footer = """\
+};
 
-# add the pragma preprocessor directives to bypass the -Wconversion error.
-def add_diagnostic(text: str) -> str:
-    push = "#pragma GCC diagnostic push"
-    flag = "#pragma GCC diagnostic ignored \"-Wconversion\""
-    pop  = "#pragma GCC diagnostic pop"
+//returns the n <= 8 bytes at str as a little-endian word with the high bytes
+//cleared. A full word is read unless it would cross a page boundary; bytes
+//past the lexeme on the same page are always readable, even when the source is
+//an mmap that ends on that page.
+static inline uint64_t Load(const char *str, const size_t n)
+{
+	uint64_t word = 0;
 
-    return "\n\n".join([push, flag, text, pop])
+	if (((uintptr_t) str & (PAGE_SIZE - 1)) <= PAGE_SIZE - sizeof(word)) {
+		memcpy(&word, str, sizeof(word));
+	} else {
+		memcpy(&word, str, n);
+	}
 
-# remove struct kv_pair to avoid redefinition from kmap.h.
-def remove_struct(text: str) -> str:
-    struct = "struct kv_pair { char *name; token_type typ; };"
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	word = __builtin_bswap64(word);
+#endif
 
-    return text.replace(struct, "//kv_pair defined in kmap.h")
+	if (n < sizeof(word)) {
+		word &= (UINT64_C(1) << (8 * n)) - 1;
+	}
 
-# exchange strcmp with strncmp and rewrite the logic on the if-branch
-def swap_cmp(text: str) -> str:
-    old_test = "if (s && *str == *s && !strcmp (str + 1, s + 1))"
-    new_test = "if (s && !strncmp(str, s, len))"
+	return word;
+}
 
-    return text.replace(old_test, new_test)
+token_type kmap_lookup(const char *str, size_t len)
+{
+	if (len > MAX_WORD_LENGTH) {
+		return _IDENTIFIER;
+	}
 
-if __name__ == "__main__":
-    check_gperf()
-    text = exec_gperf()
+	const size_t first = len < sizeof(uint64_t) ? len : sizeof(uint64_t);
+	const uint64_t word = Load(str, first);
+	const slot *entry = &slots[(word * MULTIPLIER) >> SHIFT];
+
+	if (entry->head != word || entry->len != len) {
+		return _IDENTIFIER;
+	}
+
+	if (len > first && Load(str + first, len - first) != entry->tail) {
+		return _IDENTIFIER;
+	}
+
+	return entry->type;
+}
+"""
+
+# returns (keyword, token type) pairs in file order
+def read_keywords() -> list:
+    with open("keywords.txt") as file:
+        lines = file.read().split("%%", 1)[1].splitlines()
+
+    pairs = []
+
+    for line in lines:
+        fields = [f.strip() for f in line.split(",") if f.strip()]
+
+        if fields:
+            pairs.append((fields[0], fields[1]))
+
+    return pairs
+
+# the integer whose little-endian bytes are the input characters
+def pack(chars: str) -> int:
+    assert len(chars) <= word_size
+
+    return int.from_bytes(chars.encode(), byteorder="little")
 
-    pipeline = (add_include, add_diagnostic, remove_struct, swap_cmp)
+def get_slot(keyword: str, multiplier: int, bits: int) -> int:
+    product = (pack(keyword[:word_size]) * multiplier) & word_mask
 
-    for func in pipeline:
-        text = func(text)
+    return product >> (64 - bits)
+
+# returns the smallest table width in bits and an odd multiplier for which the
+# multiplicative hash of every keyword is distinct
+def find_multiplier(keywords: list) -> tuple:
+    rng = Random(search_seed)
+    bits = max(len(keywords) - 1, 1).bit_length()
+
+    while True:
+        for _ in range(search_attempts):
+            multiplier = rng.getrandbits(64) | 1
+            taken = {get_slot(k, multiplier, bits) for k in keywords}
+
+            if len(taken) == len(keywords):
+                return bits, multiplier
+
+        bits += 1
+
+def create_recognizer(pairs: list) -> str:
+    keywords = [keyword for keyword, _ in pairs]
+    bits, multiplier = find_multiplier(keywords)
+
+    text = header.format(max(map(len, keywords)), multiplier, 64 - bits)
+    entries = ["\t{0, 0, 0, _IDENTIFIER},"] * (1 << bits)
+
+    for keyword, typ in pairs:
+        head = "UINT64_C(0x{:x})".format(pack(keyword[:word_size]))
+        tail = pack(keyword[word_size:])
+        tail = "UINT64_C(0x{:x})".format(tail) if tail else "0"
+        entry = "\t{{{}, {}, {}, {}}},".format(head, tail, len(keyword), typ)
+
+        entries[get_slot(keyword, multiplier, bits)] = entry
+
+    return text + "\n".join(entries) + "\n" + footer
+
+if __name__ == "__main__":
+    text = create_recognizer(read_keywords())
 
     #truncate whatever may be in an existing kmap.c file, we don't need
     #the old contents.
@@ -0,0 +1,1310 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// A cache entry is an image of the tree. Every node is laid out in the image
+// exactly as it is in memory, except that each pointer holds the offset of its
+// target from the start of the image, or zero when it is null. An entry is read
+// into one arena block and is ready for use once a relocation pass has added
+// the address of the block to every pointer listed in the relocation table.
+// Names must be canonical; each distinct name is listed once in the name table
+// and interned on load, and each slot which refers to it is listed in the fixup
+// table. No node is allocated or visited on load and literals are used in
+// place, so a loaded tree lives exactly as long as the arena which holds the
+// block. Under --Watch that arena is detached into a generation like the arena
+// of a parsed tree, and ArenaReleaseGeneration frees both alike. The entry is
+// not mapped: a mapping would have no owner to release it, and the relocation
+// pass writes every page anyway, so a private mapping costs the same copy.
+//
+// An image is only valid for the build of the compiler which wrote it, so the
+// header records the compiler version and the size of every node type. Bump
+// CACHE_FORMAT whenever a node in parser.h gains, loses, or reorders a field.
+// The header also holds a checksum of the whole image, so an entry damaged on
+// disk is rejected before any of its nodes are used, and every pointer must
+// land on an object which lies entirely within the image.
+//
+// Entries are written to a temporary file in the cache directory and renamed
+// into place, so a reader on another process or thread sees either a complete
+// entry or none at all.
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "cache.h"
+#include "intern.h"
+#include "map.h"
+#include "options.h"
+#include "version.h"
+#include "xerror.h"
+
+typedef struct header header;
+typedef struct span span;
+typedef struct fixup fixup;
+typedef struct relocation relocation;
+typedef struct builder builder;
+
+#define CACHE_FORMAT 4
+#define CACHE_MAGIC "lemi"
+#define CACHE_VERSION_MAX 64
+
+static_assert(sizeof(LEMON_VERSION) <= CACHE_VERSION_MAX, "version too long");
+
+//offsets within an image are 32-bit, so an image may not exceed 4 GiB
+#define CACHE_MAXIMUM_IMAGE ((size_t) UINT32_MAX)
+
+#define CACHE_BUILDER_CAPACITY KiB(64)
+
+//@layout: signature of the node sizes; see Layout
+//@checksum: Digest of the image, header included, with the checksum zeroed
+//@size: bytes in the image, header included
+//@root: offset of the module node
+//@relocations: offset of a table of relocations
+//@names: offset of a table of spans
+//@fixups: offset of a table of fixups
+struct header {
+	char magic[4];
+	uint32_t format;
+	char version[CACHE_VERSION_MAX];
+	uint64_t layout;
+	uint64_t key;
+	uint64_t nodes;
+	uint64_t checksum;
+	uint32_t size;
+	uint32_t root;
+	uint32_t relocations;
+	uint32_t relocation_count;
+	uint32_t names;
+	uint32_t name_count;
+	uint32_t fixups;
+	uint32_t fixup_count;
+};
+
+//a null-terminated name of len characters at the offset
+struct span {
+	uint32_t offset;
+	uint32_t len;
+};
+
+//the pointer slot at the offset refers to the canonical copy of a name
+struct fixup {
+	uint32_t slot;
+	uint32_t name;
+};
+
+//the pointer slot at the offset refers to an object of extent bytes
+struct relocation {
+	uint32_t slot;
+	uint32_t extent;
+};
+
+make_map(uint32_t, Name, static)
+make_vector(relocation, Relocation, static)
+make_vector(span, Span, static)
+make_vector(fixup, Fixup, static)
+
+//every vector<T> has the same layout, whatever its element type
+alias_vector(Byte)
+declare_vector(char, Byte)
+
+//@bytes: the image under construction; it may move as it grows, so nodes in
+//the image are always referred to by offset while it is built
+//@names: position of each name in the spans vector
+struct builder {
+	char *bytes;
+	size_t len;
+	size_t cap;
+	map(Name) names;
+	vector(Span) spans;
+	vector(Relocation) relocations;
+	vector(Fixup) fixups;
+};
+
+static uint64_t Digest(const char *, const size_t, uint64_t);
+static uint64_t Layout(void);
+static bool EntryPath(char *, const cstring *, const uint64_t);
+static int CreateTemporary(char *, const cstring *, const uint64_t);
+static void CloseDescriptor(int *);
+static bool ReadAll(int, char *, size_t);
+static bool WriteAll(int, const char *, size_t);
+
+//image construction
+static builder *BuilderInit(const size_t);
+static size_t Reserve(builder *, const size_t, const size_t);
+static size_t Copy(builder *, const void *, const size_t, const size_t);
+static void Store(builder *, const size_t, const uintptr_t);
+static void Link(builder *, const size_t, const size_t, const size_t);
+static void LinkName(builder *, const size_t, const cstring *);
+static void LinkText(builder *, const size_t, const cstring *);
+static size_t LinkVector
+(builder *, const size_t, const void *, const size_t, const size_t,
+ const size_t);
+static void Build(builder *, const uint64_t, const module *, const size_t);
+static size_t WriteModule(builder *, const module *);
+static void WriteDecl(builder *, const size_t, const decl *);
+static size_t WriteDeclRef(builder *, const decl *);
+static void WriteFiat(builder *, const size_t, const fiat *);
+static void WriteStmt(builder *, const size_t, const stmt *);
+static size_t WriteStmtRef(builder *, const stmt *);
+static size_t WriteType(builder *, const type *);
+static size_t WriteExpr(builder *, const expr *);
+static void WriteExprs(builder *, const size_t, const vector(Expr) *);
+static void WriteArgs(builder *, const size_t, const vector(Args) *);
+
+//image loading
+static bool HasTable(const uint32_t, const uint32_t, const size_t, size_t);
+static bool IsSlot(const uint64_t, const size_t);
+static module *Relocate(char *, const size_t, const uint64_t, size_t *);
+
+//------------------------------------------------------------------------------
+//API implementation
+
+uint64_t CacheKey(const source *src)
+{
+	assert(src);
+	assert(src->text);
+
+	const char *version = LEMON_VERSION;
+	const uint64_t seed = MapHashView(version, strlen(version)) ^ src->len;
+
+	return Digest(src->text, src->len, seed);
+}
+
+module *CacheLoad(const cstring *filename, const uint64_t key, size_t *nodes)
+{
+	assert(filename);
+	assert(nodes);
+
+	const cstring *directory = OptionsCache();
+	char path[PATH_MAX];
+
+	assert(directory);
+
+	if (!EntryPath(path, directory, key)) {
+		return NULL;
+	}
+
+	//a missing entry is the common case and is not worth reporting
+	__attribute__((cleanup(CloseDescriptor)))
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1) {
+		return NULL;
+	}
+
+	struct stat info;
+
+	if (fstat(fd, &info) == -1 || info.st_size <= 0) {
+		xerror_issue("%s: cannot calculate file size", path);
+		return NULL;
+	}
+
+	const size_t len = (size_t) info.st_size;
+
+	if (len < sizeof(header) || len > CACHE_MAXIMUM_IMAGE) {
+		xerror_issue("%s: ignoring malformed cache entry", path);
+		return NULL;
+	}
+
+	//a malformed entry leaves its block to the arena, like any failed parse
+	char *image = allocate(len);
+
+	if (!ReadAll(fd, image, len)) {
+		xerror_issue("%s: cannot read cache entry", path);
+		return NULL;
+	}
+
+	module *root = Relocate(image, len, key, nodes);
+
+	if (!root) {
+		xerror_issue("%s: ignoring malformed cache entry", path);
+		return NULL;
+	}
+
+	root->alias = InternString(filename);
+
+	return root;
+}
+
+void CacheStore(const uint64_t key, const module *root, const size_t nodes)
+{
+	assert(root);
+
+	const cstring *directory = OptionsCache();
+	char path[PATH_MAX];
+	char temporary[PATH_MAX];
+
+	assert(directory);
+
+	if (!EntryPath(path, directory, key)) {
+		xerror_issue("%s: cache path is too long", directory);
+		return;
+	}
+
+	ArenaPush();
+
+	builder *self = BuilderInit(nodes);
+
+	Build(self, key, root, nodes);
+
+	if (self->len > CACHE_MAXIMUM_IMAGE) {
+		xerror_issue("%s: tree is too large to cache", path);
+		ArenaPop();
+		return;
+	}
+
+	int fd = CreateTemporary(temporary, directory, key);
+
+	if (fd == -1) {
+		xerror_issue("%s: %s", directory, strerror(errno));
+		ArenaPop();
+		return;
+	}
+
+	bool ok = WriteAll(fd, self->bytes, self->len);
+	ok &= !close(fd);
+
+	ArenaPop();
+
+	if (!ok || rename(temporary, path)) {
+		xerror_issue("%s: cannot write cache entry", path);
+		(void) unlink(temporary);
+	}
+}
+
+//the image is relocated where it was built, so the copy needs no second buffer;
+//the builder tables are left to the arena along with the copy
+module *CacheCopy(const module *root)
+{
+	assert(root);
+
+	builder *self = BuilderInit(0);
+
+	Build(self, 0, root, 0);
+
+	if (self->len > CACHE_MAXIMUM_IMAGE) {
+		return NULL;
+	}
+
+	size_t nodes = 0;
+	module *copy = Relocate(self->bytes, self->len, 0, &nodes);
+
+	assert(copy && "image of a live tree is malformed");
+
+	copy->alias = root->alias;
+
+	return copy;
+}
+
+//------------------------------------------------------------------------------
+//entry files
+
+//the bytes are read a word at a time with the round function of xxHash64, and
+//the result is finished with the same mixing function as the map hash
+static uint64_t Digest(const char *bytes, const size_t len, uint64_t hash)
+{
+	assert(bytes || !len);
+
+	const uint64_t prime_1 = (uint64_t) 0x9E3779B185EBCA87ULL;
+	const uint64_t prime_2 = (uint64_t) 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t prime_4 = (uint64_t) 0x85EBCA77C2B2AE63ULL;
+
+	for (size_t i = 0; i < len; i += sizeof(uint64_t)) {
+		const size_t rest = len - i;
+		uint64_t word = 0;
+
+		memcpy(&word, bytes + i, rest < 8 ? rest : sizeof(word));
+
+		word *= prime_2;
+		word = (word << 31) | (word >> 33);
+		word *= prime_1;
+
+		hash ^= word;
+		hash = ((hash << 27) | (hash >> 37)) * prime_1 + prime_4;
+	}
+
+	return MapMix(hash);
+}
+
+//returns a signature of the node sizes and the byte order
+static uint64_t Layout(void)
+{
+	const size_t sizes[] = {
+		sizeof(void *),
+		sizeof(module),
+		sizeof(import),
+		sizeof(decl),
+		sizeof(member),
+		sizeof(param),
+		sizeof(fiat),
+		sizeof(stmt),
+		sizeof(test),
+		sizeof(expr),
+		sizeof(type),
+		__BYTE_ORDER__
+	};
+
+	return MapHashView((const char *) sizes, sizeof(sizes));
+}
+
+//returns false if the path does not fit within PATH_MAX bytes
+static bool EntryPath(char *path, const cstring *directory, const uint64_t key)
+{
+	assert(path);
+	assert(directory);
+
+	const cstring *fmt = "%s/%016" PRIx64 ".ast";
+	const int len = snprintf(path, PATH_MAX, fmt, directory, key);
+
+	return len > 0 && len < PATH_MAX;
+}
+
+//returns a descriptor for a new file in the directory, which is created if it
+//does not yet exist, and writes its path to temporary; returns -1 on failure
+static int CreateTemporary
+(char *temporary, const cstring *directory, const uint64_t key)
+{
+	assert(temporary);
+	assert(directory);
+
+	const cstring *fmt = "%s/.%016" PRIx64 ".XXXXXX";
+
+	for (int attempt = 0; attempt < 2; attempt++) {
+		const int len = snprintf(temporary, PATH_MAX, fmt, directory, key);
+
+		if (len <= 0 || len >= PATH_MAX) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+
+		int fd = mkstemp(temporary);
+
+		if (fd != -1 || errno != ENOENT) {
+			return fd;
+		}
+
+		if (mkdir(directory, 0777) == -1 && errno != EEXIST) {
+			return -1;
+		}
+	}
+
+	return -1;
+}
+
+//for use with gcc cleanup
+static void CloseDescriptor(int *fd)
+{
+	if (*fd != -1) {
+		(void) close(*fd);
+	}
+}
+
+//returns false if the first len bytes of the file cannot be read into buffer
+static bool ReadAll(int fd, char *buffer, size_t len)
+{
+	assert(buffer || !len);
+
+	while (len) {
+		ssize_t total_read = read(fd, buffer, len);
+
+		if (total_read == -1 && errno == EINTR) {
+			continue;
+		}
+
+		if (total_read <= 0) {
+			xerror_issue("read: %s", strerror(errno));
+			return false;
+		}
+
+		buffer += total_read;
+		len -= (size_t) total_read;
+	}
+
+	return true;
+}
+
+//returns false if the first len bytes of the buffer cannot be written
+static bool WriteAll(int fd, const char *buffer, size_t len)
+{
+	assert(buffer || !len);
+
+	while (len) {
+		ssize_t total_written = write(fd, buffer, len);
+
+		if (total_written == -1 && errno == EINTR) {
+			continue;
+		}
+
+		if (total_written <= 0) {
+			xerror_issue("write: %s", strerror(errno));
+			return false;
+		}
+
+		buffer += total_written;
+		len -= (size_t) total_written;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//image construction
+
+//returns an empty builder for a tree with the given --Dstats node count
+static builder *BuilderInit(const size_t nodes)
+{
+	//most nodes are smaller than a fiat, so the image seldom needs to grow;
+	//the arena maps the capacity lazily, so any excess is never touched
+	size_t capacity = nodes * sizeof(fiat);
+
+	if (capacity < CACHE_BUILDER_CAPACITY) {
+		capacity = CACHE_BUILDER_CAPACITY;
+	}
+
+	builder *self = allocate(sizeof(builder));
+
+	*self = (builder) {
+		.bytes = allocate(capacity),
+		.len = 0,
+		.cap = capacity,
+		.names = NameMapInit(MAP_DEFAULT_CAPACITY),
+		.spans = SpanVectorInit(0, VECTOR_DEFAULT_CAPACITY),
+		.relocations = RelocationVectorInit(0, VECTOR_DEFAULT_CAPACITY),
+		.fixups = FixupVectorInit(0, VECTOR_DEFAULT_CAPACITY)
+	};
+
+	return self;
+}
+
+//returns the offset of bytes of zeroed space aligned to align
+static size_t Reserve(builder *self, const size_t bytes, const size_t align)
+{
+	assert(self);
+	assert(align && !(align & (align - 1)));
+
+	const size_t start = (self->len + align - 1) & ~(align - 1);
+	const size_t end = start + bytes;
+
+	if (end > self->cap) {
+		size_t cap = self->cap * 2;
+
+		while (cap < end) {
+			cap *= 2;
+		}
+
+		self->bytes = reallocate(self->bytes, cap);
+		self->cap = cap;
+	}
+
+	memset(self->bytes + self->len, 0, end - self->len);
+	self->len = end;
+
+	return start;
+}
+
+static size_t Copy
+(builder *self, const void *data, const size_t bytes, const size_t align)
+{
+	assert(self);
+	assert(data || !bytes);
+
+	const size_t offset = Reserve(self, bytes, align);
+
+	if (bytes) {
+		memcpy(self->bytes + offset, data, bytes);
+	}
+
+	return offset;
+}
+
+//writes a value to the pointer slot at the offset
+static void Store(builder *self, const size_t slot, const uintptr_t value)
+{
+	assert(self);
+	assert(slot + sizeof(value) <= self->len);
+
+	memcpy(self->bytes + slot, &value, sizeof(value));
+}
+
+//points the slot at the object of the given bytes at the target offset, where
+//zero is the null pointer; images which do not fit in 32-bit offsets are
+//discarded by CacheStore, so the casts truncate only the offsets of an image
+//that is never written
+static void Link
+(builder *self, const size_t slot, const size_t target, const size_t bytes)
+{
+	assert(self);
+	assert(target + bytes <= self->len);
+
+	Store(self, slot, (uintptr_t) target);
+
+	if (target) {
+		const relocation entry = {
+			.slot = (uint32_t) slot,
+			.extent = (uint32_t) bytes
+		};
+
+		RelocationVectorPush(&self->relocations, entry);
+	}
+}
+
+//points the slot at an interned name, which may be null
+static void LinkName(builder *self, const size_t slot, const cstring *name)
+{
+	assert(self);
+
+	Store(self, slot, 0);
+
+	if (!name) {
+		return;
+	}
+
+	const uint64_t hash = InternHash(name);
+	uint32_t *known = NULL;
+	uint32_t position = 0;
+
+	if (NameMapGetRefHashed(&self->names, name, hash, &known)) {
+		position = *known;
+	} else {
+		const size_t len = strlen(name);
+
+		const span text = {
+			.offset = (uint32_t) Copy(self, name, len + 1, 1),
+			.len = (uint32_t) len
+		};
+
+		position = (uint32_t) self->spans.len;
+		(void) NameMapInsert(&self->names, name, position);
+		SpanVectorPush(&self->spans, text);
+	}
+
+	const fixup entry = {
+		.slot = (uint32_t) slot,
+		.name = position
+	};
+
+	FixupVectorPush(&self->fixups, entry);
+}
+
+//points the slot at a copy of a literal, which is used in place once loaded
+static void LinkText(builder *self, const size_t slot, const cstring *text)
+{
+	assert(self);
+	assert(text);
+
+	const size_t bytes = strlen(text) + 1;
+
+	Link(self, slot, Copy(self, text, bytes, 1), bytes);
+}
+
+//copies the elements of the vector whose struct is at the slot and links the
+//copy to it; returns the offset of the first element. The capacity of the
+//copy is its length.
+static size_t LinkVector
+(
+	builder *self,
+	const size_t slot,
+	const void *buffer,
+	const size_t len,
+	const size_t size,
+	const size_t align
+)
+{
+	assert(self);
+
+	const size_t offset = Copy(self, buffer, len * size, align);
+	const size_t cap = len;
+
+	const size_t cap_slot = slot + offsetof(vector(Byte), cap);
+	memcpy(self->bytes + cap_slot, &cap, sizeof(cap));
+
+	Link(self, slot + offsetof(vector(Byte), buffer), offset, len * size);
+
+	return offset;
+}
+
+static void Build
+(builder *self, const uint64_t key, const module *root, const size_t nodes)
+{
+	assert(self);
+	assert(root);
+
+	const size_t at = Reserve(self, sizeof(header), _Alignof(header));
+	const size_t root_at = WriteModule(self, root);
+
+	const uint32_t name_count = (uint32_t) self->spans.len;
+	const size_t names = Copy(self,
+				  self->spans.buffer,
+				  sizeof(span) * self->spans.len,
+				  _Alignof(span));
+
+	const uint32_t fixup_count = (uint32_t) self->fixups.len;
+	const size_t fixups = Copy(self,
+				   self->fixups.buffer,
+				   sizeof(fixup) * self->fixups.len,
+				   _Alignof(fixup));
+
+	const uint32_t relocation_count = (uint32_t) self->relocations.len;
+	const size_t relocations = Copy(self,
+					self->relocations.buffer,
+					sizeof(relocation) * relocation_count,
+					_Alignof(relocation));
+
+	header head = {
+		.magic = {0},
+		.format = CACHE_FORMAT,
+		.version = {0},
+		.layout = Layout(),
+		.key = key,
+		.nodes = nodes,
+		.checksum = 0,
+		.size = (uint32_t) self->len,
+		.root = (uint32_t) root_at,
+		.relocations = (uint32_t) relocations,
+		.relocation_count = relocation_count,
+		.names = (uint32_t) names,
+		.name_count = name_count,
+		.fixups = (uint32_t) fixups,
+		.fixup_count = fixup_count
+	};
+
+	memcpy(head.magic, CACHE_MAGIC, sizeof(head.magic));
+	memcpy(head.version, LEMON_VERSION, sizeof(LEMON_VERSION));
+	memcpy(self->bytes + at, &head, sizeof(head));
+
+	head.checksum = Digest(self->bytes, self->len, self->len);
+	memcpy(self->bytes + at, &head, sizeof(head));
+}
+
+//the alias is set to the filename on load and the remaining pointers are null
+//until the resolver runs
+static size_t WriteModule(builder *self, const module *root)
+{
+	assert(self);
+	assert(root);
+
+	const size_t at = Copy(self, root, sizeof(module), _Alignof(module));
+
+	Store(self, at + offsetof(module, alias), 0);
+	Store(self, at + offsetof(module, next), 0);
+	Store(self, at + offsetof(module, table), 0);
+
+	const size_t imports = LinkVector(self,
+					  at + offsetof(module, imports),
+					  root->imports.buffer,
+					  root->imports.len,
+					  sizeof(import),
+					  _Alignof(import));
+
+	for (size_t i = 0; i < root->imports.len; i++) {
+		const size_t slot = imports + i * sizeof(import);
+		const cstring *alias = root->imports.buffer[i].alias;
+
+		LinkName(self, slot + offsetof(import, alias), alias);
+		Store(self, slot + offsetof(import, entry), 0);
+	}
+
+	const size_t decls = LinkVector(self,
+					at + offsetof(module, declarations),
+					root->declarations.buffer,
+					root->declarations.len,
+					sizeof(decl),
+					_Alignof(decl));
+
+	for (size_t i = 0; i < root->declarations.len; i++) {
+		const size_t slot = decls + i * sizeof(decl);
+		WriteDecl(self, slot, &root->declarations.buffer[i]);
+	}
+
+	return at;
+}
+
+//links the pointers of a declaration that has already been copied to at
+static void WriteDecl(builder *self, const size_t at, const decl *node)
+{
+	assert(self);
+	assert(node);
+
+	size_t buffer = 0;
+
+	switch (node->tag) {
+	case NODE_UDT:
+		LinkName(self, at + offsetof(decl, udt.name), node->udt.name);
+		Store(self, at + offsetof(decl, udt.entry), 0);
+
+		buffer = LinkVector(self,
+				    at + offsetof(decl, udt.members),
+				    node->udt.members.buffer,
+				    node->udt.members.len,
+				    sizeof(member),
+				    _Alignof(member));
+
+		for (size_t i = 0; i < node->udt.members.len; i++) {
+			const size_t slot = buffer + i * sizeof(member);
+			const member *attr = &node->udt.members.buffer[i];
+
+			LinkName(self, slot + offsetof(member, name), attr->name);
+			Link(self, slot + offsetof(member, typ),
+			     WriteType(self, attr->typ), sizeof(type));
+			Store(self, slot + offsetof(member, entry), 0);
+		}
+
+		break;
+
+	case NODE_FUNCTION:
+		LinkName(self, at + offsetof(decl, function.name),
+			 node->function.name);
+		Store(self, at + offsetof(decl, function.entry), 0);
+		Link(self, at + offsetof(decl, function.ret),
+		     WriteType(self, node->function.ret), sizeof(type));
+		Link(self, at + offsetof(decl, function.block),
+		     WriteStmtRef(self, node->function.block), sizeof(stmt));
+
+		buffer = LinkVector(self,
+				    at + offsetof(decl, function.params),
+				    node->function.params.buffer,
+				    node->function.params.len,
+				    sizeof(param),
+				    _Alignof(param));
+
+		for (size_t i = 0; i < node->function.params.len; i++) {
+			const size_t slot = buffer + i * sizeof(param);
+			const param *attr = &node->function.params.buffer[i];
+
+			LinkName(self, slot + offsetof(param, name), attr->name);
+			Link(self, slot + offsetof(param, typ),
+			     WriteType(self, attr->typ), sizeof(type));
+			Store(self, slot + offsetof(param, entry), 0);
+		}
+
+		break;
+
+	case NODE_METHOD:
+		LinkName(self, at + offsetof(decl, method.name),
+			 node->method.name);
+		Store(self, at + offsetof(decl, method.entry), 0);
+		Link(self, at + offsetof(decl, method.ret),
+		     WriteType(self, node->method.ret), sizeof(type));
+		Link(self, at + offsetof(decl, method.recv),
+		     WriteType(self, node->method.recv), sizeof(type));
+		Link(self, at + offsetof(decl, method.block),
+		     WriteStmtRef(self, node->method.block), sizeof(stmt));
+
+		buffer = LinkVector(self,
+				    at + offsetof(decl, method.params),
+				    node->method.params.buffer,
+				    node->method.params.len,
+				    sizeof(param),
+				    _Alignof(param));
+
+		for (size_t i = 0; i < node->method.params.len; i++) {
+			const size_t slot = buffer + i * sizeof(param);
+			const param *attr = &node->method.params.buffer[i];
+
+			LinkName(self, slot + offsetof(param, name), attr->name);
+			Link(self, slot + offsetof(param, typ),
+			     WriteType(self, attr->typ), sizeof(type));
+			Store(self, slot + offsetof(param, entry), 0);
+		}
+
+		break;
+
+	case NODE_VARIABLE:
+		LinkName(self, at + offsetof(decl, variable.name),
+			 node->variable.name);
+		Store(self, at + offsetof(decl, variable.entry), 0);
+		Link(self, at + offsetof(decl, variable.vartype),
+		     WriteType(self, node->variable.vartype), sizeof(type));
+		Link(self, at + offsetof(decl, variable.value),
+		     WriteExpr(self, node->variable.value), sizeof(expr));
+		break;
+
+	default:
+		assert(0 != 0 && "invalid decl tag");
+		__builtin_unreachable();
+	}
+}
+
+//returns the offset of a copy of the declaration, or zero if it is null
+static size_t WriteDeclRef(builder *self, const decl *node)
+{
+	assert(self);
+
+	if (!node) {
+		return 0;
+	}
+
+	const size_t at = Copy(self, node, sizeof(decl), _Alignof(decl));
+	WriteDecl(self, at, node);
+
+	return at;
+}
+
+static void WriteFiat(builder *self, const size_t at, const fiat *node)
+{
+	assert(self);
+	assert(node);
+
+	if (node->tag == NODE_DECL) {
+		WriteDecl(self, at + offsetof(fiat, declaration),
+			  &node->declaration);
+	} else {
+		WriteStmt(self, at + offsetof(fiat, statement),
+			  &node->statement);
+	}
+}
+
+//links the pointers of a statement that has already been copied to at
+static void WriteStmt(builder *self, const size_t at, const stmt *node)
+{
+	assert(self);
+	assert(node);
+
+	size_t buffer = 0;
+
+	switch (node->tag) {
+	case NODE_EXPRSTMT:
+		Link(self, at + offsetof(stmt, exprstmt),
+		     WriteExpr(self, node->exprstmt), sizeof(expr));
+		break;
+
+	case NODE_BLOCK:
+		Store(self, at + offsetof(stmt, block.table), 0);
+
+		buffer = LinkVector(self,
+				    at + offsetof(stmt, block.fiats),
+				    node->block.fiats.buffer,
+				    node->block.fiats.len,
+				    sizeof(fiat),
+				    _Alignof(fiat));
+
+		for (size_t i = 0; i < node->block.fiats.len; i++) {
+			WriteFiat(self, buffer + i * sizeof(fiat),
+				  &node->block.fiats.buffer[i]);
+		}
+
+		break;
+
+	case NODE_FORLOOP:
+		if (node->forloop.tag == FOR_DECL) {
+			Link(self, at + offsetof(stmt, forloop.shortvar),
+			     WriteDeclRef(self, node->forloop.shortvar),
+			     sizeof(decl));
+		} else {
+			Link(self, at + offsetof(stmt, forloop.init),
+			     WriteExpr(self, node->forloop.init), sizeof(expr));
+		}
+
+		Link(self, at + offsetof(stmt, forloop.cond),
+		     WriteExpr(self, node->forloop.cond), sizeof(expr));
+		Link(self, at + offsetof(stmt, forloop.post),
+		     WriteExpr(self, node->forloop.post), sizeof(expr));
+		Link(self, at + offsetof(stmt, forloop.block),
+		     WriteStmtRef(self, node->forloop.block), sizeof(stmt));
+		break;
+
+	case NODE_WHILELOOP:
+		Link(self, at + offsetof(stmt, whileloop.cond),
+		     WriteExpr(self, node->whileloop.cond), sizeof(expr));
+		Link(self, at + offsetof(stmt, whileloop.block),
+		     WriteStmtRef(self, node->whileloop.block), sizeof(stmt));
+		break;
+
+	case NODE_SWITCHSTMT:
+		Link(self, at + offsetof(stmt, switchstmt.controller),
+		     WriteExpr(self, node->switchstmt.controller),
+		     sizeof(expr));
+
+		buffer = LinkVector(self,
+				    at + offsetof(stmt, switchstmt.tests),
+				    node->switchstmt.tests.buffer,
+				    node->switchstmt.tests.len,
+				    sizeof(test),
+				    _Alignof(test));
+
+		for (size_t i = 0; i < node->switchstmt.tests.len; i++) {
+			const size_t slot = buffer + i * sizeof(test);
+			const test *branch = &node->switchstmt.tests.buffer[i];
+
+			Link(self, slot + offsetof(test, cond),
+			     WriteExpr(self, branch->cond), sizeof(expr));
+			Link(self, slot + offsetof(test, pass),
+			     WriteStmtRef(self, branch->pass), sizeof(stmt));
+		}
+
+		break;
+
+	case NODE_BRANCH:
+		Link(self, at + offsetof(stmt, branch.shortvar),
+		     WriteDeclRef(self, node->branch.shortvar), sizeof(decl));
+		Link(self, at + offsetof(stmt, branch.cond),
+		     WriteExpr(self, node->branch.cond), sizeof(expr));
+		Link(self, at + offsetof(stmt, branch.pass),
+		     WriteStmtRef(self, node->branch.pass), sizeof(stmt));
+		Link(self, at + offsetof(stmt, branch.fail),
+		     WriteStmtRef(self, node->branch.fail), sizeof(stmt));
+		break;
+
+	case NODE_RETURNSTMT:
+		Link(self, at + offsetof(stmt, returnstmt),
+		     WriteExpr(self, node->returnstmt), sizeof(expr));
+		break;
+
+	case NODE_BREAKSTMT:
+		__attribute__((fallthrough));
+
+	case NODE_CONTINUESTMT:
+		__attribute__((fallthrough));
+
+	case NODE_FALLTHROUGHSTMT:
+		break;
+
+	case NODE_GOTOLABEL:
+		LinkName(self, at + offsetof(stmt, gotostmt.name),
+			 node->gotostmt.name);
+		Store(self, at + offsetof(stmt, gotostmt.entry), 0);
+		break;
+
+	case NODE_LABEL:
+		LinkName(self, at + offsetof(stmt, label.name),
+			 node->label.name);
+		Store(self, at + offsetof(stmt, label.entry), 0);
+		Link(self, at + offsetof(stmt, label.target),
+		     WriteStmtRef(self, node->label.target), sizeof(stmt));
+		break;
+
+	default:
+		assert(0 != 0 && "invalid stmt tag");
+		__builtin_unreachable();
+	}
+}
+
+//returns the offset of a copy of the statement, or zero if it is null
+static size_t WriteStmtRef(builder *self, const stmt *node)
+{
+	assert(self);
+
+	if (!node) {
+		return 0;
+	}
+
+	const size_t at = Copy(self, node, sizeof(stmt), _Alignof(stmt));
+	WriteStmt(self, at, node);
+
+	return at;
+}
+
+//returns the offset of a copy of the type, or zero if it is null
+static size_t WriteType(builder *self, const type *node)
+{
+	assert(self);
+
+	if (!node) {
+		return 0;
+	}
+
+	const size_t at = Copy(self, node, sizeof(type), _Alignof(type));
+
+	switch (node->tag) {
+	case NODE_BASE:
+		LinkName(self, at + offsetof(type, base.name), node->base.name);
+		Store(self, at + offsetof(type, base.entry), 0);
+		break;
+
+	case NODE_NAMED:
+		LinkName(self, at + offsetof(type, named.name),
+			 node->named.name);
+		Link(self, at + offsetof(type, named.reference),
+		     WriteType(self, node->named.reference), sizeof(type));
+		break;
+
+	case NODE_POINTER:
+		Link(self, at + offsetof(type, pointer.reference),
+		     WriteType(self, node->pointer.reference), sizeof(type));
+		break;
+
+	case NODE_ARRAY:
+		Link(self, at + offsetof(type, array.element),
+		     WriteType(self, node->array.element), sizeof(type));
+		break;
+
+	default:
+		assert(0 != 0 && "invalid type tag");
+		__builtin_unreachable();
+	}
+
+	return at;
+}
+
+//returns the offset of a copy of the expression, or zero if it is null
+static size_t WriteExpr(builder *self, const expr *node)
+{
+	assert(self);
+
+	if (!node) {
+		return 0;
+	}
+
+	const size_t at = Copy(self, node, sizeof(expr), _Alignof(expr));
+
+	switch (node->tag) {
+	case NODE_ASSIGNMENT:
+		Link(self, at + offsetof(expr, assignment.lvalue),
+		     WriteExpr(self, node->assignment.lvalue), sizeof(expr));
+		Link(self, at + offsetof(expr, assignment.rvalue),
+		     WriteExpr(self, node->assignment.rvalue), sizeof(expr));
+		break;
+
+	case NODE_BINARY:
+		Link(self, at + offsetof(expr, binary.left),
+		     WriteExpr(self, node->binary.left), sizeof(expr));
+		Link(self, at + offsetof(expr, binary.right),
+		     WriteExpr(self, node->binary.right), sizeof(expr));
+		break;
+
+	case NODE_UNARY:
+		Link(self, at + offsetof(expr, unary.operand),
+		     WriteExpr(self, node->unary.operand), sizeof(expr));
+		break;
+
+	case NODE_CAST:
+		Link(self, at + offsetof(expr, cast.operand),
+		     WriteExpr(self, node->cast.operand), sizeof(expr));
+		Link(self, at + offsetof(expr, cast.casttype),
+		     WriteType(self, node->cast.casttype), sizeof(type));
+		break;
+
+	case NODE_CALL:
+		Link(self, at + offsetof(expr, call.name),
+		     WriteExpr(self, node->call.name), sizeof(expr));
+		WriteArgs(self, at + offsetof(expr, call.args),
+			  &node->call.args);
+		break;
+
+	case NODE_SELECTOR:
+		Link(self, at + offsetof(expr, selector.name),
+		     WriteExpr(self, node->selector.name), sizeof(expr));
+		Link(self, at + offsetof(expr, selector.attr),
+		     WriteExpr(self, node->selector.attr), sizeof(expr));
+		break;
+
+	case NODE_INDEX:
+		Link(self, at + offsetof(expr, index.name),
+		     WriteExpr(self, node->index.name), sizeof(expr));
+		Link(self, at + offsetof(expr, index.key),
+		     WriteExpr(self, node->index.key), sizeof(expr));
+		break;
+
+	case NODE_ARRAYLIT:
+		(void) LinkVector(self,
+				  at + offsetof(expr, arraylit.indicies),
+				  node->arraylit.indicies.buffer,
+				  node->arraylit.indicies.len,
+				  sizeof(intmax_t),
+				  _Alignof(intmax_t));
+
+		WriteExprs(self, at + offsetof(expr, arraylit.values),
+			   &node->arraylit.values);
+		break;
+
+	case NODE_RVARLIT:
+		LinkName(self, at + offsetof(expr, rvarlit.dist),
+			 node->rvarlit.dist);
+		WriteArgs(self, at + offsetof(expr, rvarlit.args),
+			  &node->rvarlit.args);
+		break;
+
+	case NODE_LIT:
+		LinkText(self, at + offsetof(expr, lit.rep), node->lit.rep);
+		break;
+
+	case NODE_IDENT:
+		LinkName(self, at + offsetof(expr, ident.name),
+			 node->ident.name);
+		break;
+
+	default:
+		assert(0 != 0 && "invalid expr tag");
+		__builtin_unreachable();
+	}
+
+	return at;
+}
+
+//copies the argument vector whose struct is at the slot
+static void WriteExprs
+(builder *self, const size_t slot, const vector(Expr) *args)
+{
+	assert(self);
+	assert(args);
+
+	const size_t buffer = LinkVector(self,
+					 slot,
+					 args->buffer,
+					 args->len,
+					 sizeof(expr *),
+					 _Alignof(expr *));
+
+	for (size_t i = 0; i < args->len; i++) {
+		Link(self, buffer + i * sizeof(expr *),
+		     WriteExpr(self, args->buffer[i]), sizeof(expr));
+	}
+}
+
+//copies the small argument vector whose struct is at the slot. The arguments
+//of a short list are already in the copy of the struct; a list which spilled
+//to the arena but has since shrunk to fit is moved back into the struct.
+static void WriteArgs
+(builder *self, const size_t slot, const vector(Args) *args)
+{
+	assert(self);
+	assert(args);
+
+	size_t buffer = slot + offsetof(vector(Args), small);
+
+	if (args->len > ARGS_INLINE) {
+		buffer = LinkVector(self,
+				    slot,
+				    args->buffer,
+				    args->len,
+				    sizeof(expr *),
+				    _Alignof(expr *));
+	} else if (args->cap > ARGS_INLINE) {
+		const size_t cap = ARGS_INLINE;
+		const size_t cap_slot = slot + offsetof(vector(Args), cap);
+		memcpy(self->bytes + cap_slot, &cap, sizeof(cap));
+		Store(self, buffer, 0);
+	}
+
+	for (size_t i = 0; i < args->len; i++) {
+		Link(self, buffer + i * sizeof(expr *),
+		     WriteExpr(self, ArgsVectorGet(args, i)), sizeof(expr));
+	}
+}
+
+//------------------------------------------------------------------------------
+//image loading
+
+//true if count entries of the given size at the offset lie within the image
+static bool HasTable
+(const uint32_t offset, const uint32_t count, const size_t size, size_t len)
+{
+	if (offset % sizeof(uint32_t)) {
+		return false;
+	}
+
+	return (uint64_t) offset + (uint64_t) count * size <= (uint64_t) len;
+}
+
+//true if a pointer at the offset is aligned and lies within the image
+static bool IsSlot(const uint64_t offset, const size_t len)
+{
+	if (offset % _Alignof(void *)) {
+		return false;
+	}
+
+	return offset + sizeof(void *) <= (uint64_t) len;
+}
+
+//returns NULL if the image is malformed or belongs to another key or build.
+//The checksum rejects an image damaged after it was written, so the nodes are
+//not walked; the tables are still checked so that every pointer lands on an
+//object which lies entirely within the image.
+static module *Relocate
+(char *base, const size_t len, const uint64_t key, size_t *nodes)
+{
+	assert(base);
+	assert(len >= sizeof(header));
+	assert(nodes);
+
+	header *head = (header *) base;
+	const uint64_t checksum = head->checksum;
+
+	head->checksum = 0;
+
+	if (Digest(base, len, len) != checksum) {
+		return NULL;
+	}
+
+	if (memcmp(head->magic, CACHE_MAGIC, sizeof(head->magic))) {
+		return NULL;
+	}
+
+	const size_t version_len = sizeof(LEMON_VERSION);
+
+	if (head->format != CACHE_FORMAT
+	    || memcmp(head->version, LEMON_VERSION, version_len)
+	    || head->layout != Layout()
+	    || head->key != key
+	    || head->size != len) {
+		return NULL;
+	}
+
+	if (!HasTable(head->relocations, head->relocation_count,
+		      sizeof(relocation), len)
+	    || !HasTable(head->names, head->name_count, sizeof(span), len)
+	    || !HasTable(head->fixups, head->fixup_count, sizeof(fixup), len)
+	    || head->root % _Alignof(module)
+	    || (uint64_t) head->root + sizeof(module) > len) {
+		return NULL;
+	}
+
+	const span *spans = (const span *) (base + head->names);
+	const cstring **names = allocate(sizeof(cstring *) * head->name_count);
+
+	for (uint32_t i = 0; i < head->name_count; i++) {
+		const span text = spans[i];
+
+		if ((uint64_t) text.offset + text.len >= len || !text.len) {
+			return NULL;
+		}
+
+		names[i] = Intern(base + text.offset, text.len);
+	}
+
+	const char *relocations = base + head->relocations;
+	const relocation *table = (const relocation *) relocations;
+
+	for (uint32_t i = 0; i < head->relocation_count; i++) {
+		const relocation entry = table[i];
+		uintptr_t target = 0;
+
+		if (!IsSlot(entry.slot, len)) {
+			return NULL;
+		}
+
+		memcpy(&target, base + entry.slot, sizeof(target));
+
+		if (target < sizeof(header)
+		    || (uint64_t) target + entry.extent > (uint64_t) len) {
+			return NULL;
+		}
+
+		target += (uintptr_t) base;
+		memcpy(base + entry.slot, &target, sizeof(target));
+	}
+
+	const fixup *fixups = (const fixup *) (base + head->fixups);
+
+	for (uint32_t i = 0; i < head->fixup_count; i++) {
+		const fixup entry = fixups[i];
+
+		if (!IsSlot(entry.slot, len) || entry.name >= head->name_count) {
+			return NULL;
+		}
+
+		const cstring *name = names[entry.name];
+		memcpy(base + entry.slot, &name, sizeof(name));
+	}
+
+	*nodes = (size_t) head->nodes;
+
+	return (module *) (base + head->root);
+}
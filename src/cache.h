@@ -0,0 +1,43 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// The cache module keeps the abstract syntax tree of every module that parses
+// without error in the --Cache directory, so that a later compilation of the
+// same source text loads the tree instead of scanning and parsing it again.
+// Entries are keyed on a hash of the source text and the compiler version, and
+// an entry written by any other version of the compiler is never loaded.
+//
+// Symbol tables are not cached. They are built by the resolver from the whole
+// import graph and each one points into the tables of the modules it imports,
+// so the table of one module is only valid alongside all of the others.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "file.h"
+#include "parser.h"
+#include "str.h"
+
+//returns the cache key of the source text
+uint64_t CacheKey(const source *src);
+
+//thread-safe; returns NULL if the --Cache directory has no usable entry for the
+//key. Otherwise returns the tree in the same state as SyntaxTreeInit, named
+//after the filename, and sets nodes to the --Dstats node count of the parse
+//which created the entry. The whole tree lives in one block of the arena of
+//the calling thread and is released with that arena, so the vectors of a
+//loaded tree must not be pushed to or reallocated; no pass after the parser
+//does either.
+module *CacheLoad(const cstring *filename, const uint64_t key, size_t *nodes);
+
+//returns a copy of the tree in the arena of the calling thread, in the same
+//state as SyntaxTreeInit and with the same name; returns NULL if the tree is
+//too large for an image. The copy is made through a cache image, so like a
+//loaded tree it lives in one arena block and its vectors must not grow.
+module *CacheCopy(const module *root);
+
+//thread-safe; writes the tree of a module with no errors to the --Cache
+//directory. The cache is only an optimisation, so failures are reported to the
+//xerror log and otherwise ignored.
+void CacheStore(const uint64_t key, const module *root, const size_t nodes);
@@ -37,7 +37,9 @@ typedef struct pfix##_channel pfix##_channel;
 //first acquire the top-level mutex.
 //
 //senders wait on cond_full if the queue.len == queue.cap and consumer wait on
-//cond_empty if queue.len == 0.
+//cond_empty if queue.len == 0. Every send and recv signals the opposite side;
+//signalling only on the empty or full transition loses wakeups when more than
+//one thread is waiting.
 //
 //data is the internal buffer with maximum capacity queue.cap and current size
 //queue.len. data[head] is the first element to be dequeued, data[tail] is
@@ -66,7 +68,10 @@ cls void pfix##ChannelInit(pfix##_channel *self, const size_t n);	       \
 cls int pfix##ChannelShutdown(pfix##_channel *self);	                       \
 cls void pfix##ChannelClose(pfix##_channel *self);			       \
 cls int pfix##ChannelSend(pfix##_channel *self, const T datum);	               \
-cls int pfix##ChannelRecv(pfix##_channel *self, T *datum);
+cls int pfix##ChannelRecv(pfix##_channel *self, T *datum);		       \
+cls int pfix##ChannelSendBatch(pfix##_channel *self, const T *data, size_t n); \
+cls int pfix##ChannelRecvBatch(pfix##_channel *self, T *data, size_t max,      \
+			       size_t *n);
 
 //must be invoked before any other channel function
 #define impl_channel_init(T, pfix, cls)					       \
@@ -171,10 +176,8 @@ cls int pfix##ChannelSend(pfix##_channel *self, const T datum)	               \
 	self->tail = (self->tail + 1) % self->cap;			       \
 	self->len++;							       \
 									       \
-	if (self->len == 1) {						       \
-		ChannelTrace("signal; now non-empty");	                       \
-		pthread_cond_signal(&self->cond_empty);			       \
-	}								       \
+	ChannelTrace("signal; now non-empty");	                       	       \
+	pthread_cond_signal(&self->cond_empty);				       \
 									       \
 unlock:									       \
 	pthread_mutex_unlock(&self->mutex);				       \
@@ -208,9 +211,54 @@ cls int pfix##ChannelRecv(pfix##_channel *self, T *datum)		       \
 	self->head = (self->head + 1) % self->cap;			       \
 	self->len--;							       \
 									       \
-	if (self->len == self->cap - 1) {				       \
-		ChannelTrace("signal; now non-full");	                       \
-		pthread_cond_signal(&self->cond_full);			       \
+	ChannelTrace("signal; now non-full");	                               \
+	pthread_cond_signal(&self->cond_full);				       \
+									       \
+unlock:									       \
+	pthread_mutex_unlock(&self->mutex);				       \
+	return err;							       \
+}
+
+//calling thread will suspend without timeout until all n elements are sent; the
+//elements are enqueued in as few groups as the free space allows
+#define impl_channel_send_batch(T, pfix, cls)				       \
+cls int pfix##ChannelSendBatch(pfix##_channel *self, const T *data, size_t n)  \
+{									       \
+	assert(self);							       \
+	assert(data || !n);						       \
+									       \
+	int err = CHANNEL_ESUCCESS;					       \
+									       \
+	pthread_mutex_lock(&self->mutex);				       \
+									       \
+	if (self->flags & CHANNEL_CLOSED) {				       \
+		err = CHANNEL_ECLOSED;					       \
+		ChannelTrace("attempted send on closed queue");                \
+		goto unlock;						       \
+	}								       \
+									       \
+	while (n) {							       \
+		while (self->len == self->cap) {			       \
+			ChannelTrace("full; suspending thread");	       \
+			pthread_cond_wait(&self->cond_full, &self->mutex);     \
+		}							       \
+									       \
+		const size_t room = self->cap - self->len;		       \
+		const size_t total = n < room ? n : room;		       \
+									       \
+		ChannelTrace("sending %zu elements", total);		       \
+									       \
+		for (size_t i = 0; i < total; i++) {			       \
+			self->data[self->tail] = data[i];		       \
+			self->tail = (self->tail + 1) % self->cap;	       \
+		}							       \
+									       \
+		self->len += total;					       \
+		data += total;						       \
+		n -= total;						       \
+									       \
+		ChannelTrace("broadcast; now non-empty");		       \
+		pthread_cond_broadcast(&self->cond_empty);		       \
 	}								       \
 									       \
 unlock:									       \
@@ -218,6 +266,54 @@ unlock:									       \
 	return err;							       \
 }
 
+//calling thread will suspend without timeout if the channel is empty; on
+//success between 1 and max elements are received and their count is placed in
+//n. On failure n is zero.
+#define impl_channel_recv_batch(T, pfix, cls)				       \
+cls int pfix##ChannelRecvBatch(pfix##_channel *self, T *data, size_t max,      \
+			       size_t *n)				       \
+{									       \
+	assert(self);						               \
+	assert(data);							       \
+	assert(max);							       \
+	assert(n);							       \
+									       \
+	int err = CHANNEL_ESUCCESS;					       \
+	*n = 0;								       \
+									       \
+	pthread_mutex_lock(&self->mutex);				       \
+									       \
+	if (self->flags & CHANNEL_CLOSED && self->len == 0) {		       \
+		err = CHANNEL_ECLOSED;					       \
+		ChannelTrace("recv fail; closed empty queue");                 \
+		goto unlock;						       \
+	}							               \
+									       \
+	while (self->len == 0) {					       \
+		ChannelTrace("empty; suspending thread");	               \
+		pthread_cond_wait(&self->cond_empty, &self->mutex);	       \
+	}								       \
+									       \
+	const size_t total = self->len < max ? self->len : max;		       \
+									       \
+	ChannelTrace("receiving %zu elements", total);			       \
+									       \
+	for (size_t i = 0; i < total; i++) {				       \
+		data[i] = self->data[self->head];			       \
+		self->head = (self->head + 1) % self->cap;		       \
+	}								       \
+									       \
+	self->len -= total;						       \
+	*n = total;							       \
+									       \
+	ChannelTrace("broadcast; now non-full");			       \
+	pthread_cond_broadcast(&self->cond_full);			       \
+									       \
+unlock:									       \
+	pthread_mutex_unlock(&self->mutex);				       \
+	return err;							       \
+}
+
 //create a generic channel named pfix_channel which contains elements of type T
 //and calls methods with storage class cls.
 #define make_channel(T, pfix, cls)					       \
@@ -228,6 +324,8 @@ unlock:									       \
 	impl_channel_shutdown(T, pfix, cls)				       \
 	impl_channel_close(T, pfix, cls)				       \
 	impl_channel_send(T, pfix, cls)					       \
-	impl_channel_recv(T, pfix, cls)
+	impl_channel_recv(T, pfix, cls)					       \
+	impl_channel_send_batch(T, pfix, cls)				       \
+	impl_channel_recv_batch(T, pfix, cls)
 
 #define channel(pfix) pfix##_channel
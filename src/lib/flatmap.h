@@ -0,0 +1,499 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Associative array from string keys to any type T, implemented as an open
+// addressing hash table in the style of a Swiss table. The API is identical to
+// map.h, so a make_map directive can be switched to make_flatmap at compile
+// time; both may be used within the same translation unit.
+
+#pragma once
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "map.h"
+#include "str.h"
+#include "xerror.h"
+
+//------------------------------------------------------------------------------
+//The table is divided into groups of 16 slots. Each slot has a control byte in
+//a dense array of its own; the byte is FLATMAP_EMPTY, FLATMAP_DELETED, or, for
+//a slot in use, the low 7 bits of the key hash. A probe loads the 16 control
+//bytes of a group with one SSE2 instruction and only visits the slots whose
+//control byte matches, so the keys and values stored out of line are seldom
+//pulled into cache on a miss.
+//
+//The upper bits of the hash select the starting group and successive groups
+//are probed in order. A removal only empties a slot in a group which already
+//has an empty slot, so a group that is full when an insertion passes over it
+//never regains one. Hence a search may stop at the first group with an empty
+//slot. map.probe is the longest distance from a starting group to a resting
+//group seen so far and ends the searches that never find an empty slot; as in
+//map.h it is a record rather than a worst-case bound.
+
+#define FLATMAP_GROUP ((uint64_t) 16)
+#define FLATMAP_EMPTY ((int8_t) -128)
+#define FLATMAP_DELETED ((int8_t) -2)
+
+//returns a mask whose bit i is set when control byte i of the group is equal
+//to the input byte
+__attribute__((always_inline))
+static inline uint32_t FlatMapMatch(const int8_t *group, const int8_t byte)
+{
+#ifdef __SSE2__
+	const __m128i control = _mm_loadu_si128((const __m128i *) group);
+	const __m128i equal = _mm_cmpeq_epi8(control, _mm_set1_epi8(byte));
+
+	return (uint32_t) _mm_movemask_epi8(equal);
+#else
+	uint32_t mask = 0;
+
+	for (uint32_t i = 0; i < FLATMAP_GROUP; i++) {
+		mask |= (uint32_t) (group[i] == byte) << i;
+	}
+
+	return mask;
+#endif
+}
+
+//returns a mask whose bit i is set when slot i of the group is not in use
+__attribute__((always_inline))
+static inline uint32_t FlatMapMatchFree(const int8_t *group)
+{
+#ifdef __SSE2__
+	const __m128i control = _mm_loadu_si128((const __m128i *) group);
+
+	return (uint32_t) _mm_movemask_epi8(control);
+#else
+	uint32_t mask = 0;
+
+	for (uint32_t i = 0; i < FLATMAP_GROUP; i++) {
+		mask |= (uint32_t) (group[i] < 0) << i;
+	}
+
+	return mask;
+#endif
+}
+
+//the control byte of a slot in use is never negative
+static int8_t FlatMapTag(const uint64_t hash)
+{
+	return (int8_t) (hash & 0x7F);
+}
+
+//rounds the input up to a whole number of groups, or down if it would overflow
+static uint64_t FlatMapCapacity(const uint64_t capacity)
+{
+	const uint64_t mask = FLATMAP_GROUP - 1;
+
+	if (capacity > UINT64_MAX - mask) {
+		return UINT64_MAX & ~mask;
+	}
+
+	if (capacity < FLATMAP_GROUP) {
+		return FLATMAP_GROUP;
+	}
+
+	return (capacity + mask) & ~mask;
+}
+
+//------------------------------------------------------------------------------
+
+#define alias_flatmap_slot(pfix)					       \
+typedef struct pfix##_slot pfix##_slot;
+
+//read-only
+#define declare_flatmap_slot(T, pfix)					       \
+struct pfix##_slot {							       \
+	const cstring *key;						       \
+	uint64_t hash;							       \
+	T value;							       \
+};
+
+#define alias_flatmap(pfix)						       \
+typedef struct pfix##_map pfix##_map;
+
+//read-only
+//map.len, map.removed, and map.probe have the same meaning as in map.h except
+//that the probe distance is measured in groups; map.cap is a multiple of 16
+#define declare_flatmap(T, pfix)					       \
+struct pfix##_map {						               \
+	uint64_t len;							       \
+	uint64_t cap;							       \
+	uint64_t removed;						       \
+	uint64_t probe;							       \
+	int8_t *control;						       \
+	pfix##_slot *buffer;						       \
+};
+
+//------------------------------------------------------------------------------
+
+#define api_flatmap(T, pfix, cls)					       \
+cls pfix##_map pfix##MapInit(const uint64_t);				       \
+cls T * pfix##MapInsert(pfix##_map *, const cstring *, T);		       \
+cls void pfix##MapRehash_private(pfix##_map *, const uint64_t);		       \
+cls T * pfix##MapProbe_private(pfix##_map *, const cstring *, uint64_t, T);    \
+cls void pfix##MapPlace_private(pfix##_map *, const pfix##_slot);	       \
+cls pfix##_slot *pfix##MapFind_private					       \
+(pfix##_map *, const cstring *, const uint64_t);			       \
+cls bool pfix##MapRemove(pfix##_map *, const cstring *);                       \
+cls bool pfix##MapGet(pfix##_map *, const cstring *, T *);		       \
+cls bool pfix##MapGetRef(pfix##_map *self, const cstring *key, T **value);     \
+cls bool pfix##MapGetRefHashed						       \
+(pfix##_map *self, const cstring *key, const uint64_t hash, T **value);	       \
+cls bool pfix##MapSet(pfix##_map *self, const cstring *key, T value);	       \
+cls bool pfix##MapNext							       \
+(const pfix##_map *self, uint64_t *cursor, const cstring **key, T *value);
+
+//------------------------------------------------------------------------------
+
+//capacity is rounded up to a whole number of groups
+#define impl_flatmap_init(T, pfix, cls)					       \
+cls pfix##_map pfix##MapInit(const uint64_t capacity)			       \
+{								               \
+	const uint64_t cap = FlatMapCapacity(capacity);			       \
+									       \
+	struct pfix##_map new = {					       \
+		.len = 0,						       \
+		.cap = cap,						       \
+		.removed = 0,						       \
+		.probe = 0,						       \
+		.control = allocate(cap),				       \
+		.buffer = allocate(cap * sizeof(pfix##_slot))		       \
+	};								       \
+									       \
+	memset(new.control, FLATMAP_EMPTY, cap);			       \
+									       \
+	MapTrace("new flatmap initialized with %" PRIu64 " slots", cap);       \
+									       \
+	return new;							       \
+}
+
+//see MapInsert in map.h; the pointer guarantees are the same. The load factor
+//threshold is 7/8 rather than 1/2, so MAP_MINIMUM_CAPACITY is more than enough
+//to prevent a resize.
+#define impl_flatmap_insert(T, pfix, cls)				       \
+cls T * pfix##MapInsert(pfix##_map *self, const cstring *key, T value)	       \
+{									       \
+	assert(self);							       \
+	assert(self->control);						       \
+	assert(key);							       \
+									       \
+	MapTrace("inserting '%s'", key);				       \
+									       \
+	if (self->len >= self->cap - self->cap / 8) {			       \
+		MapTrace("load factor exceeds threshold");		       \
+									       \
+		const double removed = (double) self->removed;		       \
+		const double share = removed / (double) self->len;	       \
+									       \
+		if (share >= MAP_COMPACTION_THRESHOLD) {		       \
+			pfix##MapRehash_private(self, self->cap);	       \
+		} else {						       \
+			pfix##MapRehash_private(self, MapGrow(self->cap));     \
+		}							       \
+	}								       \
+									       \
+	if (self->len == self->cap) {					       \
+		MapTrace("fail; map is full");				       \
+		abort();						       \
+	}								       \
+									       \
+	return pfix##MapProbe_private(self, key, MapHash(key), value);	       \
+}
+
+//moves every slot in use into a new table with the given capacity, which
+//discards all deleted slots; no-op if capacity cannot expand
+#define impl_flatmap_rehash_private(T, pfix, cls)			       \
+cls void pfix##MapRehash_private(pfix##_map *self, const uint64_t capacity)    \
+{								               \
+	assert(self);							       \
+	assert(self->control);						       \
+									       \
+	if (FlatMapCapacity(capacity) == self->cap && !self->removed) {	       \
+		MapTrace("cannot resize map; maximum capacity reached");       \
+		return;							       \
+	}								       \
+									       \
+	pfix##_map new_map = pfix##MapInit(capacity);			       \
+									       \
+	for (uint64_t i = 0; i < self->cap; i++) {			       \
+		if (self->control[i] >= 0) {				       \
+			pfix##MapPlace_private(&new_map, self->buffer[i]);     \
+		}							       \
+	}								       \
+									       \
+	*self = new_map;						       \
+									       \
+	MapTrace("new map; finalized");					       \
+}
+
+//private; returns NULL if the key exists, otherwise the entry is placed in the
+//first free slot along its probe sequence; key is stored as is
+#define impl_flatmap_probe_private(T, pfix, cls)			       \
+cls T * pfix##MapProbe_private						       \
+(pfix##_map *self, const cstring *key, uint64_t hash, T value)		       \
+{									       \
+	assert(self);							       \
+	assert(self->len < self->cap);					       \
+									       \
+	if (pfix##MapFind_private(self, key, hash)) {			       \
+		MapTrace("'%s' already exists in closed slot", key);	       \
+		return NULL;						       \
+	}								       \
+									       \
+	const uint64_t groups = self->cap / FLATMAP_GROUP;		       \
+	uint64_t g = MapScale(hash, groups);				       \
+	uint64_t distance = 0;						       \
+	uint32_t free = FlatMapMatchFree(self->control + g * FLATMAP_GROUP);   \
+									       \
+	while (!free) {							       \
+		g = (g + 1) % groups;					       \
+		distance++;						       \
+		free = FlatMapMatchFree(self->control + g * FLATMAP_GROUP);    \
+	}								       \
+									       \
+	const uint64_t i = g * FLATMAP_GROUP + (uint64_t) __builtin_ctz(free); \
+									       \
+	if (self->control[i] == FLATMAP_DELETED) {			       \
+		MapTrace("recycling removed slot");			       \
+		self->removed--;					       \
+	} else {							       \
+		self->len++;						       \
+	}								       \
+									       \
+	self->control[i] = FlatMapTag(hash);				       \
+	self->buffer[i] = (pfix##_slot) {				       \
+		.key = key,						       \
+		.hash = hash,						       \
+		.value = value						       \
+	};								       \
+									       \
+	if (distance > self->probe) {					       \
+		self->probe = distance;					       \
+	}								       \
+									       \
+	return &self->buffer[i].value;					       \
+}
+
+//private; copies a slot from another map into the first empty slot along its
+//probe sequence. The map must not contain deleted slots or the key.
+#define impl_flatmap_place_private(T, pfix, cls)			       \
+cls void pfix##MapPlace_private(pfix##_map *self, const pfix##_slot entry)     \
+{									       \
+	assert(self);							       \
+	assert(self->len < self->cap);					       \
+	assert(!self->removed);						       \
+									       \
+	const uint64_t groups = self->cap / FLATMAP_GROUP;		       \
+	uint64_t g = MapScale(entry.hash, groups);			       \
+	uint64_t distance = 0;						       \
+	uint32_t free = FlatMapMatchFree(self->control + g * FLATMAP_GROUP);   \
+									       \
+	while (!free) {							       \
+		g = (g + 1) % groups;					       \
+		distance++;						       \
+		free = FlatMapMatchFree(self->control + g * FLATMAP_GROUP);    \
+	}								       \
+									       \
+	const uint64_t i = g * FLATMAP_GROUP + (uint64_t) __builtin_ctz(free); \
+									       \
+	self->control[i] = FlatMapTag(entry.hash);			       \
+	self->buffer[i] = entry;					       \
+	self->len++;							       \
+									       \
+	if (distance > self->probe) {					       \
+		self->probe = distance;					       \
+	}								       \
+}
+
+//returns the slot which holds the key or NULL if it does not exist
+#define impl_flatmap_find_private(T, pfix, cls)				       \
+cls pfix##_slot *pfix##MapFind_private					       \
+(pfix##_map *self, const cstring *key, const uint64_t hash)		       \
+{									       \
+	assert(self);							       \
+	assert(self->control);						       \
+	assert(key);							       \
+									       \
+	const uint64_t groups = self->cap / FLATMAP_GROUP;		       \
+	const int8_t tag = FlatMapTag(hash);				       \
+	uint64_t g = MapScale(hash, groups);				       \
+									       \
+	for (uint64_t distance = 0; distance <= self->probe; distance++) {     \
+		const int8_t *group = self->control + g * FLATMAP_GROUP;       \
+		uint32_t match = FlatMapMatch(group, tag);		       \
+									       \
+		while (match) {						       \
+			const uint64_t bit = (uint64_t) __builtin_ctz(match);  \
+			const uint64_t i = g * FLATMAP_GROUP + bit;	       \
+			pfix##_slot *slot = self->buffer + i;		       \
+									       \
+			if (slot->hash == hash && MapMatch(slot->key, key)) {  \
+				MapTrace("found '%s'", key);		       \
+				return slot;				       \
+			}						       \
+									       \
+			match &= match - 1;				       \
+		}							       \
+									       \
+		if (FlatMapMatch(group, FLATMAP_EMPTY)) {		       \
+			MapTrace("found empty slot; '%s' cannot exist", key);  \
+			return NULL;					       \
+		}							       \
+									       \
+		g = (g + 1) % groups;					       \
+	}								       \
+									       \
+	MapTrace("probe limit reached; '%s' does not exist", key);	       \
+	return NULL;							       \
+}
+
+//a group that already has an empty slot ends every search which reaches it, so
+//a slot removed from it can be emptied rather than marked as deleted
+#define impl_flatmap_remove(T, pfix, cls)				       \
+cls bool pfix##MapRemove(pfix##_map *self, const cstring *key)		       \
+{								               \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, MapHash(key));    \
+									       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
+									       \
+	const uint64_t i = (uint64_t) (slot - self->buffer);		       \
+	const int8_t *group = self->control + i - i % FLATMAP_GROUP;	       \
+									       \
+	if (FlatMapMatch(group, FLATMAP_EMPTY)) {			       \
+		self->control[i] = FLATMAP_EMPTY;			       \
+		self->len--;						       \
+	} else {							       \
+		self->control[i] = FLATMAP_DELETED;			       \
+		self->removed++;					       \
+	}								       \
+									       \
+	MapTrace("'%s' removed", key);					       \
+	return true;							       \
+}
+
+#define impl_flatmap_get(T, pfix, cls)					       \
+cls bool pfix##MapGet(pfix##_map *self, const cstring *key, T *value)	       \
+{									       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, MapHash(key));    \
+									       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
+									       \
+	if (value) {							       \
+		*value = slot->value;					       \
+	}								       \
+									       \
+	return true;							       \
+}
+
+#define impl_flatmap_get_ref(T, pfix, cls)				       \
+cls bool pfix##MapGetRef(pfix##_map *self, const cstring *key, T **value)      \
+{									       \
+	return pfix##MapGetRefHashed(self, key, MapHash(key), value);	       \
+}
+
+#define impl_flatmap_get_ref_hashed(T, pfix, cls)			       \
+cls bool pfix##MapGetRefHashed						       \
+(pfix##_map *self, const cstring *key, const uint64_t hash, T **value)	       \
+{									       \
+	assert(hash == MapHash(key));					       \
+									       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, hash);	       \
+									       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
+									       \
+	if (value) {							       \
+		*value = &slot->value;					       \
+	}								       \
+									       \
+	return true;							       \
+}
+
+#define impl_flatmap_set(T, pfix, cls)					       \
+cls bool pfix##MapSet(pfix##_map *self, const cstring *key, T value)	       \
+{									       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, MapHash(key));    \
+									       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
+									       \
+	slot->value = value;						       \
+									       \
+	return true;							       \
+}
+
+#define impl_flatmap_next(T, pfix, cls)					       \
+cls bool pfix##MapNext							       \
+(const pfix##_map *self, uint64_t *cursor, const cstring **key, T *value)      \
+{									       \
+	assert(self);							       \
+	assert(cursor);							       \
+									       \
+	for (uint64_t i = *cursor; i < self->cap; i++) {		       \
+		if (self->control[i] < 0) {				       \
+			continue;					       \
+		}							       \
+									       \
+		if (key) {						       \
+			*key = self->buffer[i].key;			       \
+		}							       \
+									       \
+		if (value) {						       \
+			*value = self->buffer[i].value;			       \
+		}							       \
+									       \
+		*cursor = i + 1;					       \
+		return true;						       \
+	}								       \
+									       \
+	*cursor = self->cap;						       \
+	return false;							       \
+}
+
+//------------------------------------------------------------------------------
+
+//make_flatmap declares a map<T> type named pfix_map with the same API as the
+//type declared by make_map; see map.h
+#define make_flatmap(T, pfix, cls)					       \
+	alias_flatmap_slot(pfix)					       \
+	declare_flatmap_slot(T, pfix)					       \
+	alias_flatmap(pfix)						       \
+	declare_flatmap(T, pfix)					       \
+	api_flatmap(T, pfix, cls)					       \
+	impl_flatmap_init(T, pfix, cls)					       \
+	impl_flatmap_insert(T, pfix, cls)				       \
+	impl_flatmap_rehash_private(T, pfix, cls)			       \
+	impl_flatmap_probe_private(T, pfix, cls)			       \
+	impl_flatmap_place_private(T, pfix, cls)			       \
+	impl_flatmap_find_private(T, pfix, cls)				       \
+	impl_flatmap_remove(T, pfix, cls)				       \
+	impl_flatmap_get(T, pfix, cls)					       \
+	impl_flatmap_get_ref(T, pfix, cls)				       \
+	impl_flatmap_get_ref_hashed(T, pfix, cls)			       \
+	impl_flatmap_set(T, pfix, cls)					       \
+	impl_flatmap_next(T, pfix, cls)
+
+//make_table expands to make_flatmap when the compiler flag -DFLATMAP is given
+//and to make_map otherwise. The symbol tables and the dependency graph use it
+//so that the two backends can be compared without any other source changes.
+#ifdef FLATMAP
+	#define make_table(T, pfix, cls) make_flatmap(T, pfix, cls)
+#else
+	#define make_table(T, pfix, cls) make_map(T, pfix, cls)
+#endif
@@ -2,7 +2,7 @@
 //
 // Graph data structure represented via an adjacency list. Implemented as a hash
 // table from cstring keys to verticies with a generic type T. The graph is just
-// a shallow wrapper over map.h.
+// a shallow wrapper over map.h, or flatmap.h when built with -DFLATMAP.
 
 #pragma once
 
@@ -10,7 +10,7 @@
 #include <string.h>
 
 #include "arena.h"
-#include "map.h"
+#include "flatmap.h"
 #include "xerror.h"
 
 #ifdef GRAPH_TRACE
@@ -74,7 +74,7 @@ cls bool pfix##GraphModify(pfix##_graph *self, const cstring *key, T vertex)   \
 //compile time before make_graph then each component macro must be expanded
 //separately.
 #define make_graph(T, pfix, cls)		                               \
-	make_map(T, pfix, cls)					               \
+	make_table(T, pfix, cls)					       \
 	alias_graph(pfix)					               \
 	api_graph(T, pfix, cls)					               \
 	impl_graph_init(T, pfix, cls)					       \
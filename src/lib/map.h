@@ -46,9 +46,10 @@ static uint64_t MapGrow(uint64_t curr_capacity)
 	return curr_capacity * growth_rate;
 }
 
+//interned keys are equal only if they are the same pointer
 static bool MapMatch(const cstring *a, const cstring *b)
 {
-	return !strcmp(a, b);
+	return a == b || !strcmp(a, b);
 }
 
 //------------------------------------------------------------------------------
@@ -75,6 +76,21 @@ static uint64_t MapFNV1a(const cstring *cstr)
 	return hash;
 }
 
+//the MurmurHash3 64-bit finalizer, which is in the public domain. FNV-1a mixes
+//the final bytes of a key into the low bits of the hash only, but MapScale
+//takes the slot from the high bits; without this step keys that differ only in
+//their last few characters land in long runs of neighbouring slots.
+static uint64_t MapMix(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= (uint64_t) 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= (uint64_t) 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
 //tranform value to [0, upper_bound) via an optimized multiply + divide.
 static uint64_t MapScale(const uint64_t value, const uint64_t upper_bound)
 {
@@ -83,10 +99,33 @@ static uint64_t MapScale(const uint64_t value, const uint64_t upper_bound)
 	return (uint64_t) (mult >> 64);
 }
 
+//returns the hash of a key as it is stored in a map slot; pass it to the Hashed
+//variants of the map functions to avoid rehashing a key that is looked up in
+//several maps
 __attribute__((always_inline)) inline
-static uint64_t MapGetSlotIndex(const cstring *cstr, const uint64_t upper_bound)
+static uint64_t MapHash(const cstring *cstr)
 {
-	return MapScale(MapFNV1a(cstr), upper_bound);
+	return MapMix(MapFNV1a(cstr));
+}
+
+//equal to MapHash on a cstring copy of the len bytes at data
+static uint64_t MapHashView(const char *data, const size_t len)
+{
+	assert(data || !len);
+
+	const uint64_t fnv_offset = (uint64_t) 14695981039346656037ULL;
+	const uint64_t fnv_prime  = (uint64_t) 1099511628211ULL;
+
+	uint64_t hash = fnv_offset;
+
+	const uint8_t *buffer = (const uint8_t *) data;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (uint64_t) buffer[i];
+		hash *= fnv_prime;
+	}
+
+	return MapMix(hash);
 }
 
 //------------------------------------------------------------------------------
@@ -101,9 +140,12 @@ enum slot_status {
 };
 
 //read-only
+//the hash of the key is kept in the slot so that probes compare it before they
+//compare strings and so that rehashing never reads the key
 #define declare_slot(T, pfix)						       \
 struct pfix##_slot {							       \
 	const cstring *key;						       \
+	uint64_t hash;							       \
 	T value;							       \
 	enum slot_status status;				               \
 };
@@ -112,11 +154,18 @@ struct pfix##_slot {							       \
 typedef struct pfix##_map pfix##_map;
 
 //read-only
-//map.len is the total closed and removed slots
+//map.len is the total closed and removed slots and map.removed is the number of
+//removed slots. map.probe is the largest distance from a closed slot to the
+//slot its key hashes to over every insertion since the map was created or last
+//rehashed; lookups never search past it. It is a record, not a bound: nothing
+//limits it below map.cap, so keys whose hashes share a home make a lookup
+//linear in the number of such keys, and the map has no worst-case bound.
 #define declare_map(T, pfix)						       \
 struct pfix##_map {						               \
 	uint64_t len;							       \
 	uint64_t cap;							       \
+	uint64_t removed;						       \
+	uint64_t probe;							       \
 	pfix##_slot *buffer;						       \
 };
 
@@ -125,12 +174,19 @@ struct pfix##_map {						               \
 #define api_map(T, pfix, cls)					               \
 cls pfix##_map pfix##MapInit(const uint64_t);				       \
 cls T * pfix##MapInsert(pfix##_map *, const cstring *, T);		       \
-cls void pfix##MapResize_private(pfix##_map *);			               \
-cls T * pfix##MapProbe_private(pfix##_map *, const cstring *, T);	       \
+cls void pfix##MapRehash_private(pfix##_map *, const uint64_t);		       \
+cls T * pfix##MapProbe_private(pfix##_map *, const cstring *, uint64_t, T);    \
+cls void pfix##MapPlace_private(pfix##_map *, const pfix##_slot);	       \
+cls pfix##_slot *pfix##MapFind_private					       \
+(pfix##_map *, const cstring *, const uint64_t);			       \
 cls bool pfix##MapRemove(pfix##_map *, const cstring *);                       \
 cls bool pfix##MapGet(pfix##_map *, const cstring *, T *);		       \
 cls bool pfix##MapGetRef(pfix##_map *self, const cstring *key, T **value);     \
-cls bool pfix##MapSet(pfix##_map *self, const cstring *key, T value);
+cls bool pfix##MapGetRefHashed						       \
+(pfix##_map *self, const cstring *key, const uint64_t hash, T **value);	       \
+cls bool pfix##MapSet(pfix##_map *self, const cstring *key, T value);	       \
+cls bool pfix##MapNext							       \
+(const pfix##_map *self, uint64_t *cursor, const cstring **key, T *value);
 
 //------------------------------------------------------------------------------
 
@@ -140,6 +196,10 @@ cls bool pfix##MapSet(pfix##_map *self, const cstring *key, T value);
 //elements and you need to eliminate or reduce dynamic resizing
 #define MAP_MINIMUM_CAPACITY(capacity) MapGrow(capacity)
 
+//a map whose load factor is exceeded is rehashed at its current capacity rather
+//than grown when at least this share of map.len is made up of removed slots
+#define MAP_COMPACTION_THRESHOLD 0.5
+
 #define impl_map_init(T, pfix, cls)					       \
 cls pfix##_map pfix##MapInit(const uint64_t capacity)			       \
 {								               \
@@ -150,6 +210,8 @@ cls pfix##_map pfix##MapInit(const uint64_t capacity)			       \
 	struct pfix##_map new = {					       \
 		.len = 0,						       \
 		.cap = capacity,					       \
+		.removed = 0,						       \
+		.probe = 0,						       \
 		.buffer = allocate(bufsize)                                    \
 	};								       \
 								               \
@@ -165,13 +227,17 @@ cls pfix##_map pfix##MapInit(const uint64_t capacity)			       \
 //abort if map.len == UINT64_MAX
 //
 //returns NULL if key already exists; it must be removed before a new insertion.
-//key is duplicated onto heap when stored in the hash table.
+//the key is not copied, so it must outlive the map; interned strings and arena
+//strings which are never modified qualify.
 //
 //the value is copied into the hash table and on success a pointer to the copy
 //is returned. Due to dynamic resizing, this pointer is only valid until the
 //next MapInsert call. If the MAP_MINIMUM_CAPACITY macro was used on MapInit and
 //the user can guarantee insertions will not exceed the minimum, then the return
 //pointer will always remain valid on subsequent insertions.
+//
+//when the load factor is exceeded and removed slots make up a large share of
+//map.len, the map is rehashed at its current capacity instead of growing.
 #define impl_map_insert(T, pfix, cls)					       \
 cls T * pfix##MapInsert(pfix##_map *self, const cstring *key, T value)          \
 {									       \
@@ -192,167 +258,175 @@ cls T * pfix##MapInsert(pfix##_map *self, const cstring *key, T value)
 	if (load_factor > load_factor_threshold) {			       \
 		MapTrace("load factor %g exceeds threshold", load_factor);     \
 		MapTrace("suspending insert of '%s'", key);		       \
-		pfix##MapResize_private(self);				       \
+									       \
+		const double removed = (double) self->removed;		       \
+		const double share = removed / (double) self->len;	       \
+									       \
+		if (share >= MAP_COMPACTION_THRESHOLD) {		       \
+			pfix##MapRehash_private(self, self->cap);	       \
+		} else {						       \
+			pfix##MapRehash_private(self, MapGrow(self->cap));     \
+		}							       \
+									       \
 		MapTrace("resume insert of '%s'", key);			       \
 	}								       \
 									       \
-	return pfix##MapProbe_private(self, key, value);		       \
+	return pfix##MapProbe_private(self, key, MapHash(key), value);	       \
 }
 
-//no-op if capacity cannot expand
-#define impl_map_resize_private(T, pfix, cls)			               \
-cls void pfix##MapResize_private(pfix##_map *self)			       \
+//moves every closed slot into a new buffer with the given capacity, which
+//discards all removed slots; no-op if capacity cannot expand
+#define impl_map_rehash_private(T, pfix, cls)			               \
+cls void pfix##MapRehash_private(pfix##_map *self, const uint64_t capacity)    \
 {								               \
 	assert(self);							       \
 	assert(self->buffer);						       \
+	assert(capacity >= self->cap);					       \
 									       \
-	if (self->cap == UINT64_MAX) {					       \
+	if (capacity == self->cap && !self->removed) {			       \
 		MapTrace("cannot resize map; maximum capacity reached");       \
 		return;							       \
 	}								       \
 									       \
-	const uint64_t new_capacity = MapGrow(self->cap);		       \
-	pfix##_map new_map = pfix##MapInit(new_capacity);		       \
+	pfix##_map new_map = pfix##MapInit(capacity);			       \
 									       \
 	for (uint64_t i = 0; i < self->cap; i++) {			       \
 		const pfix##_slot slot = self->buffer[i];		       \
 									       \
 		if (slot.status == SLOT_CLOSED) {		               \
-			const cstring *k = slot.key;			       \
-			T v = slot.value;				       \
-									       \
-			MapTrace("new map; inserting' %s'", k);		       \
-									       \
-			bool ok = pfix##MapProbe_private(&new_map, k, v);      \
-									       \
-			assert(ok && "key already exists in new buffer");      \
+			MapTrace("new map; inserting' %s'", slot.key);	       \
+			pfix##MapPlace_private(&new_map, slot);		       \
 		}							       \
 	}								       \
 								               \
 	MapTrace("old map; all closed slots copied");			       \
 									       \
-	*self = (pfix##_map) {						       \
-		.len = new_map.len,					       \
-		.cap = new_map.cap,					       \
-		.buffer = new_map.buffer				       \
-	};								       \
+	*self = new_map;						       \
 									       \
 	MapTrace("new map; finalized");					       \
 }
 
 //this function assumes there is at least one open slot in the map buffer.
 //if the key already exists in a closed slot then do nothing and return false.
-//private; see MapInsert docs; key is duplicated and value is copied.
+//private; see MapInsert docs; key is stored as is and value is copied.
+//
+//the new entry is placed in the first removed slot along its probe sequence if
+//there is one. Since no closed slot lies further than map.probe from its home,
+//the search for a duplicate key ends after map.probe steps and a removed slot
+//found by then is safe to recycle.
 #define impl_map_linear_probe_private(T, pfix, cls)  			       \
-cls T * pfix##MapProbe_private(pfix##_map *self, const cstring *key, T value)  \
+cls T * pfix##MapProbe_private						       \
+(pfix##_map *self, const cstring *key, uint64_t hash, T value)		       \
 {									       \
 	assert(self);							       \
 	assert(self->buffer);						       \
 	assert(self->len < self->cap);					       \
 	assert(key);							       \
 									       \
-	uint64_t i = MapGetSlotIndex(key, self->cap);			       \
+	uint64_t i = MapScale(hash, self->cap);				       \
 	pfix##_slot *slot = self->buffer + i;				       \
+	pfix##_slot *recycle = NULL;					       \
+	uint64_t distance = 0;						       \
+	uint64_t recycle_distance = 0;					       \
 									       \
 	while (slot->status != SLOT_OPEN) {				       \
-		if (slot->status == SLOT_CLOSED && MapMatch(key, slot->key)) { \
+		if (slot->status == SLOT_CLOSED && slot->hash == hash	       \
+		    && MapMatch(key, slot->key)) {			       \
 			MapTrace("'%s' already exists in closed slot", key);   \
 			return NULL;					       \
 		}							       \
 									       \
+		if (slot->status == SLOT_REMOVED && !recycle) {		       \
+			recycle = slot;					       \
+			recycle_distance = distance;			       \
+		}							       \
+									       \
+		if (recycle && distance >= self->probe) {		       \
+			break;						       \
+		}							       \
+									       \
 		i = (i + 1) % self->cap;				       \
 		slot = self->buffer + i;				       \
+		distance++;						       \
+	}								       \
+									       \
+	if (recycle) {							       \
+		MapTrace("recycling removed slot");			       \
+		slot = recycle;						       \
+		distance = recycle_distance;				       \
+		self->removed--;					       \
+	} else {							       \
+		self->len++;						       \
 	}								       \
 									       \
 	*slot = (pfix##_slot) {						       \
-		.key = cStringDuplicate(key),				       \
+		.key = key,						       \
+		.hash = hash,						       \
 		.value = value,						       \
 		.status = SLOT_CLOSED					       \
 	};							               \
 									       \
-	self->len++;							       \
+	if (distance > self->probe) {					       \
+		self->probe = distance;					       \
+	}								       \
 									       \
 	MapTrace("linear probe succeeded");			               \
 									       \
 	return &slot->value;						       \
 }
 
-//internal note; removed slots count towards the load factor, so they do not
-//decrease map.len.
-#define impl_map_remove(T, pfix, cls)					       \
-cls bool pfix##MapRemove(pfix##_map *self, const cstring *key)		       \
-{								               \
+//private; copies a closed slot from another map into the first open slot along
+//its probe sequence. The map must not contain removed slots or the key.
+#define impl_map_place_private(T, pfix, cls)				       \
+cls void pfix##MapPlace_private(pfix##_map *self, const pfix##_slot entry)     \
+{									       \
 	assert(self);							       \
 	assert(self->buffer);						       \
-	assert(key);							       \
-									       \
-	uint64_t i = MapGetSlotIndex(key, self->cap);			       \
-	const uint64_t start = i;					       \
-	pfix##_slot *slot = self->buffer + i;				       \
-									       \
-	MapTrace("searching for '%s' removal slot", key); 		       \
-									       \
-	do {								       \
-		switch (slot->status) {					       \
-		case SLOT_OPEN:						       \
-			MapTrace("found open slot; '%s' cannot exist", key);   \
-			return false;					       \
-									       \
-		case SLOT_CLOSED:					       \
-			if (MapMatch(slot->key, key)) {			       \
-				slot->status = SLOT_REMOVED;		       \
-				MapTrace("'%s' removed", key);   	       \
-				return true;				       \
-			}						       \
+	assert(self->len < self->cap);					       \
+	assert(!self->removed);						       \
+	assert(entry.status == SLOT_CLOSED);				       \
 									       \
-			break;						       \
+	uint64_t i = MapScale(entry.hash, self->cap);			       \
+	uint64_t distance = 0;						       \
 									       \
-		case SLOT_REMOVED:					       \
-			break;						       \
+	while (self->buffer[i].status != SLOT_OPEN) {			       \
+		i = (i + 1) % self->cap;				       \
+		distance++;						       \
+	}								       \
 									       \
-		default:					 	       \
-			assert(0 != 0 && "bad status flag");		       \
-		}							       \
+	self->buffer[i] = entry;					       \
+	self->len++;							       \
 									       \
-		i = (i + 1) % self->cap;				       \
-		slot = self->buffer + i;				       \
-	} while (i != start);						       \
-								               \
-	/* reach here when key doesn't exist and map.len == map.cap */	       \
-	MapTrace("exhaustive search; '%s' does not exist", key);	       \
-	return false;							       \
+	if (distance > self->probe) {					       \
+		self->probe = distance;					       \
+	}								       \
 }
 
-//input value pointer may be NULL; if key does not exist then *value is not
-//modified on return.
-#define impl_map_get(T, pfix, cls)					       \
-cls bool pfix##MapGet(pfix##_map *self, const cstring *key, T *value)	       \
+//returns the closed slot which holds the key or NULL if it does not exist. At
+//most map.probe + 1 slots are examined even when the map contains no open slot.
+#define impl_map_find_private(T, pfix, cls)				       \
+cls pfix##_slot *pfix##MapFind_private					       \
+(pfix##_map *self, const cstring *key, const uint64_t hash)		       \
 {									       \
 	assert(self);							       \
 	assert(self->buffer);						       \
 	assert(key);							       \
 									       \
-	uint64_t i = MapGetSlotIndex(key, self->cap);			       \
-	const uint64_t start = i;					       \
+	uint64_t i = MapScale(hash, self->cap);				       \
 	pfix##_slot *slot = self->buffer + i;				       \
 									       \
 	MapTrace("searching for '%s' slot", key);			       \
 									       \
-	do {								       \
+	for (uint64_t distance = 0; distance <= self->probe; distance++) {     \
 		switch (slot->status) {					       \
 		case SLOT_OPEN:						       \
 			MapTrace("found open slot; '%s' cannot exist", key);   \
-			return false;					       \
+			return NULL;					       \
 									       \
 		case SLOT_CLOSED:					       \
-			if (MapMatch(slot->key, key)) {			       \
+			if (slot->hash == hash && MapMatch(slot->key, key)) {  \
 				MapTrace("found '%s'", key);		       \
-									       \
-				if (value) {				       \
-					*value = slot->value;		       \
-				}					       \
-									       \
-				return true;				       \
+				return slot;				       \
 			}						       \
 									       \
 			break;						       \
@@ -366,11 +440,59 @@ cls bool pfix##MapGet(pfix##_map *self, const cstring *key, T *value)	       \
 									       \
 		i = (i + 1) % self->cap;				       \
 		slot = self->buffer + i;				       \
-	} while (i != start);						       \
+	}								       \
 									       \
-	/* reach here when key doesn't exist and map.len == map.cap */	       \
-	MapTrace("exhaustive search; '%s' does not exist", key);	       \
-	return false;							       \
+	MapTrace("probe limit reached; '%s' does not exist", key);	       \
+	return NULL;							       \
+}
+
+//internal note; removed slots count towards the load factor, so they do not
+//decrease map.len. A removed slot that is followed by an open slot cannot be
+//part of a longer probe sequence, so it is reopened immediately.
+#define impl_map_remove(T, pfix, cls)					       \
+cls bool pfix##MapRemove(pfix##_map *self, const cstring *key)		       \
+{								               \
+	assert(self);							       \
+	assert(self->buffer);						       \
+	assert(key);							       \
+									       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, MapHash(key));    \
+									       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
+									       \
+	const uint64_t i = (uint64_t) (slot - self->buffer);		       \
+	const pfix##_slot *next = self->buffer + (i + 1) % self->cap;	       \
+									       \
+	if (next->status == SLOT_OPEN) {				       \
+		slot->status = SLOT_OPEN;				       \
+		self->len--;						       \
+	} else {							       \
+		slot->status = SLOT_REMOVED;				       \
+		self->removed++;					       \
+	}								       \
+									       \
+	MapTrace("'%s' removed", key);					       \
+	return true;							       \
+}
+
+//input value pointer may be NULL; if key does not exist then *value is not
+//modified on return.
+#define impl_map_get(T, pfix, cls)					       \
+cls bool pfix##MapGet(pfix##_map *self, const cstring *key, T *value)	       \
+{									       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, MapHash(key));    \
+									       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
+									       \
+	if (value) {							       \
+		*value = slot->value;					       \
+	}								       \
+									       \
+	return true;							       \
 }
 
 //identical to impl_map_get except it copies a pointer to the hash table slot
@@ -381,93 +503,87 @@ cls bool pfix##MapGet(pfix##_map *self, const cstring *key, T *value)	       \
 #define impl_map_get_ref(T, pfix, cls)					       \
 cls bool pfix##MapGetRef(pfix##_map *self, const cstring *key, T **value)      \
 {									       \
-	assert(self);							       \
-	assert(self->buffer);						       \
-	assert(key);							       \
-									       \
-	uint64_t i = MapGetSlotIndex(key, self->cap);			       \
-	const uint64_t start = i;					       \
-	pfix##_slot *slot = self->buffer + i;				       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, MapHash(key));    \
 									       \
-	MapTrace("searching for '%s' slot", key);			       \
-									       \
-	do {								       \
-		switch (slot->status) {					       \
-		case SLOT_OPEN:						       \
-			MapTrace("found open slot; '%s' cannot exist", key);   \
-			return false;					       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
 									       \
-		case SLOT_CLOSED:					       \
-			if (MapMatch(slot->key, key)) {			       \
-				MapTrace("found '%s'", key);		       \
+	if (value) {							       \
+		*value = &slot->value;					       \
+	}								       \
 									       \
-				if (value) {				       \
-					*value = &slot->value;		       \
-				}					       \
+	return true;							       \
+}
+
+//identical to impl_map_get_ref except the hash of the key is given by the
+//caller, who must have obtained it from MapHash
+#define impl_map_get_ref_hashed(T, pfix, cls)				       \
+cls bool pfix##MapGetRefHashed						       \
+(pfix##_map *self, const cstring *key, const uint64_t hash, T **value)	       \
+{									       \
+	assert(hash == MapHash(key));					       \
 									       \
-				return true;				       \
-			}						       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, hash);	       \
 									       \
-			break;						       \
-								               \
-		case SLOT_REMOVED:					       \
-			break;						       \
-									       \
-		default:						       \
-			assert(0 != 0 && "bad status flag");		       \
-		}							       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
 									       \
-		i = (i + 1) % self->cap;				       \
-		slot = self->buffer + i;				       \
-	} while (i != start);						       \
+	if (value) {							       \
+		*value = &slot->value;					       \
+	}								       \
 									       \
-	/* reach here when key doesn't exist and map.len == map.cap */	       \
-	MapTrace("exhaustive search; '%s' does not exist", key);	       \
-	return false;							       \
+	return true;							       \
 }
+
 //set an existing map value associated with the input key to a new value. If
 //the key doesn't exist, return false.
 #define impl_map_set(T, pfix, cls)					       \
 cls bool pfix##MapSet(pfix##_map *self, const cstring *key, T value)	       \
 {									       \
-	assert(self);							       \
-	assert(self->buffer);						       \
-	assert(key);							       \
+	pfix##_slot *slot = pfix##MapFind_private(self, key, MapHash(key));    \
 									       \
-	uint64_t i = MapGetSlotIndex(key, self->cap);			       \
-	const uint64_t start = i;					       \
-	pfix##_slot *slot = self->buffer + i;				       \
+	if (!slot) {							       \
+		return false;						       \
+	}								       \
 									       \
-	MapTrace("searching for '%s' slot", key);			       \
-								               \
-	do {								       \
-		switch (slot->status) {					       \
-		case SLOT_OPEN:						       \
-			MapTrace("found open slot; '%s' cannot exist", key);   \
-			return false;					       \
+	MapTrace("found '%s'; exchanging value", key);			       \
+	slot->value = value;						       \
 									       \
-		case SLOT_CLOSED:					       \
-			if (MapMatch(slot->key, key)) {			       \
-				MapTrace("found '%s'; exchanging value", key); \
-				slot->value = value;			       \
-				return true;				       \
-			}						       \
+	return true;							       \
+}
+
+//iterates over the entries in an unspecified order. The cursor must be zero on
+//the first call; returns false once every entry has been visited. Either of the
+//key and value pointers may be NULL.
+#define impl_map_next(T, pfix, cls)					       \
+cls bool pfix##MapNext							       \
+(const pfix##_map *self, uint64_t *cursor, const cstring **key, T *value)      \
+{									       \
+	assert(self);							       \
+	assert(cursor);							       \
 									       \
-			break;						       \
-								               \
-		case SLOT_REMOVED:					       \
-			break;						       \
+	for (uint64_t i = *cursor; i < self->cap; i++) {		       \
+		const pfix##_slot *slot = self->buffer + i;		       \
 									       \
-		default:						       \
-			assert(0 != 0 && "bad status flag");		       \
+		if (slot->status != SLOT_CLOSED) {			       \
+			continue;					       \
 		}							       \
 									       \
-		i = (i + 1) % self->cap;				       \
-		slot = self->buffer + i;				       \
-	} while (i != start);						       \
+		if (key) {						       \
+			*key = slot->key;				       \
+		}							       \
+									       \
+		if (value) {						       \
+			*value = slot->value;				       \
+		}							       \
+									       \
+		*cursor = i + 1;					       \
+		return true;						       \
+	}								       \
 									       \
-	/* reach here when key doesn't exist and map.len == map.cap */	       \
-	MapTrace("exhaustive search; '%s' does not exist", key);	       \
+	*cursor = self->cap;						       \
 	return false;							       \
 }
 
@@ -485,11 +601,15 @@ cls bool pfix##MapSet(pfix##_map *self, const cstring *key, T value)	       \
 	api_map(T, pfix, cls)					               \
 	impl_map_init(T, pfix, cls)				               \
 	impl_map_insert(T, pfix, cls)					       \
-	impl_map_resize_private(T, pfix, cls)				       \
+	impl_map_rehash_private(T, pfix, cls)				       \
 	impl_map_linear_probe_private(T, pfix, cls)			       \
+	impl_map_place_private(T, pfix, cls)				       \
+	impl_map_find_private(T, pfix, cls)				       \
 	impl_map_remove(T, pfix, cls)				               \
 	impl_map_get(T, pfix, cls)					       \
 	impl_map_get_ref(T, pfix, cls)				               \
-	impl_map_set(T, pfix, cls)
+	impl_map_get_ref_hashed(T, pfix, cls)				       \
+	impl_map_set(T, pfix, cls)					       \
+	impl_map_next(T, pfix, cls)
 
 #define map(pfix) pfix##_map
@@ -0,0 +1,339 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Single-producer single-consumer lock-free FIFO blocking queue with a fixed
+// buffer length. The API is identical to the generic channel, so a pipeline
+// with exactly one sender thread and one receiver thread can switch between the
+// two by changing its make_channel directive to make_spsc_channel.
+
+#pragma once
+
+#include <assert.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "channel.h"
+#include "xerror.h"
+
+//the head and tail indices are separated by at least this many bytes so that
+//the producer and the consumer never write to the same cache line
+#define SPSC_CACHE_LINE ((size_t) 64)
+
+//number of failed polls before a thread suspends on the futex, and number of
+//polls a woken thread waits for half the buffer to become available
+#define SPSC_SPIN_LIMIT 64
+
+//------------------------------------------------------------------------------
+//head and tail are free-running counters; the slot of a counter c is c % cap
+//and the queue length is tail - head. Only the consumer writes head and only
+//the producer writes tail, so each index is published with release semantics
+//and observed by the other side with acquire semantics.
+//
+//A thread that spins SPSC_SPIN_LIMIT times without progress registers itself
+//in waiters and sleeps on the futex word seq. After each send, recv, or close
+//the active thread checks waiters and, if it is nonzero, bumps seq and wakes
+//the sleeper. The sequentially consistent fences on both sides guarantee that
+//either the sleeper sees the new index or the waker sees the sleeper, so every
+//publication of an index wakes a sleeper and a suspension needs no timeout.
+//
+//A woken thread which finds less than half the buffer available polls up to
+//SPSC_SPIN_LIMIT more times before it acts on what it found, so that the other
+//side can fill or drain more of the buffer first. This only batches the work;
+//the thread proceeds with a single element once the polls run out.
+
+#define declare_spsc_channel(T, pfix)					       \
+struct pfix##_channel {							       \
+	atomic_size_t head;						       \
+	char head_padding[SPSC_CACHE_LINE - sizeof(atomic_size_t)];	       \
+	atomic_size_t tail;						       \
+	char tail_padding[SPSC_CACHE_LINE - sizeof(atomic_size_t)];	       \
+	atomic_uint seq;						       \
+	atomic_uint waiters;						       \
+	size_t cap;							       \
+	T *data;							       \
+	_Atomic unsigned char flags;					       \
+};
+
+//------------------------------------------------------------------------------
+//futex helpers shared by every spsc channel
+
+static inline void SpscPause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#else
+	atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+//suspend the calling thread if *seq still equals expected
+static inline void SpscFutexWait(atomic_uint *seq, unsigned int expected)
+{
+	const int op = FUTEX_WAIT_PRIVATE;
+
+	//both EAGAIN and EINTR send the caller back to its condition check
+	(void) syscall(SYS_futex, seq, op, expected, NULL, NULL, 0);
+}
+
+static inline void SpscFutexWake(atomic_uint *seq)
+{
+	//at most one thread ever sleeps on an spsc channel
+	(void) syscall(SYS_futex, seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+//------------------------------------------------------------------------------
+//API
+
+#define api_spsc_channel(T, pfix, cls)					       \
+	api_channel(T, pfix, cls)					       \
+static inline void pfix##ChannelWake(pfix##_channel *self);
+
+//must be invoked before any other channel function
+#define impl_spsc_channel_init(T, pfix, cls)				       \
+cls void pfix##ChannelInit(pfix##_channel *self, const size_t n)	       \
+{									       \
+	assert(self);							       \
+	assert(n);							       \
+									       \
+	self->data = allocate(sizeof(T) * n);			               \
+	self->cap = n;							       \
+									       \
+	atomic_init(&self->head, 0);					       \
+	atomic_init(&self->tail, 0);					       \
+	atomic_init(&self->seq, 0);					       \
+	atomic_init(&self->waiters, 0);					       \
+	atomic_init(&self->flags, CHANNEL_OPEN);			       \
+									       \
+	ChannelTrace("initialized");		                               \
+}
+
+//If a thread is waiting for a signal, then CHANNEL_EBUSY is returned and the
+//channel is not destroyed. Otherwise, CHANNEL_ESUCCESS is returned and the
+//CHANNEL_CLOSED flag is set.
+#define impl_spsc_channel_shutdown(T, pfix, cls)			       \
+cls int pfix##ChannelShutdown(pfix##_channel *self)                    	       \
+{									       \
+	assert(self);							       \
+									       \
+	if (atomic_load(&self->waiters)) {				       \
+		return CHANNEL_EBUSY;					       \
+	}								       \
+									       \
+	atomic_store(&self->flags, CHANNEL_CLOSED);			       \
+									       \
+	ChannelTrace("shutdown");		                               \
+									       \
+	return CHANNEL_ESUCCESS;					       \
+}
+
+//unlike the generic channel, closing wakes a consumer suspended on an empty
+//queue so that it can observe CHANNEL_ECLOSED
+#define impl_spsc_channel_close(T, pfix, cls)				       \
+cls void pfix##ChannelClose(pfix##_channel *self)			       \
+{									       \
+	assert(self);							       \
+									       \
+	atomic_store(&self->flags, CHANNEL_CLOSED);			       \
+									       \
+	ChannelTrace("closed");				                       \
+									       \
+	pfix##ChannelWake(self);					       \
+}
+
+//invoked after every publication of an index and after a close
+#define impl_spsc_channel_wake(T, pfix, cls)				       \
+static inline void pfix##ChannelWake(pfix##_channel *self)		       \
+{									       \
+	atomic_thread_fence(memory_order_seq_cst);			       \
+									       \
+	if (atomic_load_explicit(&self->waiters, memory_order_relaxed)) {      \
+		atomic_fetch_add_explicit(&self->seq, 1, memory_order_release);\
+		SpscFutexWake(&self->seq);				       \
+	}								       \
+}
+
+//calling thread will suspend without timeout until all n elements are sent; the
+//elements are published in as few groups as the free space allows
+#define impl_spsc_channel_send_batch(T, pfix, cls)			       \
+cls int pfix##ChannelSendBatch(pfix##_channel *self, const T *data, size_t n)  \
+{									       \
+	assert(self);							       \
+	assert(data || !n);						       \
+									       \
+	if (atomic_load(&self->flags) & CHANNEL_CLOSED) {		       \
+		ChannelTrace("attempted send on closed queue");                \
+		return CHANNEL_ECLOSED;					       \
+	}								       \
+									       \
+	const memory_order acquire = memory_order_acquire;		       \
+	size_t tail = atomic_load_explicit(&self->tail, acquire);	       \
+									       \
+	while (n) {							       \
+		size_t head = atomic_load_explicit(&self->head, acquire);      \
+		bool woken = false;					       \
+		int spins = 0;						       \
+									       \
+		while (tail - head == self->cap) {			       \
+			if (spins++ < SPSC_SPIN_LIMIT) {		       \
+				SpscPause();				       \
+			} else {					       \
+				ChannelTrace("full; suspending thread");       \
+				unsigned int key = atomic_load(&self->seq);    \
+				atomic_fetch_add(&self->waiters, 1);	       \
+				head = atomic_load(&self->head);	       \
+									       \
+				if (tail - head == self->cap) {		       \
+					SpscFutexWait(&self->seq, key);	       \
+				}					       \
+									       \
+				atomic_fetch_sub(&self->waiters, 1);	       \
+				woken = true;				       \
+			}						       \
+									       \
+			head = atomic_load_explicit(&self->head, acquire);     \
+		}							       \
+									       \
+		for (spins = 0; woken && spins < SPSC_SPIN_LIMIT; spins++) {   \
+			if (tail - head <= self->cap / 2) {		       \
+				break;					       \
+			}						       \
+									       \
+			SpscPause();					       \
+			head = atomic_load_explicit(&self->head, acquire);     \
+		}							       \
+									       \
+		const size_t room = self->cap - (tail - head);		       \
+		const size_t total = n < room ? n : room;		       \
+									       \
+		for (size_t i = 0; i < total; i++) {			       \
+			self->data[(tail + i) % self->cap] = data[i];	       \
+		}							       \
+									       \
+		tail += total;						       \
+		data += total;						       \
+		n -= total;						       \
+									       \
+		atomic_store_explicit(&self->tail, tail, memory_order_release);\
+									       \
+		pfix##ChannelWake(self);				       \
+	}								       \
+									       \
+	return CHANNEL_ESUCCESS;					       \
+}
+
+//calling thread will suspend without timeout if the channel is empty and open;
+//on success between 1 and max elements are received and their count is placed
+//in n. On failure n is zero.
+#define impl_spsc_channel_recv_batch(T, pfix, cls)			       \
+cls int pfix##ChannelRecvBatch(pfix##_channel *self, T *data, size_t max,      \
+			       size_t *n)				       \
+{									       \
+	assert(self);						               \
+	assert(data);							       \
+	assert(max);							       \
+	assert(n);							       \
+									       \
+	const memory_order acquire = memory_order_acquire;		       \
+	const size_t head = atomic_load_explicit(&self->head, acquire);        \
+	size_t tail = atomic_load_explicit(&self->tail, acquire);	       \
+	bool woken = false;						       \
+	int spins = 0;							       \
+									       \
+	*n = 0;								       \
+									       \
+	while (tail == head) {						       \
+		if (atomic_load(&self->flags) & CHANNEL_CLOSED) {	       \
+			tail = atomic_load_explicit(&self->tail, acquire);     \
+									       \
+			if (tail != head) {				       \
+				break;					       \
+			}						       \
+									       \
+			ChannelTrace("recv fail; closed empty queue");         \
+			return CHANNEL_ECLOSED;				       \
+		}							       \
+									       \
+		if (spins++ < SPSC_SPIN_LIMIT) {			       \
+			SpscPause();					       \
+		} else {						       \
+			ChannelTrace("empty; suspending thread");	       \
+			unsigned int key = atomic_load(&self->seq);	       \
+			atomic_fetch_add(&self->waiters, 1);		       \
+			tail = atomic_load(&self->tail);		       \
+			unsigned char flags = atomic_load(&self->flags);       \
+									       \
+			if (tail == head && !(flags & CHANNEL_CLOSED)) {       \
+				SpscFutexWait(&self->seq, key);		       \
+			}						       \
+									       \
+			atomic_fetch_sub(&self->waiters, 1);		       \
+			woken = true;					       \
+		}							       \
+									       \
+		tail = atomic_load_explicit(&self->tail, acquire);	       \
+	}								       \
+									       \
+	for (spins = 0; woken && spins < SPSC_SPIN_LIMIT; spins++) {	       \
+		if (tail - head >= self->cap - self->cap / 2) {		       \
+			break;						       \
+		}							       \
+									       \
+		if (atomic_load(&self->flags) & CHANNEL_CLOSED) {	       \
+			break;						       \
+		}							       \
+									       \
+		SpscPause();						       \
+		tail = atomic_load_explicit(&self->tail, acquire);	       \
+	}								       \
+									       \
+	const size_t len = tail - head;					       \
+	const size_t total = len < max ? len : max;			       \
+									       \
+	for (size_t i = 0; i < total; i++) {				       \
+		data[i] = self->data[(head + i) % self->cap];		       \
+	}								       \
+									       \
+	const memory_order release = memory_order_release;		       \
+	atomic_store_explicit(&self->head, head + total, release);	       \
+									       \
+	pfix##ChannelWake(self);					       \
+									       \
+	*n = total;							       \
+									       \
+	return CHANNEL_ESUCCESS;					       \
+}
+
+//calling thread will suspend without timeout if the channel is full.
+#define impl_spsc_channel_send(T, pfix, cls)				       \
+cls int pfix##ChannelSend(pfix##_channel *self, const T datum)	               \
+{									       \
+	return pfix##ChannelSendBatch(self, &datum, 1);			       \
+}
+
+//calling thread will suspend without timeout if the channel is empty and open
+#define impl_spsc_channel_recv(T, pfix, cls)				       \
+cls int pfix##ChannelRecv(pfix##_channel *self, T *datum)		       \
+{									       \
+	size_t n = 0;							       \
+									       \
+	return pfix##ChannelRecvBatch(self, datum, 1, &n);		       \
+}
+
+//create a generic single-producer single-consumer channel named pfix_channel
+//which contains elements of type T and calls methods with storage class cls.
+#define make_spsc_channel(T, pfix, cls)					       \
+	alias_channel(pfix)						       \
+	declare_spsc_channel(T, pfix)					       \
+	api_spsc_channel(T, pfix, cls)					       \
+	impl_spsc_channel_wake(T, pfix, cls)				       \
+	impl_spsc_channel_init(T, pfix, cls)				       \
+	impl_spsc_channel_shutdown(T, pfix, cls)			       \
+	impl_spsc_channel_close(T, pfix, cls)				       \
+	impl_spsc_channel_send_batch(T, pfix, cls)			       \
+	impl_spsc_channel_recv_batch(T, pfix, cls)			       \
+	impl_spsc_channel_send(T, pfix, cls)				       \
+	impl_spsc_channel_recv(T, pfix, cls)
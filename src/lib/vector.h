@@ -196,4 +196,156 @@ cls void pfix##VectorReset(pfix##_vector *self)		         	       \
 	impl_vector_reset(T, pfix, cls)					       \
 	impl_vector_pop(T, pfix, cls)
 
+//------------------------------------------------------------------------------
+
+//a small vector keeps its first N elements inside the struct, so a vector of
+//at most N elements is never allocated. Once element N + 1 is pushed the
+//elements move to an arena buffer whose pointer reuses the inline storage;
+//the vector is inline if and only if cap == N. Since the struct never points
+//into itself it may be copied by value like any other vector, but unlike one
+//its members must not be modified by application code.
+#define declare_small_vector(T, pfix, N)				       \
+struct pfix##_vector {							       \
+	size_t len;							       \
+	size_t cap;							       \
+	union {								       \
+		T *buffer;						       \
+		T small[N];						       \
+	};								       \
+};
+
+#define api_small_vector(T, pfix, cls)					       \
+cls pfix##_vector pfix##VectorInit(void);				       \
+cls void pfix##VectorPush(pfix##_vector *, T);				       \
+cls T pfix##VectorGet(const pfix##_vector *, const size_t);		       \
+cls void pfix##VectorReset(pfix##_vector *);				       \
+cls T pfix##VectorSet(pfix##_vector *, const size_t, T);		       \
+cls T pfix##VectorPop(pfix##_vector *);					       \
+cls T *pfix##VectorData_private(pfix##_vector *, const size_t);
+
+#define impl_small_vector_init(T, pfix, N, cls)				       \
+cls pfix##_vector pfix##VectorInit(void)				       \
+{									       \
+	pfix##_vector v = {						       \
+		.len = 0,						       \
+		.cap = N						       \
+	};								       \
+									       \
+	return v;							       \
+}
+
+#define impl_small_vector_data(T, pfix, N, cls)				       \
+cls T *pfix##VectorData_private(pfix##_vector *self, const size_t index)       \
+{									       \
+	assert(self);							       \
+	assert(self->cap >= N);						       \
+	assert(index < self->cap);					       \
+									       \
+	if (self->cap == N) {						       \
+		return self->small + index;				       \
+	}								       \
+									       \
+	return self->buffer + index;					       \
+}
+
+#define impl_small_vector_push(T, pfix, N, cls)				       \
+cls void pfix##VectorPush(pfix##_vector *self, T datum)			       \
+{									       \
+	assert(self);							       \
+	assert(self->len <= self->cap);					       \
+									       \
+	if (self->len == SIZE_MAX) {					       \
+		VectorTrace("reached absolute capacity; aborting program");    \
+		abort();						       \
+	}								       \
+									       \
+	if (self->len == self->cap) {					       \
+		const size_t cap = VectorGrow(self->cap);		       \
+		const size_t bytes = cap * sizeof(T);			       \
+		VectorTrace("realloc to %zu (%zu bytes)", cap, bytes);	       \
+									       \
+		if (self->cap == N) {					       \
+			T *buffer = allocate(bytes);			       \
+			memcpy(buffer, self->small, sizeof(self->small));      \
+			self->buffer = buffer;				       \
+		} else {						       \
+			self->buffer = reallocate(self->buffer, bytes);	       \
+		}							       \
+									       \
+		self->cap = cap;					       \
+	}								       \
+									       \
+	*pfix##VectorData_private(self, self->len) = datum;		       \
+	self->len++;							       \
+}
+
+#define impl_small_vector_get(T, pfix, N, cls)				       \
+cls T pfix##VectorGet(const pfix##_vector *self, const size_t index)	       \
+{									       \
+	assert(self);							       \
+	assert(self->len <= self->cap);					       \
+	assert(index < self->len);					       \
+									       \
+	if (self->cap == N) {						       \
+		return self->small[index];				       \
+	}								       \
+									       \
+	return self->buffer[index];					       \
+}
+
+#define impl_small_vector_set(T, pfix, N, cls)				       \
+cls T pfix##VectorSet(pfix##_vector *self, const size_t index, T datum)	       \
+{									       \
+	assert(self);							       \
+	assert(self->len <= self->cap);					       \
+	assert(index < self->len);					       \
+									       \
+	T *slot = pfix##VectorData_private(self, index);		       \
+	T old_element = *slot;						       \
+									       \
+	*slot = datum;							       \
+									       \
+	return old_element;						       \
+}
+
+//a vector which has moved to the heap stays there
+#define impl_small_vector_reset(T, pfix, N, cls)			       \
+cls void pfix##VectorReset(pfix##_vector *self)				       \
+{									       \
+	assert(self);							       \
+	assert(self->len <= self->cap);					       \
+									       \
+	self->len = 0;							       \
+}
+
+#define impl_small_vector_pop(T, pfix, N, cls)				       \
+cls T pfix##VectorPop(pfix##_vector *self)				       \
+{									       \
+	assert(self);							       \
+	assert(self->len <= self->cap);					       \
+									       \
+	T top = pfix##VectorGet(self, self->len - 1);			       \
+									       \
+	self->len--;							       \
+									       \
+	return top;							       \
+}
+
+//------------------------------------------------------------------------------
+
+//make_small_vector declares a vector<T> type named pfix_vector whose first N
+//elements, N > 0, are stored inline. The type has the same operations as a
+//make_vector type except that VectorInit takes no arguments.
+#define make_small_vector(T, pfix, N, cls)				       \
+	alias_vector(pfix)						       \
+	declare_small_vector(T, pfix, N)				       \
+	api_small_vector(T, pfix, cls)					       \
+	impl_small_vector_init(T, pfix, N, cls)				       \
+	impl_small_vector_data(T, pfix, N, cls)				       \
+	impl_small_vector_push(T, pfix, N, cls)				       \
+	impl_small_vector_get(T, pfix, N, cls)				       \
+	impl_small_vector_set(T, pfix, N, cls)				       \
+	impl_small_vector_reset(T, pfix, N, cls)			       \
+	impl_small_vector_pop(T, pfix, N, cls)
+
 #define vector(pfix) pfix##_vector
@@ -11,8 +11,10 @@
 #include "arena.h"
 #include "options.h"
 #include "resolver.h"
+#include "stats.h"
 #include "str.h"
 #include "version.h"
+#include "watch.h"
 #include "xerror.h"
 
 #if GCC_VERSION < 80300
@@ -21,7 +23,11 @@
 
 void Initialise(int *, char ***);
 _Noreturn void Terminate(int);
-const cstring *GetRootFileName(char **);
+_Noreturn void Watch(const cstring **, const size_t, network *);
+size_t CloseGeneration(void);
+void Report(network *);
+void ReportFailure(const cstring **, const size_t);
+const cstring **GetRootFileNames(int, char **, size_t *);
 
 //------------------------------------------------------------------------------
 
@@ -41,15 +47,112 @@ int main(int argc, char **argv)
 		Terminate(EXIT_FAILURE);
 	}
 
-	const cstring *filename = GetRootFileName(argv);
+	size_t total = 0;
 
-	network *net = ResolverInit(filename);
+	//under --Watch the names outlive every compilation
+	ArenaShare();
+	const cstring **filenames = GetRootFileNames(argc, argv, &total);
+	ArenaUnshare();
+
+	network *net = ResolverInit(filenames, total);
+
+	if (!net) {
+		ReportFailure(filenames, total);
+	}
+
+	if (OptionsWatch()) {
+		Watch(filenames, total, net);
+	}
 
 	if (!net) {
-		xerror_fatal("cannot resolve %s", filename);
 		Terminate(EXIT_FAILURE);
 	}
 
+	Report(net);
+	Terminate(EXIT_SUCCESS);
+}
+
+//compiles the root files again whenever a watched file changes, until SIGINT
+//or SIGTERM; the outcome of each compilation is reported as it finishes. Each
+//compilation is a generation of the arena. The generation of the last network
+//that compiled is kept for the watch list, or that of the first compilation
+//until one does, and every other generation is released once it is reported.
+_Noreturn void Watch
+(
+	const cstring **filenames,
+	const size_t total,
+	network *net
+)
+{
+	assert(filenames);
+
+	watchlist *list = WatchInit(filenames, total, net);
+	size_t kept = 0;
+	bool keeping = false;
+
+	while (true) {
+		if (net) {
+			Report(net);
+		}
+
+		XerrorFlush();
+
+		if (net) {
+			xuser_help(NULL, 0, "compilation succeeded; watching");
+		} else {
+			xuser_error(NULL, 0, "compilation failed; watching");
+		}
+
+		const size_t closed = CloseGeneration();
+
+		if (net || !keeping) {
+			if (keeping) {
+				ArenaReleaseGeneration(kept);
+			}
+
+			kept = closed;
+			keeping = true;
+		} else {
+			ArenaReleaseGeneration(closed);
+		}
+
+		if (!WatchWait(list)) {
+			break;
+		}
+
+		net = ResolverReuse(filenames, total, WatchReuse(list));
+
+		if (!net) {
+			ReportFailure(filenames, total);
+		}
+
+		WatchUpdate(list, net);
+	}
+
+	Terminate(net ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+//the arena of the main thread joins the current generation, which is closed;
+//returns its number
+size_t CloseGeneration(void)
+{
+	ArenaDetach();
+
+	const size_t closed = ArenaCloseGeneration();
+
+	if (!ArenaInit(OptionsArena())) {
+		xerror_fatal("cannot initialise new arena");
+		Terminate(EXIT_FAILURE);
+	}
+
+	return closed;
+}
+
+//prints the diagnostics requested for a network
+void Report(network *net)
+{
+	assert(net);
+
 	if (OptionsDdeps()) {
 		for (module *curr = net->head; curr; curr = curr->next) {
 			puts(curr->alias);
@@ -58,15 +161,21 @@ int main(int argc, char **argv)
 	}
 
 	if (OptionsDsym()) {
-		const cstring *json = SymTableToJSON(net->global);
-		puts(json);
+		const sample start = StatsSample();
+
+		if (!SymTableToJSON(net->global, stdout)) {
+			xerror_issue("cannot write symbol table to stdout");
+		}
+
+		StatsProfile(NULL, PHASE_JSON, StatsSince(start));
 	}
-	
-	Terminate(EXIT_SUCCESS);
+
+	(void) fflush(stdout);
 }
 
 _Noreturn void Terminate(int status)
 {
+	StatsPrint();
 	ArenaFree();
 	XerrorFlush();
 
@@ -88,23 +197,40 @@ _Noreturn void Terminate(int status)
 	exit(status);
 }
 
-//returns "main" if argv is empty
-const cstring *GetRootFileName(char **argv)
+void ReportFailure(const cstring **filenames, const size_t total)
+{
+	assert(filenames);
+	assert(total);
+
+	if (total == 1) {
+		xerror_fatal("cannot resolve %s", filenames[0]);
+	} else {
+		const cstring *msg = "cannot resolve %s and %zu other root files";
+		xerror_fatal(msg, filenames[0], total - 1);
+	}
+}
+
+//returns "main" if argv is empty; all of the files are compiled together into
+//one network, so a module which several of them import is compiled once
+const cstring **GetRootFileNames(int argc, char **argv, size_t *total)
 {
 	assert(argv);
+	assert(total);
 
-	const cstring *fname = argv[0];
+	static const cstring *fallback[] = {"main"};
 
-	if (!fname) {
-		return "main";
+	if (argc <= 0) {
+		*total = 1;
+		return fallback;
 	}
 
-	const cstring *sentinel = argv[1];
+	const cstring **filenames = allocate(sizeof(cstring *) * (size_t) argc);
 
-	if (sentinel != NULL) {
-		const cstring *msg = "all input files except %s were ignored";
-		xuser_warn(NULL, 0, msg, fname);
+	for (int i = 0; i < argc; i++) {
+		filenames[i] = argv[i];
 	}
 
-	return fname;
+	*total = (size_t) argc;
+
+	return filenames;
 }
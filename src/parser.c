@@ -12,19 +12,24 @@
 #include <string.h>
 
 #include "arena.h"
+#include "cache.h"
 #include "file.h"
+#include "intern.h"
 #include "parser.h"
 #include "scanner.h"
 #include "options.h"
+#include "stats.h"
 #include "xerror.h"
 #include "channel.h"
+#include "pool.h"
 #include "vector.h"
 
 typedef struct parser parser;
 
 //parser management
-static parser *ParserInit(cstring *);
+static parser *ParserInit(cstring *, const size_t);
 static module *RecursiveDescent(parser *, const cstring *);
+static void Prefetch(const module *);
 
 //node management
 static module ModuleInit(parser *, const cstring *);
@@ -41,6 +46,7 @@ static void CheckToken
 (parser *, const token_type, const cstring *, const bool, const bool);
 static intmax_t ExtractArrayIndex(parser *);
 static cstring *cStringFromLexeme(parser *);
+static const cstring *InternLexeme(parser *);
 
 //directives
 static import RecImport(parser *);
@@ -60,7 +66,7 @@ static decl RecVariable(parser *);
 static stmt RecStmt(parser *);
 static stmt RecExprStmt(parser *);
 static stmt RecBlock(parser *);
-static void ParseFiats(parser *, vector(Fiat) *const);
+static void ParseFiats(parser *, stmt *const);
 static stmt RecLabel(parser *);
 static stmt RecAnonymousTarget(parser *);
 static stmt RecNamedTarget(parser *);
@@ -72,16 +78,12 @@ static vector(Test) RecTests(parser *);
 
 //expressions
 static expr *RecAssignment(parser *);
-static expr *RecLogicalOr(parser *);
-static expr *RecLogicalAnd(parser *);
-static expr *RecEquality(parser *);
-static expr *RecTerm(parser *);
-static expr *RecFactor(parser *);
+static expr *RecBinary(parser *, const int);
 static expr *RecUnary(parser *);
 static expr *RecPrimary(parser *);
 static expr *RecRvarOrIdentifier(parser *);
 static expr *RecRvar(parser *, bool);
-static vector(Expr) RecArguments(parser *);
+static vector(Args) RecArguments(parser *);
 static expr *RecArrayLiteral(parser *);
 static expr *RecArrayLiteral(parser *);
 static expr *RecIdentifier(parser *);
@@ -107,33 +109,120 @@ static expr *RecAccess(parser *, expr *);
 //
 // As a secondary benefit, vector buffers are cache-friendly and as a result
 // the AST destruction process is much faster than a manual tree traversal.
+//
+// The tokens and nodes members feed the --Dstats counters. A node is counted
+// for each import, declaration, statement, expression, and type; the blocks
+// which form the body of a function or a control flow statement are included
+// in the statements they introduce rather than counted on their own. Under
+// --Dprofile the scanning member accumulates the nanoseconds spent obtaining
+// tokens, which is subtracted from the parse phase.
+//
+// Heap allocated nodes are issued from one pool per node type. The resolver and
+// the later passes walk declarations, statements, and types far more often than
+// expressions, so keeping each kind in its own run of memory spares those walks
+// the cache lines of the expressions which surround them.
+//
+// Expressions may nest without limit in the grammar, so the stack member holds
+// the frame address at the root of the descent. An expression which consumes
+// more than EXPR_STACK_LIMIT bytes of stack below it is a user error rather
+// than a stack overflow on the parsing thread.
+//
+// Member, parameter, and case lists are gathered in a small vector on the stack
+// of their rule and copied to the arena once they are complete, so each list
+// is allocated exactly once at its final length. A list which outgrows the
+// inline storage spills to the arena as any vector would.
+
+make_pool(expr, Expr, static)
+make_pool(stmt, Stmt, static)
+make_pool(decl, Decl, static)
+make_pool(type, Type, static)
+
+#define LIST_INLINE 8
+
+make_small_vector(member, MemberList, LIST_INLINE, static)
+make_small_vector(param, ParamList, LIST_INLINE, static)
+make_small_vector(test, TestList, LIST_INLINE, static)
+
+//initial number of nodes in the first chunk of each pool
+#define POOL_INITIAL_CHUNK ((size_t) 64)
+
+#define EXPR_STACK_LIMIT MiB(1)
 
 struct parser {
 	channel(Token) *chan;
+	scanner *scn;
+	const cstring *src;
 	token tok;
+	token lookahead[TOKEN_BATCH];
+	size_t next;
+	size_t len;
 	module root;
 	size_t errors;
+	size_t tokens;
+	size_t nodes;
+	uint64_t scanning;
+	bool profile;
+	pool(Expr) exprs;
+	pool(Stmt) stmts;
+	pool(Decl) decls;
+	pool(Type) types;
+	uintptr_t stack;
 };
 
-//returns NULL on failure; does not initialize the root member
-static parser *ParserInit(cstring *src)
+//returns NULL on failure; does not initialize the root member. Sources that
+//are smaller than the --Pipeline threshold are scanned inline on demand, while
+//larger sources are scanned concurrently on a new thread.
+static parser *ParserInit(cstring *src, const size_t len)
 {
 	assert(src);
 
-	parser *prs = allocate(sizeof(parser));
+	//token lexemes are recorded as 32-bit offsets into the source
+	if (len > TOKEN_MAXIMUM_SOURCE) {
+		xerror_issue("source exceeds %zu bytes", TOKEN_MAXIMUM_SOURCE);
+		return NULL;
+	}
 
-	prs->chan = allocate(sizeof(channel(Token)));
-	TokenChannelInit(prs->chan, KiB(1));
+	parser *prs = allocate(sizeof(parser));
 
+	prs->src = src;
 	prs->tok = INVALID_TOKEN;
 
+	prs->next = 0;
+	prs->len = 0;
+
 	prs->errors = 0;
 
+	prs->tokens = 0;
+	prs->nodes = 0;
+
+	prs->scanning = 0;
+	prs->profile = OptionsDprofile();
+
+	prs->exprs = ExprPoolInit(POOL_INITIAL_CHUNK);
+	prs->stmts = StmtPoolInit(POOL_INITIAL_CHUNK);
+	prs->decls = DeclPoolInit(POOL_INITIAL_CHUNK);
+	prs->types = TypePoolInit(POOL_INITIAL_CHUNK);
+
+	if (len < OptionsPipeline()) {
+		prs->chan = NULL;
+		prs->scn = ScannerInitInline(src);
+		return prs;
+	}
+
+	prs->scn = NULL;
+	prs->chan = allocate(sizeof(channel(Token)));
+	TokenChannelInit(prs->chan, KiB(1));
+
 	bool ok = ScannerInit(src, prs->chan);
 
 	if (!ok) {
 		xerror_issue("cannot init scanner");
-		(void) TokenChannelShutdown(prs->chan);
+
+		//no scanner thread exists, so nothing can be waiting on the channel
+		int err = TokenChannelShutdown(prs->chan);
+		assert(err == CHANNEL_ESUCCESS);
+		(void) err;
+
 		return NULL;
 	}
 
@@ -147,28 +236,93 @@ module *SyntaxTreeInit(const cstring *filename)
 {
 	assert(filename);
 
-	cstring *src = FileLoad(filename);
+	source src = {
+		.text = NULL,
+		.len = 0,
+		.mapped = false
+	};
+
+	sample start = StatsSample();
 
-	if (!src) {
+	if (!FileMap(filename, &src)) {
 		return NULL;
 	}
 
-	parser *prs = ParserInit(src);
+	StatsProfile(filename, PHASE_LOAD, StatsSince(start));
+
+	//with --Dtokens the tokens are printed as they are scanned, so a tree
+	//must not be loaded from the cache in place of a scan
+	const bool cached = OptionsCache() && !OptionsDtokens();
+	uint64_t key = 0;
+
+	if (cached) {
+		start = StatsSample();
+
+		size_t nodes = 0;
+		key = CacheKey(&src);
+		module *root = CacheLoad(filename, key, &nodes);
+
+		StatsProfile(filename, PHASE_CACHE, StatsSince(start));
+
+		if (root) {
+			FileUnmap(&src);
+			Prefetch(root);
+			StatsCount(STAT_MODULES, 1);
+			StatsCount(STAT_NODES, nodes);
+			return root;
+		}
+	}
+
+	start = StatsSample();
+
+	parser *prs = ParserInit(src.text, src.len);
 
 	if (!prs) {
 		xerror_fatal("cannot init parser");
+		FileUnmap(&src);
 		return NULL;
 	}
 
 	module *root = RecursiveDescent(prs, filename);
 
-	(void) TokenChannelShutdown(prs->chan);
+	StatsCount(STAT_MODULES, 1);
+	StatsCount(STAT_TOKENS, prs->tokens);
+	StatsCount(STAT_NODES, prs->nodes);
+
+	//_EOF is the last token the scanner publishes, so once the parser has
+	//received it the scanner never suspends on the channel again
+	if (prs->chan) {
+		int err = TokenChannelShutdown(prs->chan);
+		assert(err == CHANNEL_ESUCCESS);
+		(void) err;
+	}
+
+	//the scanner has sent _EOF, so it will not read the source again and
+	//every lexeme in the tree has already been copied out of it
+	FileUnmap(&src);
+
+	sample cost = StatsSince(start);
+	cost.time -= prs->scanning;
+
+	const sample scan = {
+		.time = prs->scanning,
+		.bytes = 0
+	};
+
+	StatsProfile(filename, PHASE_SCAN, scan);
+	StatsProfile(filename, PHASE_PARSE, cost);
 
 	if (prs->errors) {
 		xerror_fatal("tree is ill-formed");
 		return NULL;
 	}
 
+	if (cached) {
+		start = StatsSample();
+		CacheStore(key, root, prs->nodes);
+		StatsProfile(filename, PHASE_CACHE, StatsSince(start));
+	}
+
 	return root;
 }
 
@@ -180,12 +334,11 @@ static module ModuleInit(parser *self, const cstring *alias)
 	assert(self);
 	assert(alias);
 
-	cstring *copy = cStringDuplicate(alias);
-
 	module node =  {
 		.imports = {0},
 		.declarations = {0},
-		.alias = copy,
+		.alias = InternString(alias),
+		.symbols = 0,
 		.next = NULL,
 		.table = NULL,
 		.flag = false 
@@ -205,10 +358,12 @@ static expr *ExprInit(parser *self, const exprtag tag)
 	assert(self);
 	assert(tag >= NODE_ASSIGNMENT && tag <= NODE_IDENT);
 
-	expr *new = allocate(sizeof(expr));
+	expr *new = ExprPoolAllocate(&self->exprs);
 
 	new->tag = tag;
 
+	self->nodes++;
+
 	return new;
 }
 
@@ -216,11 +371,9 @@ static decl *CopyDeclToHeap(parser *self, const decl src)
 {
 	assert(self);
 
-	const size_t bytes = sizeof(decl);
-
-	decl *new = allocate(bytes);
+	decl *new = DeclPoolAllocate(&self->decls);
 
-	memcpy(new, &src, bytes);
+	memcpy(new, &src, sizeof(decl));
 
 	return new;
 }
@@ -229,11 +382,9 @@ static stmt *CopyStmtToHeap(parser *self, const stmt src)
 {
 	assert(self);
 
-	const size_t bytes = sizeof(stmt);
+	stmt *new = StmtPoolAllocate(&self->stmts);
 
-	stmt *new = allocate(bytes);
-
-	memcpy(new, &src, bytes);
+	memcpy(new, &src, sizeof(stmt));
 
 	return new;
 }
@@ -242,9 +393,24 @@ static stmt *CopyStmtToHeap(parser *self, const stmt src)
 static cstring *cStringFromLexeme(parser *self)
 {
 	assert(self);
-	assert(self->tok.lexeme.view != NULL);
+	assert(self->tok.len);
+
+	const char *view = TokenLexeme(self->src, self->tok);
+
+	return cStringFromView(view, self->tok.len);
+}
+
+//returns the canonical copy of the token lexeme; used for identifiers and import
+//paths, which become symbol table keys. Literals are mostly distinct and are
+//never looked up, so they are copied instead.
+static const cstring *InternLexeme(parser *self)
+{
+	assert(self);
+	assert(self->tok.len);
+
+	const char *view = TokenLexeme(self->src, self->tok);
 
-	return cStringFromView(self->tok.lexeme.view, self->tok.lexeme.len);
+	return Intern(view, self->tok.len);
 }
 
 //------------------------------------------------------------------------------
@@ -327,18 +493,46 @@ static void CheckToken
 //------------------------------------------------------------------------------
 //channel operations
 
-//the lexeme associated with the token, if any, will be added to the garbage
+//the lexeme associated with the token, if any, will be added to the garbage;
+//tokens are received in bulk and buffered in the lookahead array
 static void GetNextToken(parser *self)
 {
 	assert(self);
 
-	int err = TokenChannelRecv(self->chan, &self->tok);
+	self->tokens++;
+
+	const uint64_t start = self->profile ? StatsClock() : 0;
+
+	if (self->scn) {
+		ScannerNext(self->scn, &self->tok);
+
+		if (self->profile) {
+			self->scanning += StatsClock() - start;
+		}
+
+		return;
+	}
+
+	if (self->next == self->len) {
+		token *buf = self->lookahead;
+		const size_t max = TOKEN_BATCH;
+		int err = TokenChannelRecvBatch(self->chan, buf, max, &self->len);
+
+		if (self->profile) {
+			self->scanning += StatsClock() - start;
+		}
+
+		if (err) {
+			assert(0 != 0 && "attempted to read past EOF");
+			xerror_fatal("attempted to read past EOF");
+			abort();
+		}
 
-	if (err) {
-		assert(0 != 0 && "attempted to read past EOF");
-		xerror_fatal("attempted to read past EOF");
-		abort();
+		self->next = 0;
 	}
+
+	self->tok = self->lookahead[self->next];
+	self->next++;
 }
 
 //synchronize at the block level if the immediate next token is invalid
@@ -360,9 +554,9 @@ static void ReportInvalidToken(parser *self)
 
 	cstring *name = cStringFromLexeme(self);
 
-	if (self->tok.flags.bad_string == 1) {
+	if (self->tok.flags & TOKEN_BAD_STRING) {
 		usererror("unterminated string literal");
-	} else if (self->tok.flags.valid == 0) {
+	} else if (!(self->tok.flags & TOKEN_VALID)) {
 		usererror("invalid syntax: %s", name);
 	} else {
 		usererror("unspecified syntax error: %s", name);
@@ -418,6 +612,18 @@ found_sequence_point:
 	return tokens_skipped;
 }
 
+//imports precede all declarations, so the files of the imported modules are
+//read ahead while the declarations of the importer are parsed. Whichever thread
+//builds an imported tree next then finds its file already in memory.
+static void Prefetch(const module *root)
+{
+	assert(root);
+
+	for (size_t i = 0; i < root->imports.len; i++) {
+		FilePrefetch(root->imports.buffer[i].alias);
+	}
+}
+
 //------------------------------------------------------------------------------
 //parsing algorithm
 
@@ -428,6 +634,7 @@ static module *RecursiveDescent(parser *self, const cstring *alias)
 	CEXCEPTION_T exception;
 
 	self->root = ModuleInit(self, alias);
+	self->stack = (uintptr_t) __builtin_frame_address(0);
 
 	GetNextValidToken(self);
 
@@ -440,6 +647,8 @@ static module *RecursiveDescent(parser *self, const cstring *alias)
 		}
 	}
 
+	Prefetch(&self->root);
+
 	while (self->tok.type != _EOF) {
 		Try {
 			decl node = RecDecl(self);
@@ -449,6 +658,9 @@ static module *RecursiveDescent(parser *self, const cstring *alias)
 		}
 	}
 
+	self->root.symbols = self->root.imports.len;
+	self->root.symbols += self->root.declarations.len;
+
 	return &self->root;
 }
 
@@ -462,8 +674,10 @@ static import RecImport(parser *self)
 
 	move_check(_LITERALSTR, "missing import path string");
 
+	self->nodes++;
+
 	import node = {
-		.alias = cStringFromLexeme(self),
+		.alias = InternLexeme(self),
 		.line = self->tok.line
 	};
 
@@ -480,8 +694,10 @@ static decl RecDecl(parser *self)
 	assert(self);
 
 	const cstring *msg = "'%.*s' is not the start of a valid declaration";
-	const char *view = self->tok.lexeme.view;
-	const size_t len = self->tok.lexeme.len;
+	const char *view = TokenLexeme(self->src, self->tok);
+	const size_t len = self->tok.len;
+
+	self->nodes++;
 
 	switch (self->tok.type) {
 	case _STRUCT:
@@ -527,7 +743,7 @@ static decl RecStruct(parser *self)
 
 	check(_IDENTIFIER, "missing struct name after 'struct' keyword");
 
-	node.udt.name = cStringFromLexeme(self);
+	node.udt.name = InternLexeme(self);
 
 	move_check_move(_LEFTBRACE, "missing '{' after struct name");
 
@@ -547,8 +763,7 @@ static vector(Member) RecParseMembers(parser *self)
 {
 	assert(self);
 
-	const size_t vec_capacity = 4;
-	vector(Member) vec = MemberVectorInit(0, vec_capacity);
+	vector(MemberList) list = MemberListVectorInit();
 
 	member attr = {
 		.name = NULL,
@@ -566,7 +781,7 @@ static vector(Member) RecParseMembers(parser *self)
 
 		check(_IDENTIFIER, "missing struct member name");
 
-		attr.name = cStringFromLexeme(self);
+		attr.name = InternLexeme(self);
 		attr.line = self->tok.line;
 
 		move_check_move(_COLON, "missing ':' after name");
@@ -575,16 +790,22 @@ static vector(Member) RecParseMembers(parser *self)
 
 		check_move(_SEMICOLON, "missing ';' after type");
 
-		MemberVectorPush(&vec, attr);
+		MemberListVectorPush(&list, attr);
 
 		memset(&attr, 0, sizeof(member));
 	}
 
-	if (vec.len == 0) {
+	if (list.len == 0) {
 		usererror("cannot declare an empty struct");
 		Throw(XXPARSE);
 	}
 
+	vector(Member) vec = MemberVectorInit(0, list.len);
+
+	for (size_t i = 0; i < list.len; i++) {
+		MemberVectorPush(&vec, MemberListVectorGet(&list, i));
+	}
+
 	return vec;
 }
 
@@ -614,7 +835,7 @@ static decl RecFunction(parser *self)
 
 	check(_IDENTIFIER, "missing function name in declaration");
 
-	node.function.name = cStringFromLexeme(self);
+	node.function.name = InternLexeme(self);
 
 	//parameter list
 	move_check_move(_LEFTPAREN, "missing '(' after function name");
@@ -641,6 +862,9 @@ static decl RecFunction(parser *self)
 	check(_LEFTBRACE, "cannot declare function without a body");
 	node.function.block = CopyStmtToHeap(self, RecBlock(self));
 
+	node.function.symbols = node.function.params.len;
+	node.function.symbols += node.function.block->block.decls;
+
 	return node;
 }
 
@@ -678,7 +902,7 @@ static decl RecMethod(parser *self)
 
 	check(_IDENTIFIER, "missing method name in declaration");
 
-	node.method.name = cStringFromLexeme(self);
+	node.method.name = InternLexeme(self);
 
 	//parameter list
 	move_check_move(_LEFTPAREN, "missing '(' after method name");
@@ -705,6 +929,9 @@ static decl RecMethod(parser *self)
 	check(_LEFTBRACE, "cannot declare method without a body");
 	node.method.block = CopyStmtToHeap(self, RecBlock(self));
 
+	node.method.symbols = node.method.params.len;
+	node.method.symbols += node.method.block->block.decls;
+
 	return node;
 }
 
@@ -715,8 +942,7 @@ static vector(Param) RecParseParameters(parser *self)
 {
 	assert(self);
 
-	const size_t vec_capacity = 4;
-	vector(Param) vec = ParamVectorInit(0, vec_capacity);
+	vector(ParamList) list = ParamListVectorInit();
 
 	param attr  = {
 		.name = NULL,
@@ -727,7 +953,7 @@ static vector(Param) RecParseParameters(parser *self)
 	};
 
 	while (self->tok.type != _RIGHTPAREN) {
-		if (vec.len > 0) {
+		if (list.len > 0) {
 			check_move(_COMMA, "missing ',' after parameter");
 		}
 
@@ -738,23 +964,29 @@ static vector(Param) RecParseParameters(parser *self)
 
 		check(_IDENTIFIER, "missing function parameter name");
 
-		attr.name = cStringFromLexeme(self);
+		attr.name = InternLexeme(self);
 		attr.line = self->tok.line;
 
 		move_check_move(_COLON, "missing ':' after name");
 
 		attr.typ = RecType(self);
 
-		ParamVectorPush(&vec, attr);
+		ParamListVectorPush(&list, attr);
 
 		memset(&attr, 0, sizeof(param));
 	}
 
-	if (vec.len == 0) {
+	if (list.len == 0) {
 		usererror("empty parameter list; did you mean 'void'?");
 		Throw(XXPARSE);
 	}
 
+	vector(Param) vec = ParamVectorInit(0, list.len);
+
+	for (size_t i = 0; i < list.len; i++) {
+		ParamVectorPush(&vec, ParamListVectorGet(&list, i));
+	}
+
 	return vec;
 }
 
@@ -789,7 +1021,7 @@ static decl RecVariable(parser *self)
 
 	check(_IDENTIFIER, "missing variable name in declaration");
 
-	node.variable.name = cStringFromLexeme(self);
+	node.variable.name = InternLexeme(self);
 
 	move_check_move(_COLON, "missing ':' before type");
 
@@ -809,14 +1041,16 @@ static type *RecType(parser *self)
 {
 	assert(self);
 
-	type *node = allocate(sizeof(type));
-	cstring *prev_name = NULL;
+	type *node = TypePoolAllocate(&self->types);
+	const cstring *prev_name = NULL;
+
+	self->nodes++;
 
 	switch (self->tok.type) {
 	case _IDENTIFIER:
 		node->line = self->tok.line;
 
-		prev_name = cStringFromLexeme(self);
+		prev_name = InternLexeme(self);
 
 		GetNextValidToken(self);
 
@@ -877,6 +1111,8 @@ static stmt RecStmt(parser *self)
 
 	stmt node = { 0 };
 
+	self->nodes++;
+
 	switch(self->tok.type) {
 	case _LEFTBRACE:
 		node = RecBlock(self);
@@ -948,7 +1184,8 @@ static stmt RecBlock(parser *self)
 	stmt node = {
 		.tag = NODE_BLOCK,
 		.block = {
-			.fiats = {0}
+			.fiats = {0},
+			.decls = 0
 		},
 		.line = self->tok.line
 	};
@@ -958,23 +1195,31 @@ static stmt RecBlock(parser *self)
 
 	GetNextValidToken(self);
 
-	ParseFiats(self, &node.block.fiats);
+	ParseFiats(self, &node);
 
 	GetNextValidToken(self);
 
 	return node;
 }
 
-static void ParseFiats(parser *self, vector(Fiat) *const fiats)
+//the declaration count lives in the block rather than in a local variable so
+//that it survives a longjmp from the exception handler
+static void ParseFiats(parser *self, stmt *const block)
 {
 	assert(self);
-	assert(fiats);
+	assert(block);
+	assert(block->tag == NODE_BLOCK);
 
 	CEXCEPTION_T e;
 
 	while (self->tok.type != _RIGHTBRACE) {
 		Try {
-			FiatVectorPush(fiats, RecFiat(self));
+			fiat node = RecFiat(self);
+			FiatVectorPush(&block->block.fiats, node);
+
+			if (node.tag == NODE_DECL) {
+				block->block.decls++;
+			}
 		} Catch (e) {
 			(void) Synchronize(self, false);
 		}
@@ -1104,8 +1349,7 @@ static vector(Test) RecTests(parser *self)
 {
 	assert(self);
 
-	const size_t vec_capacity = 4;
-	vector(Test) vec = TestVectorInit(0, vec_capacity);
+	vector(TestList) list = TestListVectorInit();
 
 	test t = {
 		.cond = NULL,
@@ -1134,15 +1378,21 @@ static vector(Test) RecTests(parser *self)
 		}
 
 		t.pass = CopyStmtToHeap(self, RecBlock(self));
-		TestVectorPush(&vec, t);
+		TestListVectorPush(&list, t);
 		memset(&t, 0, sizeof(test));
 	}
 
-	if (vec.len == 0) {
+	if (list.len == 0) {
 		usererror("switch statement cannot be empty");
 		Throw(XXPARSE);
 	}
 
+	vector(Test) vec = TestVectorInit(0, list.len);
+
+	for (size_t i = 0; i < list.len; i++) {
+		TestVectorPush(&vec, TestListVectorGet(&list, i));
+	}
+
 	return vec;
 }
 
@@ -1217,7 +1467,7 @@ static stmt RecNamedTarget(parser *self)
 	case _GOTO:
 		node.tag = NODE_GOTOLABEL;
 		move_check(_IDENTIFIER, "missing goto target");
-		node.gotostmt.name = cStringFromLexeme(self);
+		node.gotostmt.name = InternLexeme(self);
 		move_check_move(_SEMICOLON, "missing ';' after goto");
 		break;
 
@@ -1292,7 +1542,7 @@ static stmt RecLabel(parser *self)
 
 	move_check(_IDENTIFIER, "label name must be an identifier");
 
-	node.label.name = cStringFromLexeme(self);
+	node.label.name = InternLexeme(self);
 
 	move_check_move(_COLON, "missing ':' after label name");
 
@@ -1325,7 +1575,7 @@ static expr *RecAssignment(parser *self)
 {
 	assert(self);
 
-	expr *node = RecLogicalOr(self);
+	expr *node = RecBinary(self, 1);
 
 	if (self->tok.type == _EQUAL) {
 		expr *tmp = node;
@@ -1334,188 +1584,76 @@ static expr *RecAssignment(parser *self)
 		node->line = self->tok.line;
 
 		GetNextValidToken(self);
-		node->assignment.rvalue = RecLogicalOr(self);
+		node->assignment.rvalue = RecBinary(self, 1);
 	}
 
 	return node;
 }
 
-static expr *RecLogicalOr(parser *self)
-{
-	assert(self);
-
-	expr *node = RecLogicalAnd(self);
-	expr *tmp = NULL;
-
-	while (self->tok.type == _OR) {
-		tmp = node;
-		node = ExprInit(self, NODE_BINARY);
-
-		node->binary.left = tmp;
-		node->binary.operator = _OR;
-		node->line = self->tok.line;
-
-		GetNextValidToken(self);
-		node->binary.right = RecLogicalAnd(self);
-	}
-
-	return node;
-}
+//binary operators in order of increasing precedence; every level is left
+//associative and zero marks a token which is not a binary operator
+static const unsigned char precedence[_TOKEN_TYPE_COUNT] = {
+	[_OR] = 1,
+	[_AND] = 2,
+	[_GREATER] = 3,
+	[_LESS] = 3,
+	[_GEQ] = 3,
+	[_LEQ] = 3,
+	[_EQUALEQUAL] = 3,
+	[_NOTEQUAL] = 3,
+	[_ADD] = 4,
+	[_MINUS] = 4,
+	[_BITOR] = 4,
+	[_BITXOR] = 4,
+	[_STAR] = 5,
+	[_DIV] = 5,
+	[_MOD] = 5,
+	[_LSHIFT] = 5,
+	[_RSHIFT] = 5,
+	[_AMPERSAND] = 5
+};
 
-static expr *RecLogicalAnd(parser *self)
+//precedence climbing; parses a chain of unary operands joined by operators of
+//at least the minimum precedence. A chain of operators at one level is built by
+//the loop rather than by recursion, and an operand descends only through the
+//levels that its tokens actually use.
+static expr *RecBinary(parser *self, const int minimum)
 {
 	assert(self);
+	assert(minimum > 0);
 
-	expr *node = RecEquality(self);
+	expr *node = RecUnary(self);
+
+	while (precedence[self->tok.type] >= minimum) {
+		const int level = precedence[self->tok.type];
 
-	while (self->tok.type == _AND) {
 		expr *tmp = node;
 		node = ExprInit(self, NODE_BINARY);
 
 		node->binary.left = tmp;
-		node->binary.operator = _AND;
+		node->binary.operator = self->tok.type;
 		node->line = self->tok.line;
 
 		GetNextValidToken(self);
-		node->binary.right = RecEquality(self);
-	}
-
-	return node;
-}
-
-static expr *RecEquality(parser *self)
-{
-	assert(self);
-
-	expr *node = RecTerm(self);
-	expr *tmp = NULL;
-
-	while (true) {
-		switch (self->tok.type) {
-		case _GREATER:
-			__attribute__((fallthrough));
-
-		case _LESS:
-			__attribute__((fallthrough));
-
-		case _GEQ:
-			__attribute__((fallthrough));
-
-		case _LEQ:
-			__attribute__((fallthrough));
-
-		case _EQUALEQUAL:
-			__attribute__((fallthrough));
-
-		case _NOTEQUAL:
-			tmp = node;
-			node = ExprInit(self, NODE_BINARY);
-
-			node->binary.left = tmp;
-			node->binary.operator = self->tok.type;
-			node->line = self->tok.line;
-
-			GetNextValidToken(self);
-			node->binary.right = RecTerm(self);
-			break;
-
-		default:
-			goto exit_loop;
-		}
-	}
-
-exit_loop:
-	return node;
-}
-
-static expr *RecTerm(parser *self)
-{
-	assert(self);
-
-	expr *node = RecFactor(self);
-	expr *tmp = NULL;
-
-	while (true) {
-		switch (self->tok.type) {
-		case _ADD:
-			__attribute__((fallthrough));
-
-		case _MINUS:
-			__attribute__((fallthrough));
-
-		case _BITOR:
-			__attribute__((fallthrough));
-
-		case _BITXOR:
-			tmp = node;
-			node = ExprInit(self, NODE_BINARY);
-
-			node->binary.left = tmp;
-			node->binary.operator = self->tok.type;
-			node->line = self->tok.line;
-
-			GetNextValidToken(self);
-			node->binary.right = RecFactor(self);
-			break;
-
-		default:
-			goto exit_loop;
-		}
+		node->binary.right = RecBinary(self, level + 1);
 	}
 
-exit_loop:
 	return node;
 }
 
-static expr *RecFactor(parser *self)
+//every nested expression passes through RecUnary; stacks grow downwards on all
+//supported targets
+static expr *RecUnary(parser *self)
 {
 	assert(self);
 
-	expr *node = RecUnary(self);
-	expr *tmp = NULL;
-
-	while (true) {
-		switch (self->tok.type) {
-		case _STAR:
-			__attribute__((fallthrough));
-
-		case _DIV:
-			__attribute__((fallthrough));
-
-		case _MOD:
-			__attribute__((fallthrough));
-
-		case _LSHIFT:
-			__attribute__((fallthrough));
-
-		case _RSHIFT:
-			__attribute__((fallthrough));
-
-		case _AMPERSAND:
-			tmp = node;
-			node = ExprInit(self, NODE_BINARY);
-
-			node->binary.left = tmp;
-			node->binary.operator = self->tok.type;
-			node->line = self->tok.line;
-
-			GetNextValidToken(self);
-			node->binary.right = RecUnary(self);
-			break;
+	const uintptr_t frame = (uintptr_t) __builtin_frame_address(0);
 
-		default:
-			goto exit_loop;
-		}
+	if (self->stack - frame > EXPR_STACK_LIMIT) {
+		usererror("expression is nested too deeply");
+		Throw(XXPARSE);
 	}
 
-exit_loop:
-	return node;
-}
-
-static expr *RecUnary(parser *self)
-{
-	assert(self);
-
 	expr *node = NULL;
 
 	switch (self->tok.type) {
@@ -1565,8 +1703,8 @@ static expr *RecPrimary(parser *self)
 	assert(self);
 
 	static const cstring *fmt = "expression is ill-formed at '%s'";
-	const char *view = self->tok.lexeme.view;
-	const size_t len = self->tok.lexeme.len;
+	const char *view = TokenLexeme(self->src, self->tok);
+	const size_t len = self->tok.len;
 
 	assert(view);
 
@@ -1719,7 +1857,7 @@ static expr *RecIdentifier(parser *self)
 
 	expr *node = ExprInit(self, NODE_IDENT);
 	node->line = self->tok.line;
-	node->ident.name = cStringFromLexeme(self);
+	node->ident.name = InternLexeme(self);
 
 	return node;
 }
@@ -1733,7 +1871,7 @@ static expr *RecRvar(parser *self, bool seen_tilde)
 	expr *node = ExprInit(self, NODE_RVARLIT);
 
 	node->line = self->tok.line;
-	node->rvarlit.dist = cStringFromLexeme(self);
+	node->rvarlit.dist = InternLexeme(self);
 
 	if (!seen_tilde) {
 		move_check(_TILDE, "missing '~' after distribution");
@@ -1746,13 +1884,12 @@ static expr *RecRvar(parser *self, bool seen_tilde)
 	return node;
 }
 
-static vector(Expr) RecArguments(parser *self)
+static vector(Args) RecArguments(parser *self)
 {
 	assert(self);
 	assert(self->tok.type == _LEFTPAREN);
 
-	const size_t vec_capacity = 4;
-	vector(Expr) vec = ExprVectorInit(0, vec_capacity);
+	vector(Args) vec = ArgsVectorInit();
 
 	GetNextValidToken(self);
 
@@ -1761,7 +1898,7 @@ static vector(Expr) RecArguments(parser *self)
 			check_move(_COMMA, "missing ',' after arg");
 		}
 
-		ExprVectorPush(&vec, RecAssignment(self));
+		ArgsVectorPush(&vec, RecAssignment(self));
 	}
 
 	GetNextValidToken(self);
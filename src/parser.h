@@ -34,14 +34,15 @@ typedef struct param param;
 typedef struct test test;
 
 //returns NULL if tree is ill-formed. On success all of the symbol and symtable
-//pointers in the returned tree are set to NULL.
+//pointers in the returned tree are set to NULL. Under --Cache the tree may be
+//loaded from the cache instead of parsed; see cache.h.
 module *SyntaxTreeInit(const cstring *filename);
 
 //------------------------------------------------------------------------------
 //<member list>
 
 struct member {
-	cstring *name;
+	const cstring *name;
 	type *typ; 
 	symbol *entry;
 	size_t line;
@@ -54,7 +55,7 @@ make_vector(member, Member, static)
 //<parameter list>
 
 struct param {
-	cstring *name; 
+	const cstring *name; 
 	type *typ;
 	symbol *entry;
 	size_t line;
@@ -78,9 +79,16 @@ make_vector(test, Test, static)
 //<tagged index> integer literals within the <array literal> rule
 make_vector(intmax_t, Index, static)
 
-//<arguments> within the <call>, <rvar literal>, and <array literal> rules
+//<arguments> within the <array literal> rule
 make_vector(expr *, Expr, static)
 
+//<arguments> within the <call> and <rvar literal> rules; most calls have at
+//most ARGS_INLINE arguments, which are then stored in the expr node itself.
+//The inline array is no larger than the array literal node, so it costs no
+//memory.
+#define ARGS_INLINE 3
+make_small_vector(expr *, Args, ARGS_INLINE, static)
+
 //some vectors need to be forward declared for node references, but the
 //implementations must be postponed until sizeof(T) is available.
 alias_vector(Fiat)
@@ -107,12 +115,12 @@ struct type {
 	typetag tag;
 	union {
 		struct {
-			cstring *name; 
+			const cstring *name; 
 			symbol *entry; //null
 		} base;
 	
 		struct {
-			cstring *name; 
+			const cstring *name; 
 			type *reference;
 		} named;
 	
@@ -145,33 +153,35 @@ struct decl {
 	decltag tag;
 	union {
 		struct {
-			cstring *name;
+			const cstring *name;
 			symbol *entry; //null
 			vector(Member) members; //never empty
 			bool public;
 		} udt;
 
 		struct {
-			cstring *name; 
+			const cstring *name; 
 			symbol *entry; //null
 			type *ret; //list head, null if func returns void
 			stmt *block; 
 			vector(Param) params; //may be empty
+			size_t symbols; //params plus declarations in the block
 			bool public;
 		} function;
 
 		struct {
-			cstring *name;
+			const cstring *name;
 			symbol *entry; //null
 			type *ret; //list-head, null if it returns void
 			type *recv;  
 			stmt *block;
 			vector(Param) params; //may be empty
+			size_t symbols; //params plus declarations in the block
 			bool public;
 		} method;
 
 		struct {
-			cstring *name; 
+			const cstring *name; 
 			symbol *entry; //null
 			type *vartype; //list-head 
 			expr *value; //null if no initialisation
@@ -215,13 +225,14 @@ struct stmt {
 		expr *returnstmt; //NULL if function returns void
 
 		struct {
-			cstring *name; 
+			const cstring *name; 
 			symbol *entry;
 		} gotostmt;
 
 		struct {
 			symtable *table; //null
 			vector(Fiat) fiats; //may be empty
+			size_t decls; //declarations directly within the block
 		} block;
 
 		struct {
@@ -256,7 +267,7 @@ struct stmt {
 		} switchstmt;
 
 		struct {
-			cstring *name; 
+			const cstring *name; 
 			symbol *entry; //null
 			stmt *target; 
 		} label;
@@ -314,7 +325,7 @@ struct expr {
 
 		struct {
 			expr *name;
-			vector(Expr) args;
+			vector(Args) args;
 		} call;
 
 		struct {
@@ -333,17 +344,17 @@ struct expr {
 		} arraylit;
 
 		struct {
-			cstring *dist;
-			vector(Expr) args;
+			const cstring *dist;
+			vector(Args) args;
 		} rvarlit;
 
 		struct {
-			cstring *rep; 
+			const cstring *rep; 
 			token_type littype;
 		} lit;
 
 		struct {
-			cstring *name;
+			const cstring *name;
 		} ident;
 	};
 
@@ -375,7 +386,7 @@ impl_vector_reset(fiat, Fiat, static)
 //------------------------------------------------------------------------------
 
 struct import {
-	cstring *alias; //null if import path is the empty string
+	const cstring *alias; //null if import path is the empty string
 	symbol *entry; //null
 	size_t line;
 };
@@ -388,6 +399,7 @@ struct module {
 	vector(Import) imports;
 	vector(Decl) declarations;
 	const cstring *alias;
+	size_t symbols; //imports plus module-level declarations
 	struct module *next; //null (requires resolver) 
 	symtable *table; //null
 	bool flag; //free to use
@@ -1,23 +1,37 @@
 // Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
 
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <string.h>
 
 #include "arena.h"
+#include "channel.h"
 #include "file.h"
+#include "intern.h"
+#include "options.h"
 #include "resolver.h"
+#include "stats.h"
+#include "typetable.h"
 #include "vector.h"
 #include "xerror.h"
 
 typedef struct frame frame;
+typedef struct pool pool;
 
-static bool ResolveDependencies(network *, const cstring *);
+static bool ParseModules(network *, const cstring **, const size_t);
+static void *ParseWorker(void *);
+static bool Dispatch(network *, pool *, const cstring **, const size_t);
+static void StopWorkers(pool *);
+
+static bool ResolveDependencies(network *, const cstring **, const size_t);
+static module *GetSyntaxTree(network *, const cstring *);
 static bool InsertModule(network *, const cstring *);
 static void InsertChildren(network *, module *, const cstring *);
 static void Sort(network *, module *);
 static void ReportCycle(const cstring *, const cstring *);
 
+static frame FrameInit(symtable *);
 static symbol *LookupSymbol(frame *, const cstring *, const size_t);
 static void ReportUndeclared(frame *, const cstring *, const size_t);
 static symbol *InsertSymbol(frame *, const cstring *, symbol);
@@ -32,10 +46,15 @@ static void PopSymTable(frame *);
 static void LoadTemporaryStack(frame *, symtable *);
 static void UnloadTemporaryStack(frame *);
 static type *UnwindType(type *);
-static cstring *StringFromType(type *);
-static void StringFromType__recursive(vstring *, type *);
 
 static bool ResolveSymbols(network *);
+static bool ResolvePrototypes(network *, frame *);
+static bool ResolveSerial(network *, frame *);
+static bool ResolveParallel(network *);
+static void *ResolveWorker(void *);
+static bool ResolveTask(frame *, module *);
+static void MarkReferenced(bool *);
+static void ResolveModulePrototype(frame *);
 static void ResolveModule(frame *);
 static void ResolveImports(frame *);
 static void ResolveDeclarations(frame *);
@@ -50,14 +69,11 @@ static symbol *LookupNamedType(frame *, type *);
 
 static void ResolveFunctionPrototype(frame *, decl *);
 static void ResolveFunction(frame *, decl *);
-static size_t CountDeclsWithinFiat(vector(Fiat));
-static cstring *CreateFuncSignature(decl *);
 static void ResolveParameters(frame *, vector(Param));
 static void ResolveReturnType(frame *, type *);
 
 static void ResolveMethodPrototype(frame *, decl *);
 static void ResolveMethod(frame *, decl *);
-static cstring *CreateMethodSignature(decl *);
 static void ResolveRecvType(frame *, type *);
 
 static void ResolveVariablePrototype(frame *, decl *);
@@ -67,16 +83,36 @@ static void ResolveBlock(frame *, stmt *);
 
 //------------------------------------------------------------------------------
 
-network *ResolverInit(const cstring *filename)
+network *ResolverInit(const cstring **filenames, const size_t total)
 {
-	assert(filename);
+	assert(filenames);
+	assert(total);
+
+	return ResolverReuse(filenames, total, ModuleGraphInit());
+}
+
+network *ResolverReuse
+(
+	const cstring **filenames,
+	const size_t total,
+	graph(Module) reused
+)
+{
+	assert(filenames);
+	assert(total);
 
 	network *net = allocate(sizeof(network));
 
 	net->dependencies = ModuleGraphInit();
 	net->head = NULL;
+	net->parsed = ModuleGraphInit();
+	net->reused = reused;
+
+	uint64_t start = StatsClock();
 
-	bool ok = ResolveDependencies(net, filename);
+	bool ok = ResolveDependencies(net, filenames, total);
+
+	StatsTime(WATCH_FRONTEND, start);
 
 	if (!ok) {
 		return NULL; 
@@ -86,8 +122,12 @@ network *ResolverInit(const cstring *filename)
 	//underlying hash table count.
 	net->global = SymTableInit(net->dependencies.len);
 
+	start = StatsClock();
+
 	ok = ResolveSymbols(net);
 
+	StatsTime(WATCH_SYMBOLS, start);
+
 	if (!ok) {
 		return NULL;
 	}
@@ -95,31 +135,313 @@ network *ResolverInit(const cstring *filename)
 	return net;
 }
 
+//------------------------------------------------------------------------------
+// Phase 0: parallel front end
+//
+// When --Threads is greater than one the ASTs of all reachable modules are built
+// by a bounded pool of worker threads before dependency resolution begins. The
+// calling thread dispatches every root module, and whenever a tree comes back
+// it dispatches every import that has not been seen before. So, all roots and
+// all imports of a module are scanned and parsed at the same time. Each worker
+// allocates from its own thread-local arena, which it detaches on exit so the
+// trees survive.
+//
+// The finished trees are collected in network.parsed and phase 1 consumes them
+// instead of invoking the parser; the cycle check and the topological sort are
+// unchanged. A tree found in network.reused is collected by the dispatcher as
+// though a worker had just returned it. The dispatcher never has more requests
+// in flight than there are workers, so neither channel can fill up and neither
+// side can deadlock.
+
+//@ast: NULL on request; on response it is NULL if the AST is ill-formed
+typedef struct job {
+	const cstring *filename;
+	module *ast;
+} job;
+
+make_channel(job, Job, static)
+
+make_vector(const cstring *, Name, static)
+
+static void Collect(network *, vector(Name) *, const cstring *, module *);
+
+//a job with a NULL filename tells the receiving worker to exit
+struct pool {
+	channel(Job) requests;
+	channel(Job) responses;
+	pthread_t *threads;
+	size_t total;
+};
+
+//returns false if any module cannot be parsed
+static
+bool ParseModules(network *net, const cstring **filenames, const size_t total)
+{
+	assert(net);
+	assert(filenames);
+
+	const size_t capacity = OptionsThreads();
+
+	pool workers = {
+		.threads = allocate(sizeof(pthread_t) * capacity),
+		.total = 0
+	};
+
+	JobChannelInit(&workers.requests, capacity);
+	JobChannelInit(&workers.responses, capacity);
+
+	for (size_t i = 0; i < capacity; i++) {
+		pthread_t *thread = workers.threads + i;
+		int err = pthread_create(thread, NULL, ParseWorker, &workers);
+
+		if (err) {
+			const cstring *msg = strerror(err);
+			xerror_issue("cannot create thread: pthread error: %s", msg);
+			break;
+		}
+
+		workers.total++;
+	}
+
+	bool ok = false;
+
+	if (workers.total) {
+		ok = Dispatch(net, &workers, filenames, total);
+	}
+
+	StopWorkers(&workers);
+
+	return ok;
+}
+
+//pthread_create argument
+static void *ParseWorker(void *pthread_payload)
+{
+	pool *workers = (pool *) pthread_payload;
+
+	//without an arena the worker still answers every request so that the
+	//dispatcher is never left waiting on a response
+	const bool ready = ArenaInit(OptionsArena());
+
+	if (!ready) {
+		xerror_fatal("cannot initialise worker arena");
+	}
+
+	job task = {
+		.filename = NULL,
+		.ast = NULL
+	};
+
+	while (true) {
+		int err = JobChannelRecv(&workers->requests, &task);
+
+		if (err || !task.filename) {
+			break;
+		}
+
+		task.ast = ready ? SyntaxTreeInit(task.filename) : NULL;
+
+		//the response channel is never closed
+		(void) JobChannelSend(&workers->responses, task);
+	}
+
+	ArenaDetach();
+
+	return NULL;
+}
+
+//returns false if any AST is ill-formed; on return no requests are in flight
+static bool Dispatch
+(
+	network *net,
+	pool *workers,
+	const cstring **filenames,
+	const size_t total
+)
+{
+	assert(net);
+	assert(workers);
+	assert(workers->total);
+	assert(filenames);
+
+	vector(Name) pending = NameVectorInit(0, VECTOR_DEFAULT_CAPACITY);
+	size_t in_flight = 0;
+	bool ok = true;
+
+	//pushed in reverse so that the roots are dispatched in order
+	for (size_t i = total; i--;) {
+		const cstring *filename = filenames[i];
+
+		if (!ModuleGraphSearch(&net->parsed, filename, NULL)) {
+			(void) ModuleGraphInsert(&net->parsed, filename, NULL);
+			NameVectorPush(&pending, filename);
+		}
+	}
+
+	while (pending.len || in_flight) {
+		while (ok && pending.len && in_flight < workers->total) {
+			const job request = {
+				.filename = NameVectorPop(&pending),
+				.ast = NULL
+			};
+
+			module *ast = NULL;
+			const cstring *name = request.filename;
+
+			if (ModuleGraphSearch(&net->reused, name, &ast)) {
+				Collect(net, &pending, name, ast);
+				continue;
+			}
+
+			//the request channel is only closed by StopWorkers
+			(void) JobChannelSend(&workers->requests, request);
+			in_flight++;
+		}
+
+		if (!in_flight) {
+			break;
+		}
+
+		job response = {
+			.filename = NULL,
+			.ast = NULL
+		};
+
+		//the response channel is never closed
+		(void) JobChannelRecv(&workers->responses, &response);
+		in_flight--;
+
+		//stop dispatching but drain the requests that are in flight
+		if (!response.ast) {
+			xerror_fatal("cannot create AST; %s", response.filename);
+			ok = false;
+			continue;
+		}
+
+		Collect(net, &pending, response.filename, response.ast);
+	}
+
+	return ok;
+}
+
+//records the tree of filename and queues each of its imports not seen before
+static void Collect
+(
+	network *net,
+	vector(Name) *pending,
+	const cstring *filename,
+	module *ast
+)
+{
+	assert(net);
+	assert(pending);
+	assert(filename);
+	assert(ast);
+
+	(void) ModuleGraphModify(&net->parsed, filename, ast);
+
+	for (size_t i = 0; i < ast->imports.len; i++) {
+		const cstring *childname = ast->imports.buffer[i].alias;
+
+		if (ModuleGraphSearch(&net->parsed, childname, NULL)) {
+			continue;
+		}
+
+		(void) ModuleGraphInsert(&net->parsed, childname, NULL);
+		NameVectorPush(pending, childname);
+	}
+}
+
+static void StopWorkers(pool *workers)
+{
+	assert(workers);
+
+	const job sentinel = {
+		.filename = NULL,
+		.ast = NULL
+	};
+
+	//nothing is in flight so the request channel has room for every sentinel
+	for (size_t i = 0; i < workers->total; i++) {
+		(void) JobChannelSend(&workers->requests, sentinel);
+	}
+
+	for (size_t i = 0; i < workers->total; i++) {
+		int err = pthread_join(workers->threads[i], NULL);
+
+		if (err) {
+			const cstring *msg = strerror(err);
+			xerror_issue("cannot join thread: pthread error: %s", msg);
+		}
+	}
+
+	(void) JobChannelShutdown(&workers->requests);
+	(void) JobChannelShutdown(&workers->responses);
+}
+
 //------------------------------------------------------------------------------
 // Phase 1: resolve import directives
 //
 // Dependency resolution is combined with a simultaneous topological sort. This
 // is possible because a well-formed dependency digraph is rooted and acyclic
-// and all vertices are reachable via the root (by the definition of an import).
-// Since both dependency resolution and sorting are recursive DFS algorithms
-// they can share the traversal logic.
+// and all vertices are reachable via the roots (by the definition of an
+// import). Since both dependency resolution and sorting are recursive DFS
+// algorithms they can share the traversal logic. The search from each root in
+// turn continues the list left by the previous one, and every vertex reached
+// from two roots is visited once, so the list stays in topological order.
+
+//total cost of the trees built by GetSyntaxTree on the calling thread
+static sample inline_parse = {
+	.time = 0,
+	.bytes = 0
+};
 
 //returns false if failed
-static bool ResolveDependencies(network *net, const cstring *filename)
+static bool ResolveDependencies
+(
+	network *net,
+	const cstring **filenames,
+	const size_t total
+)
 {
 	assert(net);
-	assert(filename);
+	assert(filenames);
 
 	CEXCEPTION_T e;
 
+	inline_parse = (sample) {
+		.time = 0,
+		.bytes = 0
+	};
+
+	if (OptionsThreads() > 1 && !ParseModules(net, filenames, total)) {
+		xerror_fatal("cannot resolve dependencies");
+		return false;
+	}
+
+	const sample start = StatsSample();
+
+	//a root which another root imports is already in the graph, so each
+	//module is inserted and sorted once however many roots reach it
 	Try {
-		bool ok = InsertModule(net, filename);
-		assert(ok && "base case triggered on first insertion");
+		for (size_t i = 0; i < total; i++) {
+			bool ok = InsertModule(net, filenames[i]);
+			assert(ok && "root is on the call stack");
+			(void) ok;
+		}
 	} Catch (e) {
 		xerror_fatal("cannot resolve dependencies");
 		return false;
 	}
 
+	//trees built on this thread during the sort are charged to their
+	//modules by the parser, so they are excluded from the sort phase
+	sample cost = StatsSince(start);
+	cost.time -= inline_parse.time;
+	cost.bytes -= inline_parse.bytes;
+
+	StatsProfile(NULL, PHASE_SORT, cost);
+
 	return true;
 }
 
@@ -131,6 +453,33 @@ enum {
 	OFF_CALL_STACK = true
 };
 
+//returns the tree built by phase 0 or reused from a previous network if either
+//exists, otherwise the tree is built on the calling thread; returns NULL if the
+//tree is ill-formed
+static module *GetSyntaxTree(network *net, const cstring *filename)
+{
+	assert(net);
+	assert(filename);
+
+	module *ast = NULL;
+
+	if (ModuleGraphSearch(&net->reused, filename, &ast)) {
+		return ast;
+	}
+
+	if (!ModuleGraphSearch(&net->parsed, filename, &ast)) {
+		const sample start = StatsSample();
+
+		ast = SyntaxTreeInit(filename);
+
+		const sample cost = StatsSince(start);
+		inline_parse.time += cost.time;
+		inline_parse.bytes += cost.bytes;
+	}
+
+	return ast;
+}
+
 static bool InsertModule(network *net, const cstring *filename)
 {
 	assert(net);
@@ -142,11 +491,12 @@ static bool InsertModule(network *net, const cstring *filename)
 		return vertex->flag;
 	}
 
-	vertex = SyntaxTreeInit(filename);
+	vertex = GetSyntaxTree(net, filename);
 
 	if (!vertex) {
 		xerror_fatal("cannot create AST; %s", filename);
 		Throw(XXGRAPH);
+		__builtin_unreachable();
 	}
 
 	(void) ModuleGraphInsert(&net->dependencies, filename, vertex);
@@ -180,7 +530,8 @@ void InsertChildren(network *net, module *parent, const cstring *parentname)
 }
 
 //since C does not allow closures a cheeky static variable keeps track of the
-//previous vertex that was threaded through the intrusive list.
+//previous vertex that was threaded through the intrusive list. It is stale when
+//the list of a new network is empty, so the head is checked instead.
 static void Sort(network *net, module *curr)
 {
 	assert(net);
@@ -188,7 +539,7 @@ static void Sort(network *net, module *curr)
 
 	static module *prev = NULL;
 
-	if (!prev) {
+	if (!net->head) {
 		net->head = curr;
 	} else {
 		prev->next = curr;
@@ -213,54 +564,328 @@ static void ReportCycle(const cstring *parent, const cstring *child)
 
 make_vector(symtable *, SymTable, static)
 
+//names are resolved by walking the parent chain of the active table. A flat
+//shadow map, with one stack of bindings per name, was measured in its place
+//and lost: blocks share the table of their function, so no chain is longer
+//than three tables, and the resolver does about one lookup per insertion. On a
+//generated input of 10k functions, keeping the map current on every insertion
+//and pop cost more than the probes it saved and the symbol phase was about 35%
+//slower, so the chain walk is the only strategy.
+
 //the frame tracks stacks of data during the depth-first AST traveral
 //@ast: root node of the AST currently undergoing symbol resolution
 //@top: leaf table of the active stack within the n-ary symtable tree; non-null
 //@history: stack of symbol table stacks; whenever the compiler needs to context
 //switch to a different module's root symbol table, the previous symbol table
 //stack is recorded in the history for later restoration.
+//@symbols: total symbols inserted into every table during resolution
 struct frame {
 	module *ast;
 	symtable *top;
 	vector(SymTable) history;
+	size_t symbols;
 };
 
+//module symbols are inserted into the global table before any module is
+//resolved, so from then on the global table is read-only
 static bool ResolveSymbols(network *net)
 {
 	assert(net);
 	assert(net->head);
 	assert(net->global);
 
-	CEXCEPTION_T e;
+	frame current = FrameInit(net->global);
+	bool ok = ResolvePrototypes(net, &current);
 
-	frame current = {
-		.ast = NULL,
-		.top = NULL,
-		.history = SymTableVectorInit(0, VECTOR_DEFAULT_CAPACITY)
-	};
+	if (ok && OptionsThreads() > 1 && net->head->next) {
+		StatsCount(STAT_SYMBOLS, current.symbols);
+		ok = ResolveParallel(net);
+	} else if (ok) {
+		ok = ResolveSerial(net, &current);
+		StatsCount(STAT_SYMBOLS, current.symbols);
+	}
+
+	if (!ok) {
+		xerror_fatal("symbol resolution failed");
+	}
+
+	return ok;
+}
+
+//inserts the module symbols into the global table
+static bool ResolvePrototypes(network *net, frame *current)
+{
+	assert(net);
+	assert(current);
+
+	CEXCEPTION_T e;
 
 	Try {
-		module *node = net->head;
+		for (module *node = net->head; node; node = node->next) {
+			current->ast = node;
+			ResolveModulePrototype(current);
+		}
+	} Catch (e) {
+		return false;
+	}
 
-		while (node) {
-			current.ast = node;
-			current.top = net->global;
+	return true;
+}
 
-			ResolveModule(&current);
+//resolves the modules one at a time in topological order
+static bool ResolveSerial(network *net, frame *current)
+{
+	assert(net);
+	assert(current);
 
-			node = node->next;
+	for (module *node = net->head; node; node = node->next) {
+		if (!ResolveTask(current, node)) {
+			return false;
 		}
+	}
+
+	return true;
+}
+
+//returns false if the module is ill-formed
+static bool ResolveTask(frame *current, module *node)
+{
+	assert(current);
+	assert(node);
+
+	assert(current->top->tag == TABLE_GLOBAL);
+	assert(!current->history.len);
+
+	CEXCEPTION_T e;
+
+	current->ast = node;
+
+	const sample start = StatsSample();
+
+	Try {
+		ResolveModule(current);
 	} Catch (e) {
-		xerror_fatal("symbol resolution failed");
 		return false;
 	}
 
+	const sample cost = StatsSince(start);
+	StatsProfile(node->alias, PHASE_SYMBOLS, cost);
+
 	return true;
 }
 
+//------------------------------------------------------------------------------
+// When --Threads is greater than one the modules are resolved by a pool of
+// worker threads, each with its own frame. A module is ready once every module
+// it imports has been resolved, so a worker only ever reads finished tables:
+// the global table, and the module tables of the dependencies which it reaches
+// through its import symbols. The only writes to the symbols of a dependency
+// are referenced flags, which every importer sets with a relaxed atomic store.
+//
+// The schedule walks the dependency DAG rather than its levels. Each task
+// counts the imports which are still unresolved, and the worker that resolves
+// a module moves every dependent whose count drops to zero onto the ready
+// stack. Modules in independent branches of a wide import graph are therefore
+// resolved at the same time even when the branches have different depths.
+
+make_vector(size_t, Edge, static)
+make_map(size_t, Position, static)
+
+//@pending: imports of the module which have not been resolved yet
+//@dependents: indices of the tasks whose modules import this module, listed
+//once per import directive
+typedef struct task {
+	module *ast;
+	size_t pending;
+	vector(Edge) dependents;
+} task;
+
+//@ready: indices of the tasks whose imports are all resolved; preallocated so
+//that workers never grow a vector which lives in another thread's arena
+typedef struct schedule {
+	pthread_mutex_t mutex;
+	pthread_cond_t wakeup;
+	symtable *global;
+	task *tasks;
+	size_t total;
+	vector(Edge) ready;
+	size_t finished;
+	size_t symbols;
+	bool failed;
+} schedule;
+
+//the schedule lives in a scratch region of the main thread; workers never grow
+//any part of it
+static bool ResolveParallel(network *net)
+{
+	assert(net);
+
+	ArenaPush();
+
+	const size_t total = net->dependencies.len;
+
+	schedule plan = {
+		.mutex = PTHREAD_MUTEX_INITIALIZER,
+		.wakeup = PTHREAD_COND_INITIALIZER,
+		.global = net->global,
+		.tasks = allocate(sizeof(task) * total),
+		.total = total,
+		.ready = EdgeVectorInit(0, total),
+		.finished = 0,
+		.symbols = 0,
+		.failed = false
+	};
+
+	map(Position) positions = PositionMapInit(MAP_MINIMUM_CAPACITY(total));
+	size_t i = 0;
+
+	for (module *node = net->head; node; node = node->next, i++) {
+		plan.tasks[i] = (task) {
+			.ast = node,
+			.pending = node->imports.len,
+			.dependents = EdgeVectorInit(0, VECTOR_DEFAULT_CAPACITY)
+		};
+
+		(void) PositionMapInsert(&positions, node->alias, i);
+
+		for (size_t j = 0; j < node->imports.len; j++) {
+			const cstring *alias = node->imports.buffer[j].alias;
+			size_t k = 0;
+
+			//imports precede their importers in topological order
+			bool found = PositionMapGet(&positions, alias, &k);
+			assert(found);
+			(void) found;
+
+			EdgeVectorPush(&plan.tasks[k].dependents, i);
+		}
+	}
+
+	assert(i == total);
+
+	//pushed in reverse so that the workers pop in topological order
+	while (i--) {
+		if (!plan.tasks[i].pending) {
+			EdgeVectorPush(&plan.ready, i);
+		}
+	}
+
+	const size_t threads = OptionsThreads();
+	const size_t capacity = threads < total ? threads : total;
+	pthread_t *workers = allocate(sizeof(pthread_t) * capacity);
+	size_t created = 0;
+
+	for (size_t j = 0; j < capacity; j++) {
+		int err = pthread_create(workers + j, NULL, ResolveWorker, &plan);
+
+		if (err) {
+			const cstring *msg = strerror(err);
+			xerror_issue("cannot create thread: pthread error: %s", msg);
+			break;
+		}
+
+		created++;
+	}
+
+	for (size_t j = 0; j < created; j++) {
+		int err = pthread_join(workers[j], NULL);
+
+		if (err) {
+			const cstring *msg = strerror(err);
+			xerror_issue("cannot join thread: pthread error: %s", msg);
+		}
+	}
+
+	(void) pthread_cond_destroy(&plan.wakeup);
+	(void) pthread_mutex_destroy(&plan.mutex);
+
+	StatsCount(STAT_SYMBOLS, plan.symbols);
+
+	ArenaPop();
+
+	return created && !plan.failed && plan.finished == total;
+}
+
+//pthread_create argument; workers leave as soon as any module fails
+static void *ResolveWorker(void *pthread_payload)
+{
+	schedule *plan = (schedule *) pthread_payload;
+
+	const bool ready = ArenaInit(OptionsArena());
+
+	pthread_mutex_lock(&plan->mutex);
+
+	if (!ready) {
+		xerror_fatal("cannot initialise worker arena");
+		plan->failed = true;
+		pthread_cond_broadcast(&plan->wakeup);
+		pthread_mutex_unlock(&plan->mutex);
+		ArenaDetach();
+		return NULL;
+	}
+
+	frame current = FrameInit(plan->global);
+
+	while (true) {
+		while (!plan->ready.len && !plan->failed
+		       && plan->finished < plan->total) {
+			pthread_cond_wait(&plan->wakeup, &plan->mutex);
+		}
+
+		if (plan->failed || plan->finished == plan->total) {
+			break;
+		}
+
+		task *next = plan->tasks + EdgeVectorPop(&plan->ready);
+
+		pthread_mutex_unlock(&plan->mutex);
+
+		const bool ok = ResolveTask(&current, next->ast);
+
+		pthread_mutex_lock(&plan->mutex);
+
+		plan->finished++;
+		plan->failed |= !ok;
+
+		for (size_t i = 0; ok && i < next->dependents.len; i++) {
+			task *dependent = plan->tasks + next->dependents.buffer[i];
+
+			if (--dependent->pending == 0) {
+				const size_t index = (size_t) (dependent - plan->tasks);
+				EdgeVectorPush(&plan->ready, index);
+			}
+		}
+
+		pthread_cond_broadcast(&plan->wakeup);
+	}
+
+	plan->symbols += current.symbols;
+
+	pthread_mutex_unlock(&plan->mutex);
+
+	ArenaDetach();
+
+	return NULL;
+}
+
 //------------------------------------------------------------------------------
 //symbol resolution utilities
 
+static frame FrameInit(symtable *global)
+{
+	assert(global);
+	assert(global->tag == TABLE_GLOBAL);
+
+	frame self = {
+		.ast = NULL,
+		.top = global,
+		.history = SymTableVectorInit(0, VECTOR_DEFAULT_CAPACITY),
+		.symbols = 0
+	};
+
+	return self;
+}
+
 //throw XXSYMBOL exception is key does not exist in the active stack
 static symbol *LookupSymbol(frame *self, const cstring *key, const size_t line)
 {
@@ -273,6 +898,7 @@ static symbol *LookupSymbol(frame *self, const cstring *key, const size_t line)
 	if (!symref) {
 		ReportUndeclared(self, key, line);
 		Throw(XXSYMBOL);
+		__builtin_unreachable();
 	}
 
 	return symref;
@@ -295,6 +921,7 @@ static symbol *InsertSymbol(frame *self, const cstring *key, symbol value)
 {
 	assert(self);
 	assert(key);
+	assert(!self->history.len && "insertion into a temporary stack");
 
 	symbol *symref = SymTableInsert(self->top, key, value);
 
@@ -303,6 +930,8 @@ static symbol *InsertSymbol(frame *self, const cstring *key, symbol value)
 		Throw(XXSYMBOL);
 	}
 
+	self->symbols++;
+
 	return symref;
 }
 
@@ -498,59 +1127,23 @@ static type *UnwindType(type *node)
 	}
 }
 
-//unwind the singly linked type list and compress it recursively into a compact
-//string notation; i..e, the type list [10] -> * -> int32 becomes "[10]*int32"
-static cstring *StringFromType(type *node)
-{
-	assert(node);
-
-	const size_t typical_type_length = 16;
-
-	vstring vstr = vStringInit(typical_type_length);
-
-	StringFromType__recursive(&vstr, node);
-
-	return cStringFromvString(&vstr);
-}
+//------------------------------------------------------------------------------
 
-static void StringFromType__recursive(vstring *vstr, type *node)
+//referenced flags only ever change from false to true, but a module symbol or
+//a public UDT may be marked by several modules which are resolved in parallel
+static void MarkReferenced(bool *flag)
 {
-	assert(node);
-	assert(vstr);
-	
-	switch (node->tag) {
-	case NODE_BASE:
-		vStringAppendcString(vstr, node->base.name);
-		break;
-
-	case NODE_NAMED:
-		vStringAppendcString(vstr, node->named.name);
-		StringFromType__recursive(vstr, node->named.reference);
-		break;
-
-	case NODE_POINTER:
-		vStringAppend(vstr, '*');
-		StringFromType__recursive(vstr, node->pointer.reference);
-		break;
-	
-	case NODE_ARRAY:
-		vStringAppend(vstr, '[');
-		vStringAppendIntMax(vstr, node->array.len);
-		vStringAppend(vstr, ']');
-		StringFromType__recursive(vstr, node->array.element);
-		break;
+	assert(flag);
 
-	default:
-		assert(0 != 0 && "invalid type tag");
-		__builtin_unreachable();
-	}
+	__atomic_store_n(flag, true, __ATOMIC_RELAXED);
 }
 
-//------------------------------------------------------------------------------
-
-static void ResolveModule(frame *self)
+//introduces the module symbol into the global table; its module table is
+//attached once the module itself is resolved
+static void ResolveModulePrototype(frame *self)
 {
 	assert(self);
+	assert(self->top->tag == TABLE_GLOBAL);
 
 	symbol sym = {
 		.tag = SYMBOL_MODULE,
@@ -560,11 +1153,22 @@ static void ResolveModule(frame *self)
 		}
 	};
 
+	(void) InsertSymbol(self, self->ast->alias, sym);
+}
+
+static void ResolveModule(frame *self)
+{
+	assert(self);
+	assert(self->top->tag == TABLE_GLOBAL);
+
 	module *const node = self->ast;
-	symbol *symref = InsertSymbol(self, node->alias, sym);
+	symbol *symref = SymTableLookup(self->top, node->alias, NULL);
 
-	const size_t capacity = node->imports.len + node->declarations.len;
-	push(self, TABLE_MODULE, capacity);
+	assert(symref);
+	assert(symref->tag == SYMBOL_MODULE);
+	assert(!symref->module.table);
+
+	push(self, TABLE_MODULE, node->symbols);
 
 	symref->module.table = self->top;
 	node->table = self->top;
@@ -606,7 +1210,7 @@ static void ResolveImports(frame *self)
 
 		symbol *symref = LookupSymbol(self, node->alias, node->line);
 		assert(symref->tag == SYMBOL_MODULE);
-		symref->module.referenced = true;
+		MarkReferenced(&symref->module.referenced);
 
 		entry.import.table = symref->module.table;
 		entry.import.line = node->line;
@@ -703,7 +1307,7 @@ static void ResolveMembers(frame *self, vector(Member) members)
 	symbol sym = {
 		.tag = SYMBOL_FIELD,
 		.field = {
-			.type = NULL,
+			.type = TYPE_NONE,
 			.line = 0,
 			.referenced = false,
 			.public = false
@@ -717,7 +1321,7 @@ static void ResolveMembers(frame *self, vector(Member) members)
 		member *node = &members.buffer[i];
 
 		sym.field.line = node->line;
-		sym.field.type = StringFromType(node->typ);
+		sym.field.type = TypeTableFromNode(node->typ);
 		sym.field.public = node->public;
 
 		symbol *symref = InsertSymbol(self, node->name, sym);
@@ -781,7 +1385,7 @@ static symbol *LookupBaseType(frame *self, type *node)
 
 	switch (tag) {
 	case SYMBOL_UDT:
-		symref->udt.referenced = true;
+		MarkReferenced(&symref->udt.referenced);
 		__attribute__((fallthrough));
 
 	case SYMBOL_NATIVE:
@@ -839,7 +1443,7 @@ static symbol *LookupNamedType(frame *self, type *node)
 		goto restore;
 	}
 
-	underlying->udt.referenced = true;
+	MarkReferenced(&underlying->udt.referenced);
 
 	pop_stack(self);
 	return symref;
@@ -863,7 +1467,7 @@ static void ResolveFunctionPrototype(frame *self, decl *node)
 		.tag = SYMBOL_FUNCTION,
 		.function = {
 			.table = NULL,
-			.signature = CreateFuncSignature(node),
+			.signature = TypeTableFromDecl(node),
 			.line = node->line,
 			.referenced = false
 		}
@@ -880,12 +1484,7 @@ static void ResolveFunction(frame *self, decl *node)
 	
 	symbol *symref = LookupSymbol(self, node->function.name, node->line);
 
-	vector(Fiat) fiats = node->function.block->block.fiats;
-	const size_t num_decls = CountDeclsWithinFiat(fiats);
-	const size_t num_params = node->function.params.len;
-	const size_t table_capacity = num_params + num_decls;
-
-	push(self, TABLE_FUNCTION, table_capacity);
+	push(self, TABLE_FUNCTION, node->function.symbols);
 
 	symref->function.table = self->top;
 	node->function.entry = symref;
@@ -898,53 +1497,6 @@ static void ResolveFunction(frame *self, decl *node)
 	pop(self);
 }
 
-static size_t CountDeclsWithinFiat(vector(Fiat) fiats)
-{
-	size_t count = 0;
-
-	for (size_t i = 0; i < fiats.len; i++) {
-		fiat node = fiats.buffer[i];
-
-		if (node.tag == NODE_DECL) {
-			count++;
-		}
-	}
-
-	return count;	
-}
-
-static cstring *CreateFuncSignature(decl *node)
-{
-	assert(node);
-	assert(node->tag == NODE_FUNCTION);
-
-	vstring vstr = vStringInit(VECTOR_DEFAULT_CAPACITY);
-
-	vector(Param) params = node->function.params;
-
-	//comma concatenate the parameter type list
-	if (params.len != 0) {
-		for (size_t i = 0; i < params.len; i++) {
-			if (i > 0) {
-				vStringAppend(&vstr, ',');
-			}
-
-			type *node = params.buffer[i].typ;
-			vStringAppendcString(&vstr, StringFromType(node));
-		}
-	}
-
-	vStringAppend(&vstr, ':');
-
-	type *return_type = node->function.ret;
-
-	if (return_type) {
-		vStringAppendcString(&vstr, StringFromType(return_type));
-	}
-
-	return cStringFromvString(&vstr);
-}
-
 static void ResolveParameters(frame *self, vector(Param) params)
 {
 	assert(self);
@@ -952,7 +1504,7 @@ static void ResolveParameters(frame *self, vector(Param) params)
 	symbol sym = {
 		.tag = SYMBOL_PARAMETER,
 		.parameter = {
-			.type = NULL,
+			.type = TYPE_NONE,
 			.line = 0,
 			.referenced = false
 		}
@@ -964,7 +1516,7 @@ static void ResolveParameters(frame *self, vector(Param) params)
 	while (i < params.len) {
 		param *node = &params.buffer[i];
 
-		sym.parameter.type = StringFromType(node->typ);
+		sym.parameter.type = TypeTableFromNode(node->typ);
 		sym.parameter.line = node->line;
 
 		symbol *symref = InsertSymbol(self, node->name, sym);
@@ -1009,7 +1561,7 @@ static void ResolveMethodPrototype(frame *self, decl *node)
 		.tag = SYMBOL_METHOD,
 		.method = {
 			.table = NULL,
-			.signature = CreateMethodSignature(node),
+			.signature = TypeTableFromDecl(node),
 			.line = node->line,
 			.referenced = false
 		}
@@ -1026,12 +1578,7 @@ static void ResolveMethod(frame *self, decl *node)
 	
 	symbol *symref = LookupSymbol(self, node->method.name, node->line);
 
-	vector(Fiat) fiats = node->method.block->block.fiats;
-	const size_t num_decls = CountDeclsWithinFiat(fiats);
-	const size_t num_params = node->method.params.len;
-	const size_t table_capacity = num_params + num_decls;
-
-	push(self, TABLE_METHOD, table_capacity);
+	push(self, TABLE_METHOD, node->method.symbols);
 
 	symref->method.table = self->top;
 	node->method.entry = symref;
@@ -1044,46 +1591,6 @@ static void ResolveMethod(frame *self, decl *node)
 	pop(self);
 }
 
-static cstring *CreateMethodSignature(decl *node)
-{
-	assert(node);
-	assert(node->tag == NODE_METHOD);
-
-	vstring vstr = vStringInit(VECTOR_DEFAULT_CAPACITY);
-
-	vector(Param) params = node->method.params;
-
-	//comma concatenate the parameter type list
-	if (params.len != 0) {
-		for (size_t i = 0; i < params.len; i++) {
-			if (i > 0) {
-				vStringAppend(&vstr, ',');
-			}
-
-			type *node = params.buffer[i].typ;
-			vStringAppendcString(&vstr, StringFromType(node));
-		}
-	}
-
-	vStringAppend(&vstr, ':');
-
-	type *return_type = node->method.ret;
-
-	if (return_type) {
-		vStringAppendcString(&vstr, StringFromType(return_type));
-	}
-
-	vStringAppend(&vstr, ':');
-
-	type *recv_type = node->method.recv;
-
-	if (recv_type) {
-		vStringAppendcString(&vstr, StringFromType(recv_type));
-	}
-
-	return cStringFromvString(&vstr);
-}
-
 //if node is null (returns void) then no-op
 static void ResolveRecvType(frame *self, type *node)
 {
@@ -1109,7 +1616,7 @@ static void ResolveVariablePrototype(frame *self, decl *node)
 	symbol sym = {
 		.tag = SYMBOL_VARIABLE,
 		.variable = {
-			.type = StringFromType(node->variable.vartype),
+			.type = TypeTableFromNode(node->variable.vartype),
 			.line = node->line,
 			.referenced = false,
 			.public = node->variable.public
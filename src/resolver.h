@@ -16,8 +16,10 @@
 make_graph(module *, Module, static)
 
 //------------------------------------------------------------------------------
-// @dependencies: Rooted directed acyclic graph. Edges are given by the module
-// import member where X -> Y if and only if X imports Y.
+// @dependencies: Directed acyclic graph rooted at the input files. Edges are
+// given by the module import member where X -> Y if and only if X imports Y. A
+// module reached from several roots is a single vertex, so it is parsed and
+// resolved once however many roots import it.
 //
 // @head: Intrusive linked list threaded through the verticies of the dependency
 // graph in topological order. The topological order is defined such that the 
@@ -28,12 +30,35 @@ make_graph(module *, Module, static)
 // @global: predeclared identifiers such as native types and native functions.
 // Points to module->public. Like network.head it weaves its own parent pointer
 // tree through the module's AST.
+//
+// @parsed: ASTs built ahead of the topological sort by the parallel front end;
+// remains empty when --Threads is not greater than one.
+//
+// @reused: ASTs taken from earlier networks in place of the parser; see
+// ResolverReuse.
 
 typedef struct network {
 	graph(Module) dependencies;
 	module *head;
 	symtable *global;
+	graph(Module) parsed;
+	graph(Module) reused;
 } network;
 
-//returns NULL on failure
-network *ResolverInit(const cstring *filename);
+//builds one network from all of the total root files; returns NULL on failure,
+//which includes a failure of any one root
+network *ResolverInit(const cstring **filenames, const size_t total);
+
+//as ResolverInit, except that a module named in reused takes its tree from the
+//graph instead of scanning and parsing its file again. The trees may belong to
+//an earlier network, whose list and symbol tables are no longer valid after
+//this call. The resolver overwrites the intrusive list, the visit flag, and the
+//symbol and table pointers of every tree it visits but no other part of them,
+//so a tree remains reusable even if the call fails. The symbol tables are
+//always resolved from the beginning.
+network *ResolverReuse
+(
+	const cstring **filenames,
+	const size_t total,
+	graph(Module) reused
+);
@@ -11,6 +11,10 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
 #include "arena.h"
 #include "scanner.h"
 #include "options.h"
@@ -20,26 +24,35 @@
 //------------------------------------------------------------------------------
 //@pos current byte being analysed
 //@curr used with pos to help process multi-char lexemes
+//@batch tokens which have been found but not yet sent on the channel, or in
+//inline mode not yet pulled by ScannerNext; chan is NULL in inline mode
+//@taken number of batch elements already pulled by ScannerNext
 
-typedef struct scanner scanner;
-
+static scanner *ScannerNew(cstring *, channel(Token) *);
 static void* StartRoutine(void *);
 static void Scan(scanner *);
+static bool ScanNext(scanner *);
 static void Consume(scanner *, token_type, size_t);
 static void ConsumeIfPeek(scanner *, char, token_type, token_type);
 static void ConsumeComment(scanner *);
 static void ConsumeNumber(scanner *);
 static void ConsumeString(scanner *);
 static void ConsumeSpace(scanner *);
-static void ConsumeInvalid(scanner *, token_flags);
+static void ConsumeInvalid(scanner *, uint8_t);
 static void ConsumeIdentOrKeyword(scanner *);
 static size_t GetIdentOrKeywordLength(scanner *);
 static size_t Synchronize(scanner *);
 static char Peek(scanner *);
+static uint32_t Offset(scanner *, const char *);
 static bool IsLetterDigit(char);
 static bool IsLetter(char);
 static bool IsSpaceEOF(char);
+static char *SkipSpace(char *, size_t *);
+static char *FindIdentEnd(char *);
+static char *FindQuoteOrNull(char *);
+static char *FindNewlineOrNull(char *);
 static void SendToken(scanner *);
+static void SendBatch(scanner *);
 static void SendEOF(scanner *);
 static const cstring *GetTokenName(token_type);
 static void TokenPrint(scanner *);
@@ -54,18 +67,16 @@ struct scanner {
 	cstring *src;
 	size_t line;
 	token tok;
+	token batch[TOKEN_BATCH];
+	size_t pending;
+	size_t taken;
 };
 
-bool ScannerInit(cstring *src, channel(Token) *chan)
+//allocated in the calling thread's arena
+static scanner *ScannerNew(cstring *src, channel(Token) *chan)
 {
 	assert(src);
-	assert(chan);
 
-	//allocated in the parent arena. this avoids sending the src and chan
-	//as a payload into the new thread, which means having to block the
-	//parent thread until the data is copied. The scanner makes no other
-	//dynamic allocations so this also mitigates the overhead of creating
-	//a new arena.
 	scanner *scn = allocate(sizeof(scanner));
 
 	*scn = (scanner) {
@@ -74,20 +85,26 @@ bool ScannerInit(cstring *src, channel(Token) *chan)
 		.curr = NULL,
 		.src = src,
 		.line = 1,
-		.tok = {
-			.lexeme = {
-				.view = NULL,
-				.len = 0
-			},
-			.type = _INVALID,
-			.line = 0,
-			.flags = {
-				.valid = 0,
-				.bad_string = 0
-			}
-		},
+		.tok = INVALID_TOKEN,
+		.pending = 0,
+		.taken = 0
 	};
 
+	return scn;
+}
+
+bool ScannerInit(cstring *src, channel(Token) *chan)
+{
+	assert(src);
+	assert(chan);
+
+	//allocated in the parent arena. this avoids sending the src and chan
+	//as a payload into the new thread, which means having to block the
+	//parent thread until the data is copied. The scanner makes no other
+	//dynamic allocations so this also mitigates the overhead of creating
+	//a new arena.
+	scanner *scn = ScannerNew(src, chan);
+
 	pthread_attr_t attr;
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
@@ -198,10 +215,10 @@ static void TokenPrint(scanner *self)
 
 	const size_t line = self->tok.line;
 	const cstring *name = GetTokenName(self->tok.type);
-	const size_t len = self->tok.lexeme.len;
-	const cstring *view = self->tok.lexeme.view;
-	const int valid = self->tok.flags.valid;
-	const int badstr = self->tok.flags.bad_string;
+	const size_t len = self->tok.len;
+	const cstring *view = TokenLexeme(self->src, self->tok);
+	const int valid = self->tok.flags & TOKEN_VALID ? 1 : 0;
+	const int badstr = self->tok.flags & TOKEN_BAD_STRING ? 1 : 0;
 
 	if (view) {
 		fprintf(stderr, lexfmt, line, name, len, view, valid, badstr);
@@ -210,175 +227,210 @@ static void TokenPrint(scanner *self)
 	}
 }
 
+scanner *ScannerInitInline(cstring *src)
+{
+	assert(src);
+
+	return ScannerNew(src, NULL);
+}
+
+//in inline mode each ScanNext call sends at most one token, so the batch is
+//refilled one token at a time whenever it has been drained
+void ScannerNext(scanner *self, token *tok)
+{
+	assert(self);
+	assert(!self->chan);
+	assert(tok);
+
+	if (self->taken == self->pending) {
+		self->taken = 0;
+		self->pending = 0;
+
+		while (!self->pending) {
+			if (!ScanNext(self)) {
+				SendEOF(self);
+			}
+		}
+	}
+
+	*tok = self->batch[self->taken];
+	self->taken++;
+}
+
 //------------------------------------------------------------------------------
 
 static void Scan(scanner *self)
 {
 	assert(self);
 
-	const token_flags invalid_state = {
-		.valid = 0,
-		.bad_string = 0
-	};
+	while (ScanNext(self)) {
+		continue;
+	}
+
+	SendEOF(self);
+	TokenChannelClose(self->chan);
+	return;
+}
+
+//analyse the lexeme at the current position; returns false at end of input
+static bool ScanNext(scanner *self)
+{
+	assert(self);
+
+	const uint8_t invalid_state = 0;
 
-	while (true) {
 
 /* enable switch range statements */
 _Pragma("GCC diagnostic push")
 _Pragma("GCC diagnostic ignored \"-Wpedantic\"")
 
-		switch (*self->pos) {
-		case '\0':
-			goto exit;
+	switch (*self->pos) {
+	case '\0':
+		return false;
 
-		case '\t' ... '\r':
-			__attribute__((fallthrough));
+	case '\t' ... '\r':
+		__attribute__((fallthrough));
 
-		case ' ':
-			ConsumeSpace(self);
-			break;
+	case ' ':
+		ConsumeSpace(self);
+		break;
 
-		case '#':
-			ConsumeComment(self);
-			break;
+	case '#':
+		ConsumeComment(self);
+		break;
 
-		case ';':
-			Consume(self, _SEMICOLON, 1);
-			break;
+	case ';':
+		Consume(self, _SEMICOLON, 1);
+		break;
 
-		case '[':
-			Consume(self, _LEFTBRACKET, 1);
-			break;
+	case '[':
+		Consume(self, _LEFTBRACKET, 1);
+		break;
 
-		case ']':
-			Consume(self, _RIGHTBRACKET, 1);
-			break;
+	case ']':
+		Consume(self, _RIGHTBRACKET, 1);
+		break;
 
-		case '(':
-			Consume(self, _LEFTPAREN, 1);
-			break;
+	case '(':
+		Consume(self, _LEFTPAREN, 1);
+		break;
 
-		case ')':
-			Consume(self, _RIGHTPAREN, 1);
-			break;
+	case ')':
+		Consume(self, _RIGHTPAREN, 1);
+		break;
 
-		case '{':
-			Consume(self, _LEFTBRACE, 1);
-			break;
+	case '{':
+		Consume(self, _LEFTBRACE, 1);
+		break;
 
-		case '}':
-			Consume(self, _RIGHTBRACE, 1);
-			break;
+	case '}':
+		Consume(self, _RIGHTBRACE, 1);
+		break;
 
-		case '.':
-			Consume(self, _DOT, 1);
-			break;
+	case '.':
+		Consume(self, _DOT, 1);
+		break;
 
-		case '~':
-			Consume(self, _TILDE, 1);
-			break;
+	case '~':
+		Consume(self, _TILDE, 1);
+		break;
 
-		case ',':
-			Consume(self, _COMMA, 1);
-			break;
+	case ',':
+		Consume(self, _COMMA, 1);
+		break;
 
-		case ':':
-			Consume(self, _COLON, 1);
-			break;
+	case ':':
+		Consume(self, _COLON, 1);
+		break;
 
-		case '*':
-			Consume(self, _STAR, 1);
-			break;
+	case '*':
+		Consume(self, _STAR, 1);
+		break;
 
-		case '\'':
-			Consume(self, _BITNOT, 1);
-			break;
+	case '\'':
+		Consume(self, _BITNOT, 1);
+		break;
 
-		case '^':
-			Consume(self, _BITXOR, 1);
-			break;
+	case '^':
+		Consume(self, _BITXOR, 1);
+		break;
 
-		case '+':
-			Consume(self, _ADD, 1);
-			break;
+	case '+':
+		Consume(self, _ADD, 1);
+		break;
 
-		case '-':
-			Consume(self, _MINUS, 1);
-			break;
+	case '-':
+		Consume(self, _MINUS, 1);
+		break;
 
-		case '/':
-			Consume(self, _DIV, 1);
-			break;
+	case '/':
+		Consume(self, _DIV, 1);
+		break;
 
-		case '%':
-			Consume(self, _MOD, 1);
-			break;
+	case '%':
+		Consume(self, _MOD, 1);
+		break;
 
-		case '=':
-			ConsumeIfPeek(self, '=', _EQUALEQUAL, _EQUAL);
-			break;
+	case '=':
+		ConsumeIfPeek(self, '=', _EQUALEQUAL, _EQUAL);
+		break;
 
-		case '!':
-			ConsumeIfPeek(self, '=', _NOTEQUAL, _NOT);
-			break;
+	case '!':
+		ConsumeIfPeek(self, '=', _NOTEQUAL, _NOT);
+		break;
 
-		case '&':
-			ConsumeIfPeek(self, '&', _AND, _AMPERSAND);
-			break;
+	case '&':
+		ConsumeIfPeek(self, '&', _AND, _AMPERSAND);
+		break;
 
-		case '|':
-			ConsumeIfPeek(self, '|', _OR, _BITOR);
-			break;
+	case '|':
+		ConsumeIfPeek(self, '|', _OR, _BITOR);
+		break;
 
-		case '<':
-			if (Peek(self) == '<') {
-				Consume(self, _LSHIFT, 2);
-			} else {
-				ConsumeIfPeek(self, '=', _LEQ, _LESS);
-			}
+	case '<':
+		if (Peek(self) == '<') {
+			Consume(self, _LSHIFT, 2);
+		} else {
+			ConsumeIfPeek(self, '=', _LEQ, _LESS);
+		}
 
-			break;
+		break;
 
-		case '>':
-			if (Peek(self) == '>') {
-				Consume(self, _RSHIFT, 2);
-			} else {
-				ConsumeIfPeek(self, '=', _GEQ, _GREATER);
-			}
+	case '>':
+		if (Peek(self) == '>') {
+			Consume(self, _RSHIFT, 2);
+		} else {
+			ConsumeIfPeek(self, '=', _GEQ, _GREATER);
+		}
 
-			break;
+		break;
 
-		case '0' ... '9':
-			ConsumeNumber(self);
-			break;
+	case '0' ... '9':
+		ConsumeNumber(self);
+		break;
 
-		case '"':
-			ConsumeString(self);
-			break;
+	case '"':
+		ConsumeString(self);
+		break;
 
-		case 'A' ... 'Z':
-			__attribute__((fallthrough));
+	case 'A' ... 'Z':
+		__attribute__((fallthrough));
 
-		case 'a' ... 'z':
-			__attribute__((fallthrough));
+	case 'a' ... 'z':
+		__attribute__((fallthrough));
 
-		case '_':
-			ConsumeIdentOrKeyword(self);
-			break;
+	case '_':
+		ConsumeIdentOrKeyword(self);
+		break;
 
-		default:
-			ConsumeInvalid(self, invalid_state);
-		}
+	default:
+		ConsumeInvalid(self, invalid_state);
+	}
 
 /* disable switch range statements */
 _Pragma("GCC diagnostic pop")
 
-	}
-
-exit:
-	SendEOF(self);
-	TokenChannelClose(self->chan);
-	return;
+	return true;
 }
 
 //------------------------------------------------------------------------------
@@ -388,21 +440,41 @@ static _Noreturn void Hang(void)
 	for (;;) asm volatile ("") ;
 }
 
+//in inline mode the token is left in the batch for ScannerNext
 static void SendToken(scanner *self)
 {
 	assert(self);
-	assert(self->chan->flags & CHANNEL_OPEN);
+	assert(!self->chan || self->chan->flags & CHANNEL_OPEN);
+	assert(self->pending < TOKEN_BATCH);
 
 	if (OptionsDtokens()) {
 		TokenPrint(self);
 	}
 
-	int err = TokenChannelSend(self->chan, self->tok);
+	self->batch[self->pending] = self->tok;
+	self->pending++;
+
+	if (!self->chan) {
+		return;
+	}
+
+	if (self->pending == TOKEN_BATCH || self->tok.type == _EOF) {
+		SendBatch(self);
+	}
+}
+
+static void SendBatch(scanner *self)
+{
+	assert(self);
+
+	int err = TokenChannelSendBatch(self->chan, self->batch, self->pending);
 
 	if (err) {
 		xerror_fatal("cannot send token; cannot send EOF; hanging");
 		Hang();
 	}
+
+	self->pending = 0;
 }
 
 static void SendEOF(scanner *self)
@@ -410,15 +482,11 @@ static void SendEOF(scanner *self)
 	assert(self);
 
 	self->tok = (token) {
-		.lexeme = {
-			.view = NULL,
-			.len = 0
-		},
+		.offset = 0,
+		.len = 0,
+		.line = (uint32_t) self->line,
 		.type = _EOF,
-		.line = self->line,
-		.flags = {
-			.valid = 1,
-		}
+		.flags = TOKEN_VALID
 	};
 
 	SendToken(self);
@@ -431,18 +499,14 @@ static void ConsumeIdentOrKeyword(scanner *self)
 
 	const size_t word_length = GetIdentOrKeywordLength(self);
 
-	const kv_pair *kv = kmap_lookup(self->pos, word_length);
+	const token_type type = kmap_lookup(self->pos, word_length);
 
 	self->tok = (token) {
-		.lexeme = {
-			.view = self->pos,
-			.len = word_length
-		},
-		.type = kv ? kv->typ : _IDENTIFIER,
-		.line = self->line,
-		.flags = {
-			.valid = 1,
-		}
+		.offset = Offset(self, self->pos),
+		.len = (uint32_t) word_length,
+		.line = (uint32_t) self->line,
+		.type = (uint8_t) type,
+		.flags = TOKEN_VALID
 	};
 
 	SendToken(self);
@@ -455,15 +519,7 @@ static size_t GetIdentOrKeywordLength(scanner *self)
 {
 	assert(self);
 
-	self->curr = self->pos + 1;
-
-	while (true) {
-		if (IsLetterDigit(*self->curr)) {
-			self->curr++;
-		} else {
-			break;
-		}
-	}
+	self->curr = FindIdentEnd(self->pos + 1);
 
 	const ptrdiff_t len = self->curr - self->pos;
 
@@ -487,6 +543,214 @@ static bool IsSpaceEOF(char ch)
 	return isspace(ch) || ch == '\0';
 }
 
+//------------------------------------------------------------------------------
+//The kernels below classify a block of bytes at a time. With SSE2 each block is
+//16 bytes and a bitmask with bit i set for byte i is built with one compare per
+//character class. Blocks are loaded from 16-byte aligned addresses only; an
+//aligned block never straddles a page, so a block that holds the null sentinel
+//can be read in full even when the source is an mmap that ends on that page.
+//The first block is masked so that bytes before the start position are
+//ignored. Without SSE2 the kernels fall back to a byte-at-a-time loop.
+
+#ifdef __SSE2__
+
+#define BLOCK_WIDTH ((uintptr_t) 16)
+#define BLOCK_MASK ((unsigned int) 0xFFFF)
+
+typedef unsigned int (*classifier)(__m128i);
+
+//bytes are signed in _mm_cmplt_epi8, so shift [lo, hi] down to start at -128
+static inline __m128i InRange(const __m128i block, const char lo, const char hi)
+{
+	const __m128i shift = _mm_set1_epi8((char) (-128 - lo));
+	const __m128i limit = _mm_set1_epi8((char) (-128 + (hi - lo) + 1));
+
+	return _mm_cmplt_epi8(_mm_add_epi8(block, shift), limit);
+}
+
+static inline __m128i Equal(const __m128i block, const char ch)
+{
+	return _mm_cmpeq_epi8(block, _mm_set1_epi8(ch));
+}
+
+static inline unsigned int Mask(const __m128i block)
+{
+	return (unsigned int) _mm_movemask_epi8(block);
+}
+
+//set bits mark bytes outside [A-Za-z0-9_], including the null sentinel
+static inline unsigned int StopIdent(const __m128i block)
+{
+	const __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+	const __m128i alpha = InRange(lower, 'a', 'z');
+	const __m128i digit = InRange(block, '0', '9');
+	const __m128i under = Equal(block, '_');
+	const __m128i ident = _mm_or_si128(_mm_or_si128(alpha, digit), under);
+
+	return ~Mask(ident) & BLOCK_MASK;
+}
+
+static inline unsigned int StopQuote(const __m128i block)
+{
+	return Mask(_mm_or_si128(Equal(block, '"'), Equal(block, '\0')));
+}
+
+static inline unsigned int StopNewline(const __m128i block)
+{
+	return Mask(_mm_or_si128(Equal(block, '\n'), Equal(block, '\0')));
+}
+
+//set bits mark bytes outside [\t-\r ], including the null sentinel
+static inline unsigned int StopSpace(const __m128i block)
+{
+	const __m128i space = _mm_or_si128(InRange(block, '\t', '\r'),
+					   Equal(block, ' '));
+
+	return ~Mask(space) & BLOCK_MASK;
+}
+
+static inline char *AlignDown(char *pos, unsigned int *offset)
+{
+	const uintptr_t address = (uintptr_t) pos;
+	const uintptr_t misalignment = address & (BLOCK_WIDTH - 1);
+
+	*offset = (unsigned int) misalignment;
+
+	return pos - misalignment;
+}
+
+static inline __m128i Load(const char *block)
+{
+	return _mm_load_si128((const __m128i *) block);
+}
+
+//returns the first byte at or after pos for which stop sets a bit
+__attribute__((always_inline))
+static inline char *FindFirst(char *pos, const classifier stop)
+{
+	assert(pos);
+
+	unsigned int offset = 0;
+	char *block = AlignDown(pos, &offset);
+	unsigned int mask = stop(Load(block)) & (BLOCK_MASK << offset);
+
+	while (!mask) {
+		block += BLOCK_WIDTH;
+		mask = stop(Load(block));
+	}
+
+	return block + __builtin_ctz(mask);
+}
+
+//returns the first non-space byte at or after pos and adds the number of line
+//feeds skipped over to the newlines counter
+static char *SkipSpace(char *pos, size_t *newlines)
+{
+	assert(pos);
+	assert(newlines);
+
+	//most runs are a single space or tab between two lexemes
+	if (!isspace(pos[1])) {
+		*newlines += (*pos == '\n');
+		return pos + 1;
+	}
+
+	unsigned int offset = 0;
+	char *block = AlignDown(pos, &offset);
+	unsigned int from = BLOCK_MASK << offset;
+
+	while (true) {
+		const __m128i data = Load(block);
+		const unsigned int mask = StopSpace(data) & from;
+		const unsigned int feeds = Mask(Equal(data, '\n')) & from;
+
+		if (mask) {
+			const unsigned int before = mask & -mask;
+			const int total = __builtin_popcount(feeds & (before - 1));
+			*newlines += (size_t) total;
+			return block + __builtin_ctz(mask);
+		}
+
+		*newlines += (size_t) __builtin_popcount(feeds);
+		block += BLOCK_WIDTH;
+		from = BLOCK_MASK;
+	}
+}
+
+//short identifiers are common enough that a scalar probe of the first byte
+//pays for itself
+static char *FindIdentEnd(char *pos)
+{
+	if (!IsLetterDigit(*pos)) {
+		return pos;
+	}
+
+	return FindFirst(pos + 1, StopIdent);
+}
+
+static char *FindQuoteOrNull(char *pos)
+{
+	return FindFirst(pos, StopQuote);
+}
+
+static char *FindNewlineOrNull(char *pos)
+{
+	return FindFirst(pos, StopNewline);
+}
+
+#else
+
+static char *SkipSpace(char *pos, size_t *newlines)
+{
+	assert(pos);
+	assert(newlines);
+
+	while (isspace(*pos)) {
+		if (*pos == '\n') {
+			(*newlines)++;
+		}
+
+		pos++;
+	}
+
+	return pos;
+}
+
+static char *FindIdentEnd(char *pos)
+{
+	assert(pos);
+
+	while (IsLetterDigit(*pos)) {
+		pos++;
+	}
+
+	return pos;
+}
+
+static char *FindQuoteOrNull(char *pos)
+{
+	assert(pos);
+
+	while (*pos != '"' && *pos != '\0') {
+		pos++;
+	}
+
+	return pos;
+}
+
+static char *FindNewlineOrNull(char *pos)
+{
+	assert(pos);
+
+	while (*pos != '\n' && *pos != '\0') {
+		pos++;
+	}
+
+	return pos;
+}
+
+#endif
+
 static void Consume(scanner *self, token_type type, size_t n)
 {
 	assert(self);
@@ -494,22 +758,18 @@ static void Consume(scanner *self, token_type type, size_t n)
 	assert(type < _TOKEN_TYPE_COUNT);
 
 	self->tok = (token) {
-		.lexeme = {
-			.view = self->pos,
-			.len = n
-		},
-		.type = type,
-		.line = self->line,
-		.flags = {
-			.valid = 1,
-		}
+		.offset = Offset(self, self->pos),
+		.len = (uint32_t) n,
+		.line = (uint32_t) self->line,
+		.type = (uint8_t) type,
+		.flags = TOKEN_VALID
 	};
 
 	SendToken(self);
 	self->pos += n;
 }
 
-static void ConsumeInvalid(scanner *self, token_flags flags)
+static void ConsumeInvalid(scanner *self, uint8_t flags)
 {
 	assert(self);
 
@@ -522,27 +782,26 @@ static void ConsumeInvalid(scanner *self, token_flags flags)
 	size_t total_invalid_chars = Synchronize(self);
 
 	self->tok = (token) {
-		.lexeme = {
-			.view = start,
-			.len = total_invalid_chars
-		},
+		.offset = Offset(self, start),
+		.len = (uint32_t) total_invalid_chars,
+		.line = (uint32_t) self->line,
 		.type = _INVALID,
-		.line = self->line,
 		.flags = flags
 	};
 
 	SendToken(self);
 }
 
+//consumes the entire run of whitespace at the current position
 static void ConsumeSpace(scanner *self)
 {
 	assert(self);
+	assert(isspace(*self->pos));
 
-	if (*self->pos == '\n') {
-		self->line++;
-	}
+	size_t newlines = 0;
 
-	self->pos++;
+	self->pos = SkipSpace(self->pos, &newlines);
+	self->line += newlines;
 }
 
 static void ConsumeIfPeek(scanner *self, char next, token_type a, token_type b)
@@ -568,11 +827,7 @@ static void ConsumeComment(scanner *self)
 	assert(self);
 	assert(*self->pos == '#');
 
-	char next = '\0';
-
-	do {
-		next = *(++self->pos);
-	} while (next != '\0' && next != '\n');
+	self->pos = FindNewlineOrNull(self->pos + 1);
 }
 
 //This function is a weak consumer and will stop early at the first
@@ -606,15 +861,11 @@ static void ConsumeNumber(scanner *self)
 	delta = self->curr - self->pos;
 
 	self->tok = (token) {
-		.lexeme = {
-			.view = self->pos,
-			.len = (size_t) delta
-		},
-		.type = guess,
-		.line = self->line,
-		.flags = {
-			.valid = 1,
-		}
+		.offset = Offset(self, self->pos),
+		.len = (uint32_t) delta,
+		.line = (uint32_t) self->line,
+		.type = (uint8_t) guess,
+		.flags = TOKEN_VALID
 	};
 
 	SendToken(self);
@@ -639,43 +890,29 @@ static size_t Synchronize(scanner *self)
 
 //if the string is ill-formed an invalid token with the bad_string flag is sent.
 //otherwise, a _LITERALSTR token is sent, but if the string is an empty string
-//then the token lexeme view will be set to NULL.
+//then the token has no lexeme.
 static void ConsumeString(scanner *self)
 {
 	assert(self);
 	assert(*self->pos == '"');
 
-	self->curr = self->pos + 1;
-
-	while (*self->curr != '"') {
-		if (*self->curr == '\0') {
-			const token_flags flags = {
-				.valid = 0,
-				.bad_string = 1
-			};
+	self->curr = FindQuoteOrNull(self->pos + 1);
 
-			ConsumeInvalid(self, flags);
-			self->pos = self->curr;
-			return;
-		}
-
-		self->curr++;
+	if (*self->curr == '\0') {
+		ConsumeInvalid(self, TOKEN_BAD_STRING);
+		self->pos = self->curr;
+		return;
 	}
 
 	//-1 to remove terminating quotation mark
 	size_t delta = (size_t) ((self->curr - self->pos) - 1);
 
 	self->tok = (token) {
-		.lexeme = {
-			.view = delta ? self->pos + 1 : NULL,
-			.len = delta
-		},
+		.offset = delta ? Offset(self, self->pos + 1) : 0,
+		.len = (uint32_t) delta,
+		.line = (uint32_t) self->line,
 		.type = _LITERALSTR,
-		.line = self->line,
-		.flags = {
-			.valid = 1,
-			.bad_string = 0
-		}
+		.flags = TOKEN_VALID
 	};
 
 	SendToken(self);
@@ -689,3 +926,15 @@ static char Peek(scanner *self)
 
 	return *(self->pos + 1);
 }
+
+//returns the offset of a lexeme which begins at view
+static uint32_t Offset(scanner *self, const char *view)
+{
+	assert(self);
+	assert(view >= self->src);
+
+	const size_t offset = (size_t) (view - self->src);
+	assert(offset <= TOKEN_MAXIMUM_SOURCE);
+
+	return (uint32_t) offset;
+}
@@ -3,7 +3,10 @@
 
 #pragma once
 
-#include "channel.h"
+#include <assert.h>
+#include <stdint.h>
+
+#include "spsc.h"
 #include "str.h"
 
 typedef enum token_type {
@@ -88,28 +91,49 @@ typedef enum token_type {
 	_TOKEN_TYPE_COUNT
 } token_type;
 
-typedef struct token_flags {
-	unsigned int valid : 1;
-	unsigned int bad_string : 1; //valid when type == _LITERALSTR
-} token_flags;
+//token flags
+#define TOKEN_VALID ((uint8_t) 1 << 0)
+#define TOKEN_BAD_STRING ((uint8_t) 1 << 1) //valid when type == _LITERALSTR
 
+//Tokens are 16 bytes so that four share a cache line. The lexeme is not stored
+//as a pointer; it is found at offset bytes from the start of the in-memory
+//source code, which is therefore limited to TOKEN_MAXIMUM_SOURCE bytes.
 typedef struct token {
-	struct {
-		char *view; //pointer into in-memory source code, or null
-		size_t len; //may be zero
-	} lexeme;
-	token_type type;
-	size_t line; //starts at 1
-	token_flags flags;
+	uint32_t offset; //lexeme position in the source; zero if len is zero
+	uint32_t len; //zero if and only if the token has no lexeme
+	uint32_t line; //starts at 1
+	uint8_t type; //token_type
+	uint8_t flags;
 } token;
 
-#define INVALID_TOKEN (token) {{NULL, 0}, _INVALID, 0, {0, 0}}
+static_assert(sizeof(token) == 16, "token is not packed");
+static_assert(_TOKEN_TYPE_COUNT <= UINT8_MAX, "token type does not fit");
+
+#define TOKEN_MAXIMUM_SOURCE ((size_t) UINT32_MAX)
+
+#define INVALID_TOKEN (token) {0, 0, 0, _INVALID, 0}
+
+//returns a pointer to the token lexeme within src, the source code from which
+//the token was scanned, or NULL if the token has no lexeme
+static inline const char *TokenLexeme(const cstring *src, const token tok)
+{
+	assert(src);
+
+	return tok.len ? src + tok.offset : NULL;
+}
 
 //------------------------------------------------------------------------------
 //Tokens are sent on the channel in the order that they are found. On completion
-//a final _EOF token is sent and the channel is closed.
+//a final _EOF token is sent and the channel is closed. The scanner thread is
+//the only producer and the parser is the only consumer, so the channel is the
+//lock-free single-producer single-consumer variant.
+//
+//Tokens are published and received in groups of up to TOKEN_BATCH so that the
+//cost of synchronisation is amortised over many tokens.
 
-make_channel(token, Token, static)
+make_spsc_channel(token, Token, static)
+
+#define TOKEN_BATCH ((size_t) 128)
 
 //------------------------------------------------------------------------------
 //Execute lexical analysis in a new detached thread. The input channel must be
@@ -118,3 +142,14 @@ make_channel(token, Token, static)
 //is returned.
 
 bool ScannerInit(cstring *src, Token_channel *chan);
+
+//------------------------------------------------------------------------------
+//Pull-based lexical analysis on the calling thread. No thread or channel is
+//created; each call to ScannerNext scans just far enough to place the next
+//token in tok. Once the source is exhausted every call returns an _EOF token.
+//This mode suits small files, where creating a thread costs more than the scan.
+
+typedef struct scanner scanner;
+
+scanner *ScannerInitInline(cstring *src);
+void ScannerNext(scanner *self, token *tok);
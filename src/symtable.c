@@ -2,27 +2,34 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "arena.h"
+#include "intern.h"
 #include "json.h"
 #include "str.h"
 #include "symtable.h"
 
-static void SerializeSymTable(json_array *, symtable *);
-static json_value ParseTable(symtable *);
-static json_value ParseTableTag(const tabletag);
-static json_value ParseEntries(map(Symbol));
-static json_value ParseSymbol(const symbol);
-static json_value ParseNative(const symbol);
-static json_value ParseModule(const symbol);
-static json_value ParseImport(const symbol);
-static json_value ParseFunction(const symbol);
-static json_value ParseMethod(const symbol);
-static json_value ParseUDT(const symbol);
-static json_value ParseVariable(const symbol);
-static json_value ParseField(const symbol); 
-static json_value ParseParameter(const symbol);
-static json_value ParseLabel(const symbol);
+static void WriteTable(json_writer *, symtable *);
+static void WriteEntries(json_writer *, map(Symbol) *);
+static size_t GatherKeys(const map(Symbol) *, const cstring *,
+			 const cstring **);
+static void WriteSymbol(json_writer *, const symbol *);
+static void WriteTag(json_writer *, const symboltag);
+static void WriteFlag(json_writer *, const cstring *, bool);
+static void WriteNumber(json_writer *, const cstring *, size_t);
+static void WriteString(json_writer *, const cstring *, const cstring *);
+static void WriteType(json_writer *, const cstring *, const typeid);
+static void WriteNative(json_writer *, const symbol *);
+static void WriteModule(json_writer *, const symbol *);
+static void WriteImport(json_writer *, const symbol *);
+static void WriteFunction(json_writer *, const symbol *);
+static void WriteMethod(json_writer *, const symbol *);
+static void WriteUDT(json_writer *, const symbol *);
+static void WriteVariable(json_writer *, const symbol *);
+static void WriteField(json_writer *, const symbol *);
+static void WriteParameter(json_writer *, const symbol *);
+static void WriteLabel(json_writer *, const symbol *);
 
 //------------------------------------------------------------------------------
 
@@ -75,7 +82,8 @@ symtable *SymTableInit(const size_t total_modules)
 
 	for (size_t i = 0; i < total_native; i++) {
 		const pair *p = table + i;
-		symbol *entry = SymTableInsert(global, p->key, p->value);
+		const cstring *key = InternString(p->key);
+		symbol *entry = SymTableInsert(global, key, p->value);
 		assert(entry && "duplicate entry");
 	}
 
@@ -103,32 +111,41 @@ symbol *SymTableInsert(symtable *table, const cstring *key, symbol value)
 {
 	assert(table);
 	assert(key);
-	
-	return SymbolMapInsert(&table->entries, key, value);
+
+	const uint64_t cap = table->entries.cap;
+	symbol *entry = SymbolMapInsert(&table->entries, key, value);
+
+	//a resize would invalidate the symbol pointers already held by the AST,
+	//so the capacity given to SymTableSpawn must never be exceeded
+	assert(table->entries.cap == cap && "symbol table resized");
+
+	return entry;
 }
 
+//the precomputed hash of the interned key is reused in every ancestor table
 symbol *SymTableLookup(symtable *table, const cstring *key, symtable **target)
 {
 	assert(table);
 	assert(key);
 
+	const uint64_t hash = InternHash(key);
 	symbol *entry = NULL;
 
-	//base case
-	if (SymbolMapGetRef(&table->entries, key, &entry)) {
-		if (target) {
-			*target = table;
-		}
+	while (table) {
+		map(Symbol) *entries = &table->entries;
 
-		return entry;
-	}
+		if (SymbolMapGetRefHashed(entries, key, hash, &entry)) {
+			if (target) {
+				*target = table;
+			}
 
-        //recursive case
-	if (table->parent) {
-		return SymTableLookup(table->parent, key, target);
+			return entry;
+		}
+
+		table = table->parent;
 	}
 
-	//else table is global and therefore the symbol cannot exist
+	//the global table has been searched so the symbol cannot exist
 	return NULL;
 }
 
@@ -172,468 +189,259 @@ const cstring *SymTableLookupName(const tabletag tag)
 }
 
 //------------------------------------------------------------------------------
-//convert a symbol table parent pointer tree to a JSON parse tree via the
-//standard recursive descent algorithm
+//stream a symbol table parent pointer tree as JSON via the standard recursive
+//descent algorithm; nothing is allocated, so memory use is independent of the
+//size of the tree. The members of a symbol are written in a fixed order for its
+//type and the entries of a table are sorted by name in strcmp order.
+
+//the most keys gathered by one pass of GatherKeys
+#define ENTRY_BATCH ((size_t) 64)
 
-cstring *SymTableToJSON(symtable *root)
+bool SymTableToJSON(symtable *root, FILE *stream)
 {
 	assert(root);
+	assert(stream);
 
-	json_value value = ParseTable(root);
+	json_writer writer = {0};
+	JsonWriterInit(&writer, stream);
 
-	assert(value.tag == JSON_VALUE_OBJECT);
+	WriteTable(&writer, root);
 
-	return JsonSerializeObject(value.object);
+	return JsonWriterFinish(&writer);
 }
 
-//returns a json object representation of the input table and its children
-static json_value ParseTable(symtable *root)
+static void WriteTable(json_writer *writer, symtable *root)
 {
+	assert(writer);
 	assert(root);
 
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
+	JsonWriterObjectBegin(writer);
 
-	JsonObjectAdd(value.object, "table type", ParseTableTag(root->tag));
-	JsonObjectAdd(value.object, "entries", ParseEntries(root->entries));
+	JsonWriterKey(writer, "table type");
+	JsonWriterString(writer, SymTableLookupName(root->tag));
 
-	return value;
-}
+	JsonWriterKey(writer, "entries");
+	WriteEntries(writer, &root->entries);
 
-//returns a json string representation of the symbol table type; note lookup
-//is duplicated to avoid -Wcast-qual error
-static json_value ParseTableTag(const tabletag tag)
-{
-	const cstring *tagname = SymTableLookupName(tag);
-
-	return (json_value) {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(tagname)
-	};
+	JsonWriterObjectEnd(writer);
 }
 
-//returns a json object representation of the input hash table
-static json_value ParseEntries(map(Symbol) entries)
+//a table of n entries is scanned n / ENTRY_BATCH + 1 times; sorting all of its
+//keys at once would need memory in proportion to the table on every level of
+//the recursion
+static void WriteEntries(json_writer *writer, map(Symbol) *entries)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	for (size_t i = 0; i < entries.cap; i++) {
-		if (entries.buffer[i].status != SLOT_CLOSED) {
-			continue;
-		}
+	assert(writer);
+	assert(entries);
 
-		const cstring *symname = entries.buffer[i].key;
-		const symbol sym = entries.buffer[i].value;
+	const cstring *batch[ENTRY_BATCH];
+	const cstring *last = NULL;
+	size_t len = 0;
 
-		JsonObjectAdd(value.object, symname, ParseSymbol(sym));
-	}
+	JsonWriterObjectBegin(writer);
 
-	return value;
-}
+	do {
+		len = GatherKeys(entries, last, batch);
 
-static json_value ParseSymbol(const symbol sym)
-{
-	assert(sym.tag >= SYMBOL_NATIVE);
-	assert(sym.tag <= SYMBOL_LABEL);
-
-	json_value (*const jump[]) (const symbol) = {
-		[SYMBOL_NATIVE] = ParseNative,
-		[SYMBOL_MODULE] = ParseModule,
-		[SYMBOL_IMPORT] = ParseImport,
-		[SYMBOL_FUNCTION] = ParseFunction,
-		[SYMBOL_METHOD] = ParseMethod,
-		[SYMBOL_UDT] = ParseUDT,
-		[SYMBOL_VARIABLE] = ParseVariable,
-		[SYMBOL_FIELD] = ParseField,
-		[SYMBOL_PARAMETER] = ParseParameter,
-		[SYMBOL_LABEL] = ParseLabel
-	};
+		for (size_t i = 0; i < len; i++) {
+			symbol *sym = NULL;
+			bool found = SymbolMapGetRef(entries, batch[i], &sym);
+			assert(found);
+			(void) found;
 
-	return jump[sym.tag](sym);
-}
-
-static json_value ParseNative(const symbol sym)
-{
-	assert(sym.native.bytes < 256 && "native type is unusually large");
-
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
-
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	json_value byteinfo = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.native.bytes
-	};
+			JsonWriterKey(writer, batch[i]);
+			WriteSymbol(writer, sym);
+		}
 
-	JsonObjectAdd(value.object, "bytes", byteinfo);
+		last = len ? batch[len - 1] : last;
+	} while (len == ENTRY_BATCH);
 
-	return value;
+	JsonWriterObjectEnd(writer);
 }
 
-static json_value ParseModule(const symbol sym)
+//places in batch, in ascending order, the smallest ENTRY_BATCH keys that sort
+//after last, or after nothing if last is NULL; returns the number placed
+static size_t GatherKeys(const map(Symbol) *entries, const cstring *last,
+			 const cstring **batch)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
+	assert(entries);
+	assert(batch);
 
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
+	uint64_t cursor = 0;
+	const cstring *key = NULL;
+	size_t len = 0;
 
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
+	while (SymbolMapNext(entries, &cursor, &key, NULL)) {
+		if (last && strcmp(key, last) <= 0) {
+			continue;
+		}
 
-	int flag = sym.module.referenced;
+		if (len == ENTRY_BATCH && strcmp(key, batch[len - 1]) >= 0) {
+			continue;
+		}
 
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
+		size_t i = len < ENTRY_BATCH ? len : len - 1;
 
-	JsonObjectAdd(value.object, "referenced", ref);
+		while (i > 0 && strcmp(key, batch[i - 1]) < 0) {
+			batch[i] = batch[i - 1];
+			i--;
+		}
 
-	symtable *table = sym.module.table;
-	JsonObjectAdd(value.object, "table", ParseTable(table));
+		batch[i] = key;
+		len = len < ENTRY_BATCH ? len + 1 : len;
+	}
 
-	return value;
+	return len;
 }
 
-static json_value ParseImport(const symbol sym)
+static void WriteSymbol(json_writer *writer, const symbol *sym)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
+	assert(writer);
+	assert(sym);
+	assert(sym->tag >= SYMBOL_NATIVE);
+	assert(sym->tag <= SYMBOL_LABEL);
 
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	int flag = sym.import.referenced;
-
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
+	void (*const jump[]) (json_writer *, const symbol *) = {
+		[SYMBOL_NATIVE] = WriteNative,
+		[SYMBOL_MODULE] = WriteModule,
+		[SYMBOL_IMPORT] = WriteImport,
+		[SYMBOL_FUNCTION] = WriteFunction,
+		[SYMBOL_METHOD] = WriteMethod,
+		[SYMBOL_UDT] = WriteUDT,
+		[SYMBOL_VARIABLE] = WriteVariable,
+		[SYMBOL_FIELD] = WriteField,
+		[SYMBOL_PARAMETER] = WriteParameter,
+		[SYMBOL_LABEL] = WriteLabel
 	};
 
-	JsonObjectAdd(value.object, "referenced", ref);
+	JsonWriterObjectBegin(writer);
 
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.import.line
-	};
+	jump[sym->tag](writer, sym);
 
-	JsonObjectAdd(value.object, "line", line);
+	JsonWriterObjectEnd(writer);
+}
 
-	symtable *table = sym.import.table;
-	JsonObjectAdd(value.object, "table", ParseTable(table));
+//the remaining writers emit the members of an already open object
 
-	return value;
+static void WriteTag(json_writer *writer, const symboltag tag)
+{
+	JsonWriterKey(writer, "symbol type");
+	JsonWriterString(writer, SymbolLookupName(tag));
 }
 
-static json_value ParseFunction(const symbol sym)
+static void WriteFlag(json_writer *writer, const cstring *key, bool flag)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
-
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	int flag = sym.function.referenced;
-
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "referenced", ref);
-
-	json_value signature = {
-		.tag = JSON_VALUE_STRING,
-		.string = sym.function.signature
-	};
-
-	JsonObjectAdd(value.object, "signature", signature);
-
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.function.line
-	};
-
-	JsonObjectAdd(value.object, "line", line);
-
-	//symtable *table = sym.function.table;
-	//JsonObjectAdd(value.object, "table", ParseTable(table));
-
-	return value;
+	JsonWriterKey(writer, key);
+	JsonWriterBoolean(writer, flag);
 }
 
-static json_value ParseMethod(const symbol sym)
+static void WriteNumber(json_writer *writer, const cstring *key, size_t n)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
-
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	int flag = sym.method.referenced;
-
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "referenced", ref);
-
-	json_value signature = {
-		.tag = JSON_VALUE_STRING,
-		.string = sym.method.signature
-	};
-
-	JsonObjectAdd(value.object, "signature", signature);
-
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.method.line
-	};
-
-	JsonObjectAdd(value.object, "line", line);
-
-	symtable *table = sym.method.table;
-	JsonObjectAdd(value.object, "table", ParseTable(table));
-
-	return value;
+	JsonWriterKey(writer, key);
+	JsonWriterNumber(writer, (int64_t) n);
 }
 
-static json_value ParseUDT(const symbol sym)
+static void WriteString(json_writer *writer, const cstring *key,
+			const cstring *cstr)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
-
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	int flag = sym.udt.referenced;
-
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "referenced", ref);
-
-	int pub_flag = sym.udt.public;
-
-	json_value pub = {
-		.tag = pub_flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "public", pub);
-
-	json_value bytes = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.udt.bytes
-	};
-
-	JsonObjectAdd(value.object, "bytes", bytes);
-
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.udt.line
-	};
-
-	JsonObjectAdd(value.object, "line", line);
-
-	symtable *table = sym.udt.table;
-	JsonObjectAdd(value.object, "table", ParseTable(table));
-
-	return value;
+	JsonWriterKey(writer, key);
+	JsonWriterString(writer, cstr);
 }
 
-static json_value ParseVariable(const symbol sym)
+static void WriteType(json_writer *writer, const cstring *key, const typeid id)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
-
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	int flag = sym.variable.referenced;
-
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "referenced", ref);
-
-	int pub_flag = sym.variable.public;
-
-	json_value pub = {
-		.tag = pub_flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "public", pub);
-
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.variable.line
-	};
-
-	JsonObjectAdd(value.object, "line", line);
-
-	json_value type = {
-		.tag = JSON_VALUE_STRING,
-		.string = sym.variable.type
-	};
-
-	JsonObjectAdd(value.object, "type", type);
-
-	return value;
+	WriteString(writer, key, TypeTableToString(id));
 }
 
-static json_value ParseField(const symbol sym)
+static void WriteNative(json_writer *writer, const symbol *sym)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
-
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
+	assert(sym->native.bytes < 256 && "native type is unusually large");
 
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	int flag = sym.field.referenced;
-
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "referenced", ref);
-
-	int pub_flag = sym.field.public;
-
-	json_value pub = {
-		.tag = pub_flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "public", pub);
-
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.field.line
-	};
-
-	JsonObjectAdd(value.object, "line", line);
-
-	json_value type = {
-		.tag = JSON_VALUE_STRING,
-		.string = sym.field.type
-	};
-
-	JsonObjectAdd(value.object, "type", type);
-
-	return value;
+	WriteTag(writer, sym->tag);
+	WriteNumber(writer, "bytes", sym->native.bytes);
 }
 
-static json_value ParseParameter(const symbol sym)
+static void WriteModule(json_writer *writer, const symbol *sym)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->module.referenced);
 
-	json_value typeinfo = {
-		.tag = JSON_VALUE_STRING,
-		.string = cStringDuplicate(SymbolLookupName(sym.tag))
-	};
-
-	JsonObjectAdd(value.object, "symbol type", typeinfo);
-
-	int flag = sym.parameter.referenced;
-
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
-
-	JsonObjectAdd(value.object, "referenced", ref);
+	JsonWriterKey(writer, "table");
+	WriteTable(writer, sym->module.table);
+}
 
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.parameter.line
-	};
+static void WriteImport(json_writer *writer, const symbol *sym)
+{
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->import.referenced);
+	WriteNumber(writer, "line", sym->import.line);
 
-	JsonObjectAdd(value.object, "line", line);
+	JsonWriterKey(writer, "table");
+	WriteTable(writer, sym->import.table);
+}
 
-	json_value type = {
-		.tag = JSON_VALUE_STRING,
-		.string = sym.parameter.type
-	};
+static void WriteFunction(json_writer *writer, const symbol *sym)
+{
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->function.referenced);
+	WriteType(writer, "signature", sym->function.signature);
+	WriteNumber(writer, "line", sym->function.line);
 
-	JsonObjectAdd(value.object, "type", type);
-	
-	return value;
+	//JsonWriterKey(writer, "table");
+	//WriteTable(writer, sym->function.table);
 }
 
-static json_value ParseLabel(const symbol sym)
+static void WriteMethod(json_writer *writer, const symbol *sym)
 {
-	json_value value = {
-		.tag = JSON_VALUE_OBJECT,
-		.object = JsonObjectInit()
-	};
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->method.referenced);
+	WriteType(writer, "signature", sym->method.signature);
+	WriteNumber(writer, "line", sym->method.line);
 
-	int flag = sym.label.referenced;
+	JsonWriterKey(writer, "table");
+	WriteTable(writer, sym->method.table);
+}
 
-	json_value ref = {
-		.tag = flag ? JSON_VALUE_TRUE : JSON_VALUE_FALSE
-	};
+static void WriteUDT(json_writer *writer, const symbol *sym)
+{
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->udt.referenced);
+	WriteFlag(writer, "public", sym->udt.public);
+	WriteNumber(writer, "bytes", sym->udt.bytes);
+	WriteNumber(writer, "line", sym->udt.line);
+
+	JsonWriterKey(writer, "table");
+	WriteTable(writer, sym->udt.table);
+}
 
-	JsonObjectAdd(value.object, "referenced", ref);
+static void WriteVariable(json_writer *writer, const symbol *sym)
+{
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->variable.referenced);
+	WriteFlag(writer, "public", sym->variable.public);
+	WriteNumber(writer, "line", sym->variable.line);
+	WriteType(writer, "type", sym->variable.type);
+}
 
-	json_value line = {
-		.tag = JSON_VALUE_NUMBER,
-		.number = (int64_t) sym.label.line
-	};
+static void WriteField(json_writer *writer, const symbol *sym)
+{
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->field.referenced);
+	WriteFlag(writer, "public", sym->field.public);
+	WriteNumber(writer, "line", sym->field.line);
+	WriteType(writer, "type", sym->field.type);
+}
 
-	JsonObjectAdd(value.object, "line", line);
+static void WriteParameter(json_writer *writer, const symbol *sym)
+{
+	WriteTag(writer, sym->tag);
+	WriteFlag(writer, "referenced", sym->parameter.referenced);
+	WriteNumber(writer, "line", sym->parameter.line);
+	WriteType(writer, "type", sym->parameter.type);
+}
 
-	return value;
+static void WriteLabel(json_writer *writer, const symbol *sym)
+{
+	WriteFlag(writer, "referenced", sym->label.referenced);
+	WriteNumber(writer, "line", sym->label.line);
 }
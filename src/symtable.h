@@ -4,9 +4,11 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 
-#include "map.h"
+#include "flatmap.h"
 #include "str.h"
+#include "typetable.h"
 
 typedef struct symbol symbol;
 typedef struct symtable symtable;
@@ -14,10 +16,11 @@ typedef struct symtable symtable;
 //------------------------------------------------------------------------------
 // Symbols are associated with a cstring identifier and placed into a hash table
 //
-// the data type is compressed from the parser linked list into a compact string
-// representation. For example, [10]*int32 has a parser list representation as
-// [10] --> * --> int32, while in the symbol table it is just "[10]*int32".
-// This essentially converts the type back into the original source literal.
+// the data type is compressed from the parser linked list into its ID in the
+// type table. For example, [10]*int32 has a parser list representation as
+// [10] --> * --> int32, while in the symbol table it is one integer, so two
+// symbols have the same type if and only if their IDs are equal. The string
+// "[10]*int32" is only generated for --Dsym; see TypeTableToString.
 
 typedef enum symboltag {
 	SYMBOL_NATIVE,
@@ -39,11 +42,10 @@ struct symbol {
 			size_t bytes;
 		} native;
 
+		//@referenced: set by every importer, possibly in parallel
 		struct {
 			symtable *table;
-			struct {
-				unsigned int referenced: 1;
-			};
+			bool referenced;
 		} module;
 
 		struct {
@@ -54,12 +56,10 @@ struct symbol {
 			};
 		} import;
 
-		//signature translates func (int32, bool) -> float64 to the
-		//string "int32,bool,float64", void parameter list results in
-		//":float64" and void return results in "int32,bool:"
+		//see TypeTableToString for the string form of a signature
 		struct {
 			symtable *table;
-			cstring *signature;
+			typeid signature;
 			size_t line;
 			struct {
 				unsigned int referenced: 1;
@@ -68,7 +68,7 @@ struct symbol {
 
 		struct {
 			symtable *table;
-			cstring *signature;
+			typeid signature;
 			size_t line;
 			struct {
 				unsigned int referenced: 1;
@@ -76,18 +76,20 @@ struct symbol {
 		} method;
 
 		//@bytes not calculated during symbol resolution
+		//@referenced: not a bit-field since importers of the module which
+		//declares the UDT may set it in parallel
 		struct {
 			symtable *table;
 			size_t bytes;
 			size_t line;
+			bool referenced;
 			struct {
-				unsigned int referenced: 1;
 				unsigned int public: 1;
 			};
 		} udt;
 
 		struct {
-			cstring *type;
+			typeid type;
 			size_t line;
 			struct {
 				unsigned int referenced: 1;
@@ -96,7 +98,7 @@ struct symbol {
 		} variable;
 
 		struct {
-			cstring *type;
+			typeid type;
 			size_t line;
 			struct {
 				unsigned int referenced: 1;
@@ -105,7 +107,7 @@ struct symbol {
 		} field;
 		
 		struct {
-			cstring *type;
+			typeid type;
 			size_t line;
 			struct {
 				unsigned int referenced: 1;
@@ -121,7 +123,7 @@ struct symbol {
 	};
 };
 
-make_map(symbol, Symbol, static)
+make_table(symbol, Symbol, static)
 
 //------------------------------------------------------------------------------
 // symbol tables are lexically scoped; all symbol tables in memory together
@@ -160,12 +162,12 @@ symtable *SymTableSpawn(symtable *parent, const tabletag tag, const size_t cap);
 
 //returns NULL if the symbol already exists. On success the returned pointer
 //will remain valid for the compiler lifetime provided that the capacity 
-//contract on SymTableSpawn is upheld.
+//contract on SymTableSpawn is upheld. The key must be interned.
 symbol *SymTableInsert(symtable *table, const cstring *key, symbol value);
 
 //returns NULL if the key does not exist in the input table or its ancestors; 
 //if the target is non-null then it contains a pointer  on return to the table 
-//in which the key exists
+//in which the key exists. The key must be interned.
 symbol *SymTableLookup(symtable *table, const cstring *key, symtable **target);
 
 //convert symbol table tag to a printable name
@@ -174,5 +176,6 @@ const cstring *SymTableLookupName(const tabletag tag);
 //convert symbol tag to a printable name
 const cstring *SymbolLookupName(const symboltag tag);
 
-//print the input symbol table and its children, grandchildren, etc.
-cstring *SymTableToJSON(symtable *root);
+//write the input symbol table and its children, grandchildren, etc. to the
+//stream as JSON; returns false if the stream reports an error
+bool SymTableToJSON(symtable *root, FILE *stream);
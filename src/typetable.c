@@ -0,0 +1,536 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "intern.h"
+#include "map.h"
+#include "parser.h"
+#include "typetable.h"
+#include "vector.h"
+#include "xerror.h"
+
+typedef struct slot slot;
+typedef struct shard shard;
+
+static void InitShards(void);
+static typeid Insert(const typeinfo *);
+static typeid Search(shard *, const typeinfo *, const uint64_t);
+static typeid Store(shard *, const typeinfo *, const uint64_t);
+static void Grow(shard *);
+static typeinfo *Reserve(const typeid);
+static uint64_t Hash(const typeinfo *);
+static uint64_t Combine(const uint64_t, const uint64_t);
+static bool Match(const typeinfo *, const typeinfo *);
+static typeid SignatureFromParams(vector(Param), type *, type *, typekind);
+static void ToString(vstring *, const typeid);
+
+//------------------------------------------------------------------------------
+//The types are stored in chunks which never move once allocated, so that a
+//lookup by ID needs no lock. The ID of a type gives its chunk and its position
+//within the chunk. As in the intern table, the index that maps a type to its ID
+//is split into shards by the top bits of the hash and each shard is guarded by
+//its own mutex. A shard is an open addressing hash table with linear probing;
+//IDs are never removed, so a probe ends at the first empty slot. The table
+//lives in the process arena since an ID outlives the compilation which issued
+//it when --Watch compiles the modules again.
+
+#define TYPE_SHARD_BITS 4
+#define TYPE_SHARDS ((size_t) 1 << TYPE_SHARD_BITS)
+#define TYPE_SHARD_CAPACITY ((size_t) 64)
+
+#define TYPE_CHUNK_BITS 8
+#define TYPE_CHUNK ((size_t) 1 << TYPE_CHUNK_BITS)
+#define TYPE_CHUNKS ((size_t) 1 << 16)
+
+//each thread remembers the last ID it returned in each of TYPE_CACHE buckets
+//and only takes a shard lock on a miss; the same few types recur throughout
+//a module
+#define TYPE_CACHE ((size_t) 256)
+
+struct slot {
+	uint64_t hash;
+	typeid id; //TYPE_NONE if the slot is empty
+};
+
+struct shard {
+	pthread_mutex_t mutex;
+	size_t len;
+	size_t cap;
+	slot *buffer;
+};
+
+static shard shards[TYPE_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+
+//the first ID is reserved for TYPE_NONE
+static typeinfo *chunks[TYPE_CHUNKS];
+static typeid next_id = 1;
+static pthread_mutex_t chunks_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread typeid cache[TYPE_CACHE];
+
+make_vector(typeid, TypeID, static)
+
+//the parameter IDs of the signature under construction and the output of
+//TypeTableToString are built in buffers which every call on the thread reuses;
+//they are drawn from the process arena so that they outlive each compilation
+static __thread vector(TypeID) params_scratch = {0};
+static __thread vstring text_scratch = {0};
+
+//------------------------------------------------------------------------------
+
+static void InitShards(void)
+{
+	for (size_t i = 0; i < TYPE_SHARDS; i++) {
+		shard *s = shards + i;
+
+		int err = pthread_mutex_init(&s->mutex, NULL);
+
+		if (err) {
+			xerror_fatal("cannot initialize type table");
+			abort();
+		}
+
+		s->len = 0;
+		s->cap = 0;
+		s->buffer = NULL;
+	}
+}
+
+typeid TypeTableFromNode(type *node)
+{
+	assert(node);
+
+	typeinfo info = {0};
+
+	switch (node->tag) {
+	case NODE_BASE:
+		info.kind = TYPE_BASE;
+		info.base.name = node->base.name;
+		break;
+
+	case NODE_NAMED:
+		info.kind = TYPE_NAMED;
+		info.named.name = node->named.name;
+		info.named.base = TypeTableFromNode(node->named.reference);
+		break;
+
+	case NODE_POINTER:
+		info.kind = TYPE_POINTER;
+		info.pointer.reference = TypeTableFromNode(node->pointer.reference);
+		break;
+
+	case NODE_ARRAY:
+		info.kind = TYPE_ARRAY;
+		info.array.element = TypeTableFromNode(node->array.element);
+		info.array.len = node->array.len;
+		break;
+
+	default:
+		assert(0 != 0 && "invalid type tag");
+		__builtin_unreachable();
+	}
+
+	return Insert(&info);
+}
+
+typeid TypeTableFromDecl(decl *node)
+{
+	assert(node);
+
+	switch (node->tag) {
+	case NODE_FUNCTION:
+		return SignatureFromParams(node->function.params,
+					   node->function.ret,
+					   NULL,
+					   TYPE_FUNCTION);
+
+	case NODE_METHOD:
+		return SignatureFromParams(node->method.params,
+					   node->method.ret,
+					   node->method.recv,
+					   TYPE_METHOD);
+
+	default:
+		assert(0 != 0 && "declaration has no signature");
+		__builtin_unreachable();
+	}
+}
+
+const typeinfo *TypeTableLookup(const typeid id)
+{
+	assert(id != TYPE_NONE);
+
+	const typeinfo *chunk = chunks[id >> TYPE_CHUNK_BITS];
+	assert(chunk && "type ID was never issued");
+
+	return chunk + (id & (TYPE_CHUNK - 1));
+}
+
+const cstring *TypeTableToString(const typeid id)
+{
+	vstring *vstr = &text_scratch;
+
+	ArenaShare();
+
+	if (!vstr->buffer) {
+		*vstr = vStringInit(VECTOR_DEFAULT_CAPACITY);
+	} else {
+		vStringReset(vstr);
+	}
+
+	ToString(vstr, id);
+
+	ArenaUnshare();
+
+	return vstr->buffer;
+}
+
+//------------------------------------------------------------------------------
+
+//the parameter IDs are gathered in a scratch buffer of the calling thread and
+//copied into the table only if the signature is new
+static typeid SignatureFromParams
+(
+	vector(Param) params,
+	type *ret,
+	type *recv,
+	typekind kind
+)
+{
+	vector(TypeID) *ids = &params_scratch;
+
+	ArenaShare();
+
+	if (!ids->buffer) {
+		*ids = TypeIDVectorInit(0, VECTOR_DEFAULT_CAPACITY);
+	} else {
+		TypeIDVectorReset(ids);
+	}
+
+	for (size_t i = 0; i < params.len; i++) {
+		type *node = params.buffer[i].typ;
+		TypeIDVectorPush(ids, TypeTableFromNode(node));
+	}
+
+	ArenaUnshare();
+
+	typeinfo info = {
+		.kind = kind,
+		.signature = {
+			.params = ids->buffer,
+			.len = params.len,
+			.ret = ret ? TypeTableFromNode(ret) : TYPE_NONE,
+			.recv = recv ? TypeTableFromNode(recv) : TYPE_NONE
+		}
+	};
+
+	return Insert(&info);
+}
+
+static typeid Insert(const typeinfo *info)
+{
+	assert(info);
+
+	const uint64_t hash = Hash(info);
+	typeid *recent = cache + (hash & (TYPE_CACHE - 1));
+
+	if (*recent && Match(TypeTableLookup(*recent), info)) {
+		return *recent;
+	}
+
+	(void) pthread_once(&shards_once, InitShards);
+
+	shard *s = shards + (hash >> (64 - TYPE_SHARD_BITS));
+
+	pthread_mutex_lock(&s->mutex);
+
+	typeid id = Search(s, info, hash);
+
+	if (id == TYPE_NONE) {
+		ArenaShare();
+		id = Store(s, info, hash);
+		ArenaUnshare();
+	}
+
+	pthread_mutex_unlock(&s->mutex);
+
+	*recent = id;
+
+	return id;
+}
+
+static typeid Search(shard *s, const typeinfo *info, const uint64_t hash)
+{
+	assert(s);
+	assert(info);
+
+	if (!s->cap) {
+		return TYPE_NONE;
+	}
+
+	const size_t mask = s->cap - 1;
+
+	for (size_t i = hash & mask; s->buffer[i].id; i = (i + 1) & mask) {
+		const slot *curr = s->buffer + i;
+
+		if (curr->hash == hash && Match(TypeTableLookup(curr->id), info)) {
+			return curr->id;
+		}
+	}
+
+	return TYPE_NONE;
+}
+
+//the caller holds the shard lock and has opened a shared section; the
+//parameters of a new signature are copied into the table
+static typeid Store(shard *s, const typeinfo *info, const uint64_t hash)
+{
+	assert(s);
+	assert(info);
+
+	if ((s->len + 1) * 4 > s->cap * 3) {
+		Grow(s);
+	}
+
+	pthread_mutex_lock(&chunks_mutex);
+
+	const typeid id = next_id++;
+	typeinfo *entry = Reserve(id);
+
+	pthread_mutex_unlock(&chunks_mutex);
+
+	*entry = *info;
+
+	if (info->kind == TYPE_FUNCTION || info->kind == TYPE_METHOD) {
+		const size_t bytes = sizeof(typeid) * info->signature.len;
+		typeid *params = allocate(bytes ? bytes : sizeof(typeid));
+
+		memcpy(params, info->signature.params, bytes);
+		entry->signature.params = params;
+	}
+
+	const size_t mask = s->cap - 1;
+	size_t i = hash & mask;
+
+	while (s->buffer[i].id) {
+		i = (i + 1) & mask;
+	}
+
+	s->buffer[i] = (slot) {
+		.hash = hash,
+		.id = id
+	};
+
+	s->len++;
+
+	return id;
+}
+
+static void Grow(shard *s)
+{
+	assert(s);
+
+	const size_t cap = s->cap ? s->cap * 2 : TYPE_SHARD_CAPACITY;
+	slot *buffer = allocate(sizeof(slot) * cap);
+
+	for (size_t j = 0; j < s->cap; j++) {
+		const slot old = s->buffer[j];
+
+		if (!old.id) {
+			continue;
+		}
+
+		size_t i = old.hash & (cap - 1);
+
+		while (buffer[i].id) {
+			i = (i + 1) & (cap - 1);
+		}
+
+		buffer[i] = old;
+	}
+
+	s->cap = cap;
+	s->buffer = buffer;
+}
+
+//the caller holds the chunks lock; returns the storage for a new ID
+static typeinfo *Reserve(const typeid id)
+{
+	const size_t index = id >> TYPE_CHUNK_BITS;
+
+	if (index >= TYPE_CHUNKS) {
+		xerror_fatal("type table is full");
+		abort();
+	}
+
+	if (!chunks[index]) {
+		chunks[index] = allocate(sizeof(typeinfo) * TYPE_CHUNK);
+	}
+
+	return chunks[index] + (id & (TYPE_CHUNK - 1));
+}
+
+//------------------------------------------------------------------------------
+
+static uint64_t Combine(const uint64_t hash, const uint64_t value)
+{
+	return MapMix(hash ^ (value + (uint64_t) 0x9e3779b97f4a7c15ULL));
+}
+
+//names are interned, so their hashes are free
+static uint64_t Hash(const typeinfo *info)
+{
+	assert(info);
+
+	uint64_t hash = MapMix((uint64_t) info->kind + 1);
+
+	switch (info->kind) {
+	case TYPE_BASE:
+		hash = Combine(hash, InternHash(info->base.name));
+		break;
+
+	case TYPE_NAMED:
+		hash = Combine(hash, InternHash(info->named.name));
+		hash = Combine(hash, info->named.base);
+		break;
+
+	case TYPE_POINTER:
+		hash = Combine(hash, info->pointer.reference);
+		break;
+
+	case TYPE_ARRAY:
+		hash = Combine(hash, info->array.element);
+		hash = Combine(hash, (uint64_t) info->array.len);
+		break;
+
+	case TYPE_FUNCTION:
+		__attribute__((fallthrough));
+
+	case TYPE_METHOD:
+		for (size_t i = 0; i < info->signature.len; i++) {
+			hash = Combine(hash, info->signature.params[i]);
+		}
+
+		hash = Combine(hash, info->signature.len);
+		hash = Combine(hash, info->signature.ret);
+		hash = Combine(hash, info->signature.recv);
+		break;
+
+	default:
+		assert(0 != 0 && "invalid type kind");
+		__builtin_unreachable();
+	}
+
+	return hash;
+}
+
+static bool Match(const typeinfo *a, const typeinfo *b)
+{
+	assert(a);
+	assert(b);
+
+	if (a->kind != b->kind) {
+		return false;
+	}
+
+	switch (a->kind) {
+	case TYPE_BASE:
+		return a->base.name == b->base.name;
+
+	case TYPE_NAMED:
+		return a->named.name == b->named.name
+		       && a->named.base == b->named.base;
+
+	case TYPE_POINTER:
+		return a->pointer.reference == b->pointer.reference;
+
+	case TYPE_ARRAY:
+		return a->array.element == b->array.element
+		       && a->array.len == b->array.len;
+
+	case TYPE_FUNCTION:
+		__attribute__((fallthrough));
+
+	case TYPE_METHOD:
+		if (a->signature.len != b->signature.len
+		    || a->signature.ret != b->signature.ret
+		    || a->signature.recv != b->signature.recv) {
+			return false;
+		}
+
+		const size_t bytes = sizeof(typeid) * a->signature.len;
+
+		return !memcmp(a->signature.params, b->signature.params, bytes);
+
+	default:
+		assert(0 != 0 && "invalid type kind");
+		__builtin_unreachable();
+	}
+}
+
+//TYPE_NONE appends nothing
+static void ToString(vstring *vstr, const typeid id)
+{
+	assert(vstr);
+
+	if (id == TYPE_NONE) {
+		return;
+	}
+
+	const typeinfo *info = TypeTableLookup(id);
+
+	switch (info->kind) {
+	case TYPE_BASE:
+		vStringAppendcString(vstr, info->base.name);
+		break;
+
+	case TYPE_NAMED:
+		vStringAppendcString(vstr, info->named.name);
+		ToString(vstr, info->named.base);
+		break;
+
+	case TYPE_POINTER:
+		vStringAppend(vstr, '*');
+		ToString(vstr, info->pointer.reference);
+		break;
+
+	case TYPE_ARRAY:
+		vStringAppend(vstr, '[');
+		vStringAppendIntMax(vstr, info->array.len);
+		vStringAppend(vstr, ']');
+		ToString(vstr, info->array.element);
+		break;
+
+	case TYPE_FUNCTION:
+		__attribute__((fallthrough));
+
+	case TYPE_METHOD:
+		for (size_t i = 0; i < info->signature.len; i++) {
+			if (i > 0) {
+				vStringAppend(vstr, ',');
+			}
+
+			ToString(vstr, info->signature.params[i]);
+		}
+
+		vStringAppend(vstr, ':');
+		ToString(vstr, info->signature.ret);
+
+		if (info->kind == TYPE_METHOD) {
+			vStringAppend(vstr, ':');
+			ToString(vstr, info->signature.recv);
+		}
+
+		break;
+
+	default:
+		assert(0 != 0 && "invalid type kind");
+		__builtin_unreachable();
+	}
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// The type table hash-conses every type which the resolver attaches to a
+// symbol. Each distinct type is stored once and is named by a compact integer
+// ID, so two types are equal if and only if their IDs are equal. A composite
+// type refers to its parts by ID; i.e., the type list [10] -> * -> int32 is an
+// array of length 10 whose element is the ID of a pointer to the ID of int32.
+// Function and method signatures are types too.
+//
+// The table lives until exit and, like the intern table, is shared by every
+// thread. IDs are never reused, so an ID which one thread has published through
+// a symbol table may be looked up by any other thread without a lock.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "str.h"
+
+//parser.h includes the symbol tables, which include this header
+typedef struct type type;
+typedef struct decl decl;
+
+typedef uint32_t typeid;
+typedef struct typeinfo typeinfo;
+
+//names no type; it is the return type of a void function and the receiver of
+//a method without one
+#define TYPE_NONE ((typeid) 0)
+
+typedef enum typekind {
+	TYPE_BASE,
+	TYPE_NAMED,
+	TYPE_POINTER,
+	TYPE_ARRAY,
+	TYPE_FUNCTION,
+	TYPE_METHOD,
+} typekind;
+
+//read-only
+//@named: base names a type within the module named by name
+//@signature: receiver is TYPE_NONE for a function
+struct typeinfo {
+	typekind kind;
+	union {
+		struct {
+			const cstring *name;
+		} base;
+
+		struct {
+			const cstring *name;
+			typeid base;
+		} named;
+
+		struct {
+			typeid reference;
+		} pointer;
+
+		struct {
+			typeid element;
+			intmax_t len;
+		} array;
+
+		struct {
+			const typeid *params;
+			size_t len;
+			typeid ret;
+			typeid recv;
+		} signature;
+	};
+};
+
+//thread-safe; returns the ID of the type list whose head is node
+typeid TypeTableFromNode(type *node);
+
+//thread-safe; returns the ID of the signature of a function or method
+typeid TypeTableFromDecl(decl *node);
+
+//thread-safe; returns the type named by an ID other than TYPE_NONE
+const typeinfo *TypeTableLookup(const typeid id);
+
+//returns the compact string notation of the type, as written in the source but
+//without spaces or dots; i.e., "[10]*int32". A signature translates to the
+//string "int32,bool:float64" for func (int32, bool) -> float64, where a void
+//parameter list gives ":float64" and a void return gives "int32,bool:". Method
+//signatures append a second ':' and the receiver type. The string lives in a
+//buffer of the calling thread until its next call.
+const cstring *TypeTableToString(const typeid id);
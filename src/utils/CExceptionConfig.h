@@ -0,0 +1,20 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Build configuration for the CException library, enabled via the compiler
+// flag -DCEXCEPTION_USE_CONFIG_FILE. By default CException keeps one frame
+// stack for the whole process, which is only safe when a single thread uses
+// Try and Throw. Lemon parses and resolves modules on worker threads, so each
+// thread is given its own frame stack through an index kept in thread local
+// storage by the xerror module.
+
+#pragma once
+
+//maximum number of threads that may use Try or Throw at once. IDs are recycled
+//when a thread exits and the parse and resolve pools never overlap, so this must
+//exceed the largest pool plus the main thread.
+#define CEXCEPTION_NUM_ID 64
+
+#define CEXCEPTION_GET_ID (XerrorExceptionID())
+
+//returns the frame stack index of the calling thread
+unsigned int XerrorExceptionID(void);
@@ -1,8 +1,11 @@
 // Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
 
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "arena.h"
 #include "xerror.h"
@@ -14,11 +17,25 @@
 #endif
 
 typedef struct arena arena;
+typedef struct block block;
 typedef struct header header;
+typedef struct detached detached;
+
+static void *Allocate(arena *, size_t);
+static void *Reallocate(arena *, void *, size_t);
 
 //configurable to any power of two
 #define ALIGNMENT ((size_t) 0x10)
 
+//each new block is at least this many times larger than its predecessor
+#define GROWTH_FACTOR ((size_t) 2)
+
+//size of the first block of a scratch region
+#define SCRATCH_BLOCK KiB(64)
+
+//size of the first block of the process arena
+#define PROCESS_BLOCK MiB(1)
+
 //rounds the input UP to the nearest multiple of the arena alignment. If the
 //rounded input would overflow, then rounds the input DOWN to the nearest
 //multiple.
@@ -49,23 +66,125 @@ static size_t Align(const size_t bytes)
 }
 
 //------------------------------------------------------------------------------
-//An arena is a bump allocator in multiples of 16. If the top pointer reaches
-//the location at (char*) arena.top + capacity, then the arena is out of memory.
+//An arena is a chain of blocks mapped from the kernel. Each block begins with a
+//descriptor that links it to the block before it, and the remainder is a bump
+//allocator in multiples of 16. When the top pointer of the newest block cannot
+//satisfy a request a new block is mapped that is at least GROWTH_FACTOR times
+//larger than the newest block. Anonymous mappings are zeroed lazily by the
+//kernel on first touch, so an arena only pays for the pages it actually uses.
+//
+//The memory between the top pointer and the end of the newest block has never
+//been handed out, so it is still zero and the most recent allocation can be
+//extended in place without a copy. Saved is the number of bytes that would
+//have been allocated and copied without this fast path.
+//
+//Used and mapped are running totals over the whole chain; the former counts the
+//bytes handed out to the user along with their headers and the latter counts
+//the bytes acquired from the kernel. An arena never frees individual
+//allocations, but the scratch regions opened on top of it are released whole,
+//so peak records the most bytes that the arena and its open scratch regions
+//have held at once.
+//
+//A scratch region is an arena of its own, stacked in thread local storage above
+//the thread's arena. While a region is open every allocation on the thread is
+//drawn from the innermost region, and closing it unmaps the region's blocks. It
+//follows that a pointer into a scratch region must not survive its ArenaPop,
+//and that memory from outside the region must not be reallocated within it.
+//
+//The process arena is the one arena which is not thread local. It is mapped on
+//the first shared allocation and guarded by a mutex which is only held for the
+//duration of one allocation, so a thread may hold other locks while it shares.
+//Its used and peak totals are its own rather than those of any thread.
+//
 //The GCC storage class __thread (_Thread_local in C11) is used in place of a 
 //more cumbersome and slow pthread_key_t lookup.
 
+struct block {
+	block *prev;
+	size_t capacity;
+};
+
 struct arena {
+	block *curr;
 	void *top;
-	size_t capacity;
 	size_t remaining;
+	size_t saved;
+	size_t used;
+	size_t mapped;
+	size_t peak;
 };
 
 static __thread arena arena_tls =  {
+	.curr = NULL,
 	.top = NULL,
-	.capacity = 0,
-	.remaining = 0
+	.remaining = 0,
+	.saved = 0,
+	.used = 0,
+	.mapped = 0,
+	.peak = 0
+};
+
+//@depth: number of open scratch regions; regions[depth - 1] is the innermost
+//@used: bytes held by every open region
+static __thread struct {
+	arena regions[ARENA_SCRATCH_DEPTH];
+	size_t depth;
+	size_t used;
+} scratch_tls = {
+	.regions = {{0}},
+	.depth = 0,
+	.used = 0
 };
 
+static struct {
+	pthread_mutex_t mutex;
+	arena region;
+} process = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.region = {0}
+};
+
+//number of open ArenaShare calls on the thread
+static __thread size_t share_tls = 0;
+
+//returns the arena which serves allocations on the calling thread
+static arena *Top(void)
+{
+	if (scratch_tls.depth) {
+		return scratch_tls.regions + scratch_tls.depth - 1;
+	}
+
+	return &arena_tls;
+}
+
+//records 'bytes' newly handed out by the region and updates the peak
+static void Account(arena *region, const size_t bytes)
+{
+	assert(region);
+
+	region->used += bytes;
+
+	if (region == &process.region) {
+		if (region->used > region->peak) {
+			region->peak = region->used;
+		}
+
+		return;
+	}
+
+	if (region != &arena_tls) {
+		scratch_tls.used += bytes;
+	}
+
+	const size_t live = arena_tls.used + scratch_tls.used;
+
+	if (live > arena_tls.peak) {
+		arena_tls.peak = live;
+	}
+}
+
+static_assert(sizeof(block) % ALIGNMENT == 0, "block descriptor misaligns");
+
 //------------------------------------------------------------------------------
 //a header hides just in front of each memory region returned to the user; it is
 //the primary mechanism that enables block reallocation.
@@ -84,19 +203,100 @@ static header *GetHeader(void *user_region)
 }
 
 //------------------------------------------------------------------------------
+//arenas given up by ArenaDetach are kept on a stack until ArenaFree or until
+//their generation is released. Each node is allocated from the arena it
+//describes, so the stack needs no storage of its own and a node is released
+//alongside the memory it tracks.
+
+struct detached {
+	arena region;
+	size_t generation;
+	detached *next;
+};
 
-bool ArenaInit(size_t bytes)
+//@generation: the current generation; every lower one is closed
+static struct {
+	pthread_mutex_t mutex;
+	detached *head;
+	size_t generation;
+} graveyard = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.head = NULL,
+	.generation = 0
+};
+
+//------------------------------------------------------------------------------
+
+//maps a new block with room for at least 'bytes' and pushes it onto the chain
+//of the region; returns false on failure
+static bool Map(arena *region, size_t bytes)
 {
-	ArenaTrace("request for arena with %zu bytes", bytes);
+	assert(region);
 
 	bytes = Align(bytes);
 
-	arena_tls.capacity = bytes;
-	arena_tls.remaining = bytes;
-	arena_tls.top = calloc(bytes, 1);
+	const size_t total_bytes = sizeof(block) + bytes;
 
-	if (!arena_tls.top) {
-		xerror_fatal("stdlib calloc; out of memory");
+	if (total_bytes < bytes) {
+		xerror_fatal("block + descriptor causes overflow");
+		return false;
+	}
+
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+	void *mapping = mmap(NULL, total_bytes, prot, flags, -1, 0);
+
+	if (mapping == MAP_FAILED) {
+		xerror_fatal("mmap; %s", strerror(errno));
+		return false;
+	}
+
+	block *new = mapping;
+	new->prev = region->curr;
+	new->capacity = total_bytes;
+
+	region->curr = new;
+	region->top = new + 1;
+	region->remaining = bytes;
+	region->mapped += total_bytes;
+
+	ArenaTrace("mapped block at %p with %zu bytes", mapping, total_bytes);
+
+	return true;
+}
+
+//maps a block which can hold at least 'bytes'; returns false on failure
+static bool Grow(arena *region, const size_t bytes)
+{
+	assert(region);
+	assert(region->curr);
+
+	size_t capacity = region->curr->capacity;
+
+	if (capacity > SIZE_MAX / GROWTH_FACTOR) {
+		capacity = SIZE_MAX;
+	} else {
+		capacity *= GROWTH_FACTOR;
+	}
+
+	if (capacity < bytes) {
+		capacity = bytes;
+	}
+
+	ArenaTrace("block exhausted; growing to %zu bytes", capacity);
+
+	return Map(region, capacity);
+}
+
+bool ArenaInit(size_t bytes)
+{
+	ArenaTrace("request for arena with %zu bytes", bytes);
+
+	assert(!arena_tls.curr && "arena already initialised");
+
+	if (!Map(&arena_tls, bytes)) {
+		xerror_fatal("cannot map first block; out of memory");
 		return false;
 	}
 
@@ -105,30 +305,296 @@ bool ArenaInit(size_t bytes)
 	return true;
 }
 
+//unmaps every block in the chain; 'remaining' only describes the newest block
+static void Release(arena *region)
+{
+	assert(region);
+	assert(region->curr);
+
+	block *curr = region->curr;
+
+	__attribute__((unused)) double total = (double) curr->capacity;
+	__attribute__((unused)) double used = (double) region->remaining;
+	__attribute__((unused)) double percent = (used / total) * 100;
+
+	ArenaTrace("releasing arena (%g%% of newest block unused)", percent);
+	ArenaTrace("in-place reallocation saved %zu bytes", region->saved);
+
+	while (curr) {
+		block *prev = curr->prev;
+
+		ArenaTrace("unmapping block at %p", (void *) curr);
+
+		int err = munmap(curr, curr->capacity);
+
+		if (err) {
+			xerror_issue("munmap; %s", strerror(errno));
+		}
+
+		curr = prev;
+	}
+}
+
 void ArenaFree(void)
 {
-	if (!arena_tls.top) {
+	while (scratch_tls.depth) {
+		ArenaPop();
+	}
+
+	if (arena_tls.curr) {
+		Release(&arena_tls);
+		arena_tls = (arena) {
+			.curr = NULL,
+			.top = NULL,
+			.remaining = 0,
+			.saved = 0,
+			.used = 0,
+			.mapped = 0,
+			.peak = 0
+		};
+	}
+
+	pthread_mutex_lock(&graveyard.mutex);
+
+	detached *node = graveyard.head;
+
+	while (node) {
+		detached *next = node->next;
+		arena region = node->region;
+
+		Release(&region);
+
+		node = next;
+	}
+
+	graveyard.head = NULL;
+
+	pthread_mutex_unlock(&graveyard.mutex);
+
+	pthread_mutex_lock(&process.mutex);
+
+	if (process.region.curr) {
+		Release(&process.region);
+		process.region = (arena) {
+			.curr = NULL,
+			.top = NULL,
+			.remaining = 0,
+			.saved = 0,
+			.used = 0,
+			.mapped = 0,
+			.peak = 0
+		};
+	}
+
+	pthread_mutex_unlock(&process.mutex);
+}
+
+void ArenaDetach(void)
+{
+	if (!arena_tls.curr) {
 		return;
 	}
 
-	const size_t offset = arena_tls.capacity - arena_tls.remaining;
-	void *start = (char *) arena_tls.top - offset;
-	free(start);
+	assert(!scratch_tls.depth && "detached with an open scratch region");
+	assert(!share_tls && "detached within ArenaShare");
 
-	__attribute__((unused)) double total = (double) arena_tls.capacity;
-	__attribute__((unused)) double used = (double) arena_tls.remaining;
-	__attribute__((unused)) double percent = (used / total) * 100;
+	detached *node = ArenaAllocate(sizeof(detached));
+
+	if (!node) {
+		xerror_fatal("cannot detach arena; memory will leak");
+		return;
+	}
 
-	ArenaTrace("allocation at %p released (%g%% unused)", start, percent);
+	node->region = arena_tls;
+
+	pthread_mutex_lock(&graveyard.mutex);
+
+	node->generation = graveyard.generation;
+	node->next = graveyard.head;
+	graveyard.head = node;
+
+	pthread_mutex_unlock(&graveyard.mutex);
+
+	ArenaTrace("arena detached at %p", (void *) node);
+
+	arena_tls = (arena) {
+		.curr = NULL,
+		.top = NULL,
+		.remaining = 0,
+		.saved = 0,
+		.used = 0,
+		.mapped = 0,
+		.peak = 0
+	};
+}
+
+size_t ArenaCloseGeneration(void)
+{
+	pthread_mutex_lock(&graveyard.mutex);
+
+	const size_t closed = graveyard.generation++;
+
+	pthread_mutex_unlock(&graveyard.mutex);
+
+	ArenaTrace("generation %zu closed", closed);
+
+	return closed;
+}
+
+void ArenaReleaseGeneration(size_t generation)
+{
+	pthread_mutex_lock(&graveyard.mutex);
+
+	assert(generation < graveyard.generation && "generation is still open");
+
+	detached **link = &graveyard.head;
+
+	while (*link) {
+		detached *node = *link;
+
+		if (node->generation != generation) {
+			link = &node->next;
+			continue;
+		}
+
+		*link = node->next;
+
+		arena region = node->region;
+		Release(&region);
+	}
+
+	pthread_mutex_unlock(&graveyard.mutex);
+
+	ArenaTrace("generation %zu released", generation);
+}
+
+void ArenaShare(void)
+{
+	share_tls++;
+}
+
+void ArenaUnshare(void)
+{
+	assert(share_tls && "no shared section is open");
+
+	share_tls--;
+}
+
+void ArenaPush(void)
+{
+	if (scratch_tls.depth == ARENA_SCRATCH_DEPTH) {
+		xerror_fatal("scratch regions nested too deeply");
+		abort();
+	}
+
+	arena *region = scratch_tls.regions + scratch_tls.depth;
+
+	*region = (arena) {
+		.curr = NULL,
+		.top = NULL,
+		.remaining = 0,
+		.saved = 0,
+		.used = 0,
+		.mapped = 0,
+		.peak = 0
+	};
+
+	if (!Map(region, SCRATCH_BLOCK)) {
+		xerror_fatal("cannot map scratch region; out of memory");
+		abort();
+	}
+
+	scratch_tls.depth++;
+
+	ArenaTrace("scratch region %zu opened", scratch_tls.depth);
+}
+
+void ArenaPop(void)
+{
+	assert(scratch_tls.depth && "no scratch region is open");
+
+	scratch_tls.depth--;
+
+	arena *region = scratch_tls.regions + scratch_tls.depth;
+
+	assert(scratch_tls.used >= region->used);
+	scratch_tls.used -= region->used;
+
+	ArenaTrace("scratch region %zu closed", scratch_tls.depth + 1);
+
+	Release(region);
+}
+
+void ArenaUsage(size_t *used, size_t *mapped, size_t *peak)
+{
+	assert(used);
+	assert(mapped);
+	assert(peak);
+
+	*used = arena_tls.used + scratch_tls.used;
+	*mapped = arena_tls.mapped;
+	*peak = arena_tls.peak;
+
+	for (size_t i = 0; i < scratch_tls.depth; i++) {
+		*mapped += scratch_tls.regions[i].mapped;
+	}
+
+	pthread_mutex_lock(&graveyard.mutex);
+
+	for (detached *node = graveyard.head; node; node = node->next) {
+		*used += node->region.used;
+		*mapped += node->region.mapped;
+		*peak += node->region.peak;
+	}
+
+	pthread_mutex_unlock(&graveyard.mutex);
+
+	pthread_mutex_lock(&process.mutex);
+
+	*used += process.region.used;
+	*mapped += process.region.mapped;
+	*peak += process.region.peak;
+
+	pthread_mutex_unlock(&process.mutex);
+}
+
+size_t ArenaUsed(void)
+{
+	return arena_tls.used + scratch_tls.used;
 }
 
 void *ArenaAllocate(size_t bytes)
 {
-	if (!arena_tls.top) {
+	if (!arena_tls.curr) {
 		xerror_fatal("thread local arena not initialised");
 		return NULL;
 	}
 
+	if (!share_tls) {
+		return Allocate(Top(), bytes);
+	}
+
+	pthread_mutex_lock(&process.mutex);
+
+	void *ptr = NULL;
+
+	if (process.region.curr || Map(&process.region, PROCESS_BLOCK)) {
+		ptr = Allocate(&process.region, bytes);
+	} else {
+		xerror_fatal("cannot map process arena; out of memory");
+	}
+
+	pthread_mutex_unlock(&process.mutex);
+
+	return ptr;
+}
+
+//the caller holds the process mutex if the region is the process arena
+static void *Allocate(arena *region, size_t bytes)
+{
+	assert(region);
+	assert(region->curr);
+
 	ArenaTrace("request for new block with %zu bytes", bytes);
 
 	const size_t user_bytes = Align(bytes);
@@ -139,27 +605,80 @@ void *ArenaAllocate(size_t bytes)
 		return NULL;
 	}
 
-	if (total_bytes > arena_tls.remaining) {
+	if (total_bytes > region->remaining && !Grow(region, total_bytes)) {
 		xerror_fatal("arena; out of memory");
 		return NULL;
 	}
 
-	header *metadata = arena_tls.top;
+	header *metadata = region->top;
 	metadata->bytes = user_bytes;
 
-	arena_tls.top = (void *) ((char *) arena_tls.top + total_bytes);
-	arena_tls.remaining -= total_bytes;
+	region->top = (void *) ((char *) region->top + total_bytes);
+	region->remaining -= total_bytes;
+	Account(region, total_bytes);
 
 	ArenaTrace("request fulfilled; block header at %p", (void *) metadata);
-	ArenaTrace("arena; %zu bytes remain", arena_tls.remaining);
+	ArenaTrace("arena; %zu bytes remain", region->remaining);
 
 	void *user_region = metadata + 1;
 	return user_region;
 }
 
+//extends the user block at 'old' to 'bytes' if it is the most recent allocation
+//and the newest block of the region has room; returns false if the block cannot
+//grow
+static bool GrowInPlace(arena *region, void *old, const size_t bytes)
+{
+	assert(region);
+	assert(old);
+
+	header *metadata = GetHeader(old);
+	void *end = (char *) old + metadata->bytes;
+
+	if (end != region->top) {
+		return false;
+	}
+
+	const size_t user_bytes = Align(bytes);
+	const size_t extension = user_bytes - metadata->bytes;
+
+	if (user_bytes < bytes || extension > region->remaining) {
+		return false;
+	}
+
+	region->top = (char *) region->top + extension;
+	region->remaining -= extension;
+	region->saved += sizeof(header) + user_bytes;
+	Account(region, extension);
+
+	metadata->bytes = user_bytes;
+
+	ArenaTrace("block at %p grown in place", (void *) metadata);
+	ArenaTrace("arena; %zu bytes remain", region->remaining);
+
+	return true;
+}
+
+//returns true if 'ptr' lies within one of the blocks of the region
+static bool Owns(const arena *region, const void *ptr)
+{
+	assert(region);
+
+	for (const block *curr = region->curr; curr; curr = curr->prev) {
+		const char *start = (const char *) curr;
+		const char *end = start + curr->capacity;
+
+		if ((const char *) ptr >= start && (const char *) ptr < end) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void *ArenaReallocate(void *old, size_t bytes)
 {
-	if (!arena_tls.top) {
+	if (!arena_tls.curr) {
 		xerror_fatal("thread local arena not initialised");
 		return NULL;
 	}
@@ -169,6 +688,26 @@ void *ArenaReallocate(void *old, size_t bytes)
 		return NULL;
 	}
 
+	if (!share_tls) {
+		return Reallocate(Top(), old, bytes);
+	}
+
+	pthread_mutex_lock(&process.mutex);
+
+	//the block was allocated in a shared section, so the arena is mapped
+	void *new = Reallocate(&process.region, old, bytes);
+
+	pthread_mutex_unlock(&process.mutex);
+
+	return new;
+}
+
+//the caller holds the process mutex if the region is the process arena
+static void *Reallocate(arena *region, void *old, size_t bytes)
+{
+	assert(region);
+	assert(old);
+
 	void *new = NULL;
 	header *metadata = GetHeader(old);
 
@@ -179,7 +718,17 @@ void *ArenaReallocate(void *old, size_t bytes)
 		return old;
 	}
 
-	new = ArenaAllocate(bytes);
+	//a copy in the region would vanish at ArenaPop while the owner of the old
+	//block still refers to it
+	assert((region == &arena_tls || region == &process.region
+		|| Owns(region, old))
+	       && "reallocation of memory outside the scratch region");
+
+	if (GrowInPlace(region, old, bytes)) {
+		return old;
+	}
+
+	new = Allocate(region, bytes);
 
 	if (!new) {
 		xerror_fatal("new block request failed");
@@ -15,8 +15,8 @@
 #define MiB(mebibytes) ((size_t) (1048576 * mebibytes))
 #define GiB(gibibytes) ((size_t) (1073741824 * gibibytes))
 
-//initialise a thread-local arena with a minimum fixed capacity of 'bytes';
-//returns false on failure
+//initialise a thread-local arena whose first block holds at least 'bytes'; the
+//arena grows on demand; returns false on failure
 bool ArenaInit(size_t bytes);
 
 //returns an aligned and zeroed memory block; returns NULL on failure
@@ -27,10 +27,55 @@ void *ArenaAllocate(size_t bytes);
 //NULL on failure
 void *ArenaReallocate(void *ptr, size_t bytes);
 
-//releases system resources acquired by ArenaInit; okay if the arena was not
-//initialised prior to this call
+//releases system resources acquired by ArenaInit along with the process arena
+//and every arena that was detached by ArenaDetach; okay if the arena was not
+//initialised prior to this call. Detached arenas must no longer be in use by
+//any thread.
 void ArenaFree(void);
 
+//transfer ownership of the thread-local arena to the process so that its data
+//outlives the calling thread; e.g., a worker thread that builds an AST for its
+//parent. The calling thread must invoke ArenaInit before it allocates again.
+void ArenaDetach(void);
+
+//arenas detached by ArenaDetach are grouped into generations; this closes the
+//current generation and returns its number. Arenas detached afterwards belong
+//to the next generation.
+size_t ArenaCloseGeneration(void);
+
+//releases every arena detached during a closed generation; they must no longer
+//be in use by any thread
+void ArenaReleaseGeneration(size_t generation);
+
+//until the matching ArenaUnshare every allocation on the calling thread, even
+//within a scratch region, is drawn from the process arena instead. It is shared
+//by all threads, guarded by a mutex, and only released by ArenaFree, so it
+//holds the data that outlives any one generation. Calls may nest.
+void ArenaShare(void);
+void ArenaUnshare(void);
+
+//maximum number of scratch regions that may be open at once on one thread
+#define ARENA_SCRATCH_DEPTH ((size_t) 4)
+
+//opens a scratch region on the calling thread; until the matching ArenaPop all
+//allocations on the thread are drawn from the region. Memory allocated before
+//the push must not be reallocated until the region is closed.
+void ArenaPush(void);
+
+//closes the innermost scratch region and returns its memory to the kernel; no
+//pointer into the region may be used afterwards
+void ArenaPop(void);
+
+//reports the bytes allocated by and the bytes mapped for the thread-local arena,
+//its open scratch regions, the process arena, and every detached arena; arenas
+//that are live on other threads are excluded. Peak sums the most bytes each of
+//those arenas has held at once, scratch regions included.
+void ArenaUsage(size_t *used, size_t *mapped, size_t *peak);
+
+//returns the bytes allocated by the thread-local arena and its open scratch
+//regions
+size_t ArenaUsed(void);
+
 __attribute__((always_inline))
 static inline void *allocate(size_t bytes)
 {
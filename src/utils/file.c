@@ -2,14 +2,21 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "arena.h"
 #include "file.h"
+#include "options.h"
 #include "xerror.h"
 
 static void FileClose(FILE **);
+static void FileDescriptorClose(int *);
+static bool ReadAll(int, char *, size_t);
 static cstring *cStringFromFile(FILE *);
 static size_t GetFileSize(FILE *);
 static cstring *GetFileName(const cstring *);
@@ -41,6 +48,150 @@ cstring *FileLoad(const cstring *name)
 	return src;
 }
 
+bool FileMap(const cstring *name, source *src)
+{
+	assert(name);
+	assert(src);
+
+	cstring *filename = FileGetDiskName(name);
+
+	__attribute__((cleanup(FileDescriptorClose)))
+	int fd = open(filename, O_RDONLY);
+
+	if (fd == -1) {
+		xerror_issue("%s: %s", filename, strerror(errno));
+		return false;
+	}
+
+	struct stat info;
+
+	if (fstat(fd, &info) == -1) {
+		xerror_issue("fstat: %s: %s", filename, strerror(errno));
+		return false;
+	}
+
+	if (info.st_size <= 0) {
+		xerror_issue("cannot calculate file size");
+		return false;
+	}
+
+	const size_t len = (size_t) info.st_size;
+	const long pagesize = sysconf(_SC_PAGESIZE);
+
+	//the terminator of a mapping is the zero fill after EOF in its last page,
+	//which a write to the file in place can overwrite, and a truncation turns
+	//every read past the new EOF into a SIGBUS. Under --Watch the files are
+	//being edited by design, so they are always copied; the copy may be torn
+	//by a concurrent write but is always terminated, and the write changes
+	//the stamp so that the module is compiled again.
+	const bool mappable = pagesize > 0 && len % (size_t) pagesize;
+
+	if (mappable && !OptionsWatch()) {
+		void *region = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (region != MAP_FAILED) {
+			//advisory only; the scanner reads the file front to back
+			(void) madvise(region, len, MADV_SEQUENTIAL);
+
+			*src = (source) {
+				.text = region,
+				.len = len,
+				.mapped = true
+			};
+
+			return true;
+		}
+
+		xerror_issue("mmap: %s: %s", filename, strerror(errno));
+	}
+
+	cstring *buffer = allocate(sizeof(char) * len + 1);
+
+	if (!ReadAll(fd, buffer, len)) {
+		const cstring *msg = "%s: cannot copy file to memory";
+		xerror_issue(msg, filename);
+		return false;
+	}
+
+	buffer[len] = '\0';
+
+	*src = (source) {
+		.text = buffer,
+		.len = len,
+		.mapped = false
+	};
+
+	return true;
+}
+
+void FileUnmap(source *src)
+{
+	assert(src);
+
+	if (src->mapped) {
+		int err = munmap(src->text, src->len);
+
+		if (err) {
+			xerror_issue("munmap: %s", strerror(errno));
+		}
+	}
+
+	*src = (source) {
+		.text = NULL,
+		.len = 0,
+		.mapped = false
+	};
+}
+
+void FilePrefetch(const cstring *name)
+{
+	assert(name);
+
+	cstring *filename = FileGetDiskName(name);
+
+	__attribute__((cleanup(FileDescriptorClose)))
+	int fd = open(filename, O_RDONLY);
+
+	if (fd != -1) {
+		(void) posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	}
+}
+
+stamp FileStamp(const cstring *path)
+{
+	assert(path);
+
+	stamp version = {
+		.inode = 0,
+		.size = 0,
+		.seconds = 0,
+		.nanoseconds = 0
+	};
+
+	struct stat info;
+
+	if (stat(path, &info) == -1) {
+		return version;
+	}
+
+	version = (stamp) {
+		.inode = (uint64_t) info.st_ino,
+		.size = (int64_t) info.st_size,
+		.seconds = (int64_t) info.st_mtim.tv_sec,
+		.nanoseconds = (int64_t) info.st_mtim.tv_nsec
+	};
+
+	return version;
+}
+
+bool FileStampMatch(const stamp a, const stamp b)
+{
+	return a.inode == b.inode
+	       && a.size == b.size
+	       && a.seconds == b.seconds
+	       && a.nanoseconds == b.nanoseconds;
+}
+
 cstring *FileGetDiskName(const cstring *name)
 {
 	if (HasExtension(name)) {
@@ -96,6 +247,38 @@ static void FileClose(FILE **handle)
 	}
 }
 
+//for use with gcc cleanup
+static void FileDescriptorClose(int *fd)
+{
+	if (*fd != -1) {
+		(void) close(*fd);
+	}
+}
+
+//returns false if the first len bytes of the file cannot be read into buffer
+static bool ReadAll(int fd, char *buffer, size_t len)
+{
+	assert(buffer);
+
+	while (len) {
+		ssize_t total_read = read(fd, buffer, len);
+
+		if (total_read == -1 && errno == EINTR) {
+			continue;
+		}
+
+		if (total_read <= 0) {
+			xerror_issue("read: %s", strerror(errno));
+			return false;
+		}
+
+		buffer += total_read;
+		len -= (size_t) total_read;
+	}
+
+	return true;
+}
+
 //on failure returns NULL, else returns a dynamically allocated cstring
 static cstring *cStringFromFile(FILE *openfile)
 {
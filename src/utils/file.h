@@ -5,16 +5,61 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "str.h"
 
+//source code mapped into memory by FileMap. The mapping is read-only and a null
+//terminator always follows the final byte of the file. When the file size is
+//an exact multiple of the page size there is no room for the terminator within
+//the mapping, so the file is instead copied into a padded arena buffer. The
+//terminator of a mapping only holds while the file is not modified in place,
+//so under --Watch every file is copied.
+typedef struct source {
+	cstring *text;
+	size_t len; //excludes the null terminator
+	bool mapped; //false if text is an arena copy
+} source;
+
 //load the file named fname into memory as a null-terminated dynamically
 //allocated C string. On failure returns NULL and errors are reported to
 //the xerror log.
 cstring *FileLoad(const cstring *name);
 
+//map the file named fname into memory; on failure returns false and errors are
+//reported to the xerror log. The text is valid until FileUnmap.
+bool FileMap(const cstring *name, source *src);
+
+//release a mapping created by FileMap; any pointers into the text are invalid
+//after this call, so everything derived from it must be copied beforehand.
+void FileUnmap(source *src);
+
+//asks the kernel to start reading the file named fname into the page cache and
+//returns without waiting for the read, so that a later FileMap of the file does
+//not block on the disk. Errors are ignored and left for FileMap to report.
+void FilePrefetch(const cstring *name);
+
 //adds the ".lem" extension to the input name and returns a dynamically
 //allocated cstring. If the extension already exists, a duplicate copy
 //of the input is returned.
 cstring *FileGetDiskName(const cstring *name);
+
+//identifies one version of a file on disk. An editor which saves by renaming a
+//new file over the old one changes the inode, and any other write changes the
+//modification time or the size. The stamp of a missing file is all zeros.
+typedef struct stamp {
+	uint64_t inode;
+	int64_t size;
+	int64_t seconds;
+	int64_t nanoseconds;
+} stamp;
+
+//returns the stamp of the file at path, which is used as given rather than
+//passed to FileGetDiskName. Errors are not reported to the xerror log since a
+//file which is being saved may be missing for a moment.
+stamp FileStamp(const cstring *path);
+
+//returns true if both stamps identify the same version of a file
+bool FileStampMatch(const stamp a, const stamp b);
@@ -0,0 +1,224 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "intern.h"
+#include "map.h"
+#include "xerror.h"
+
+#ifdef INTERN_TRACE
+	#define InternTrace(msg, ...) xerror_trace(msg, ##__VA_ARGS__)
+#else
+	#define InternTrace(msg, ...)
+#endif
+
+typedef struct entry entry;
+typedef struct shard shard;
+
+static void InitShards(void);
+static const cstring *Search(shard *, const char *, size_t, uint64_t);
+static const cstring *Store(shard *, const char *, size_t, uint64_t);
+static void Grow(shard *);
+
+//------------------------------------------------------------------------------
+//The table is split into shards by the top bits of the hash and each shard is
+//guarded by its own mutex, so parse workers seldom contend for a lock. A shard
+//is an open addressing hash table with linear probing. Strings are never
+//removed, so a shard has no tombstones and a probe ends at the first empty
+//slot. Each canonical string is stored after its hash and length in the
+//process arena, since a name outlives the compilation which first interned it
+//when --Watch compiles the modules again.
+
+#define INTERN_SHARD_BITS 6
+#define INTERN_SHARDS ((size_t) 1 << INTERN_SHARD_BITS)
+#define INTERN_SHARD_CAPACITY ((size_t) 256)
+
+//identifiers repeat heavily within a module, so each thread remembers the last
+//string it interned in each of INTERN_CACHE buckets and only takes a shard lock
+//on a miss. Canonical strings are immutable, so the cache needs no lock.
+#define INTERN_CACHE ((size_t) 1024)
+
+struct entry {
+	const cstring *cstr;
+	uint64_t hash;
+	size_t len;
+};
+
+struct shard {
+	pthread_mutex_t mutex;
+	size_t len;
+	size_t cap;
+	entry *buffer;
+};
+
+//the hash and length are stored immediately before the characters
+typedef struct header {
+	uint64_t hash;
+	size_t len;
+	char data[];
+} header;
+
+static shard shards[INTERN_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+static __thread const header *cache[INTERN_CACHE];
+
+//------------------------------------------------------------------------------
+
+static void InitShards(void)
+{
+	for (size_t i = 0; i < INTERN_SHARDS; i++) {
+		shard *s = shards + i;
+
+		int err = pthread_mutex_init(&s->mutex, NULL);
+
+		if (err) {
+			xerror_fatal("cannot initialize intern table");
+			abort();
+		}
+
+		s->len = 0;
+		s->cap = 0;
+		s->buffer = NULL;
+	}
+}
+
+const cstring *Intern(const char *data, const size_t len)
+{
+	assert(data);
+
+	const uint64_t hash = MapHashView(data, len);
+	const header **recent = cache + (hash & (INTERN_CACHE - 1));
+
+	if (*recent && (*recent)->hash == hash && (*recent)->len == len
+	    && !memcmp((*recent)->data, data, len)) {
+		return (*recent)->data;
+	}
+
+	(void) pthread_once(&shards_once, InitShards);
+
+	shard *s = shards + (hash >> (64 - INTERN_SHARD_BITS));
+
+	pthread_mutex_lock(&s->mutex);
+
+	const cstring *cstr = Search(s, data, len, hash);
+
+	if (!cstr) {
+		ArenaShare();
+		cstr = Store(s, data, len, hash);
+		ArenaUnshare();
+	}
+
+	pthread_mutex_unlock(&s->mutex);
+
+	*recent = (const header *) (cstr - offsetof(header, data));
+
+	return cstr;
+}
+
+const cstring *InternString(const cstring *cstr)
+{
+	assert(cstr);
+
+	return Intern(cstr, strlen(cstr));
+}
+
+uint64_t InternHash(const cstring *cstr)
+{
+	assert(cstr);
+
+	const header *head = (const header *) (cstr - offsetof(header, data));
+
+	//not checked against MapHash here since that would make the call linear;
+	//the hashed map lookups which consume the result assert it instead
+	return head->hash;
+}
+
+//------------------------------------------------------------------------------
+//inner functions assume the shard mutex is held
+
+//the slot index uses the low bits of the hash since the high bits pick a shard
+static const cstring *Search(shard *s, const char *data, size_t len,
+			     uint64_t hash)
+{
+	if (!s->cap) {
+		return NULL;
+	}
+
+	size_t i = hash & (s->cap - 1);
+
+	while (s->buffer[i].cstr) {
+		const entry *e = s->buffer + i;
+
+		if (e->hash == hash && e->len == len
+		    && !memcmp(e->cstr, data, len)) {
+			return e->cstr;
+		}
+
+		i = (i + 1) & (s->cap - 1);
+	}
+
+	return NULL;
+}
+
+static const cstring *Store(shard *s, const char *data, size_t len,
+			    uint64_t hash)
+{
+	//keep the load factor at or below one half
+	if (2 * (s->len + 1) > s->cap) {
+		Grow(s);
+	}
+
+	header *head = allocate(sizeof(header) + len + 1);
+	head->hash = hash;
+	head->len = len;
+	memcpy(head->data, data, len);
+	head->data[len] = '\0';
+
+	size_t i = hash & (s->cap - 1);
+
+	while (s->buffer[i].cstr) {
+		i = (i + 1) & (s->cap - 1);
+	}
+
+	s->buffer[i] = (entry) {
+		.cstr = head->data,
+		.hash = hash,
+		.len = len
+	};
+
+	s->len++;
+
+	InternTrace("interned '%s'", head->data);
+
+	return head->data;
+}
+
+//the old buffer is abandoned to the arena
+static void Grow(shard *s)
+{
+	const size_t cap = s->cap ? s->cap * 2 : INTERN_SHARD_CAPACITY;
+	entry *buffer = allocate(cap * sizeof(entry));
+
+	for (size_t j = 0; j < s->cap; j++) {
+		const entry e = s->buffer[j];
+
+		if (!e.cstr) {
+			continue;
+		}
+
+		size_t i = e.hash & (cap - 1);
+
+		while (buffer[i].cstr) {
+			i = (i + 1) & (cap - 1);
+		}
+
+		buffer[i] = e;
+	}
+
+	s->cap = cap;
+	s->buffer = buffer;
+}
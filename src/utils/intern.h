@@ -0,0 +1,26 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// The intern table maps every distinct string to one canonical, immutable copy
+// which lives until ArenaFree. Identifiers, module names, and type strings are
+// interned as they are created, so two interned strings are equal if and only
+// if they are the same pointer, and the maps keyed on them can store the key
+// without copying it. Each interned string carries its MapHash so that symbol
+// table lookups never rehash an identifier.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "str.h"
+
+//thread-safe; returns the canonical copy of the len bytes at data, which must
+//not contain a null character
+const cstring *Intern(const char *data, const size_t len);
+
+//thread-safe; returns the canonical copy of the string
+const cstring *InternString(const cstring *cstr);
+
+//returns MapHash(cstr) in constant time; cstr must have been returned by Intern
+//or InternString
+uint64_t InternHash(const cstring *cstr);
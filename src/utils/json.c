@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "arena.h"
 #include "json.h"
@@ -20,6 +21,11 @@ static void SerializeString(json *, const cstring *);
 static void SerializeNumber(json *, const int64_t);
 static void SerializeBoolean(json *, bool);
 static void SerializeNull(json *);
+static void WriterPut(json_writer *, const char *, size_t);
+static void WriterPutChar(json_writer *, const char);
+static void WriterNextLine(json_writer *);
+static void WriterItem(json_writer *);
+static void WriterFlush(json_writer *);
 
 //------------------------------------------------------------------------------
 
@@ -182,23 +188,23 @@ static void SerializeObject(json *self, const json_object *object)
 	vStringAppend(&self->vstr, '{');
 	self->indent++;
 
-	map(JsonValue) map = object->values;
+	const map(JsonValue) *map = &object->values;
 	size_t items_placed = 0;
 
-	for (size_t i = 0; i < map.cap; i++) {
-		if (map.buffer[i].status != SLOT_CLOSED) {
-			continue;
-		}
+	uint64_t cursor = 0;
+	const cstring *key = NULL;
+	json_value value = {0};
 
+	while (JsonValueMapNext(map, &cursor, &key, &value)) {
 		if (items_placed != 0) {
 			vStringAppend(&self->vstr, ',');
 		}
 
 		StartNextLine(self);
 
-		PutJsonString(self, map.buffer[i].key);
+		PutJsonString(self, key);
 		vStringAppendcString(&self->vstr, ": ");
-		Dispatch(self, map.buffer[i].value);
+		Dispatch(self, value);
 
 		items_placed++;
 	}
@@ -270,3 +276,197 @@ static void SerializeNull(json *self)
 
 	vStringAppendcString(&self->vstr, "null");
 }
+
+//------------------------------------------------------------------------------
+//streaming writer
+
+void JsonWriterInit(json_writer *self, FILE *stream)
+{
+	assert(self);
+	assert(stream);
+
+	self->stream = stream;
+	self->len = 0;
+	self->indent = 0;
+	self->fresh = true;
+	self->keyed = false;
+}
+
+static void WriterFlush(json_writer *self)
+{
+	assert(self);
+
+	if (self->len) {
+		(void) fwrite(self->buffer, sizeof(char), self->len, self->stream);
+		self->len = 0;
+	}
+}
+
+static void WriterPut(json_writer *self, const char *data, size_t len)
+{
+	assert(self);
+	assert(data);
+
+	if (self->len + len > JSON_WRITER_BUFFER) {
+		WriterFlush(self);
+
+		if (len > JSON_WRITER_BUFFER) {
+			(void) fwrite(data, sizeof(char), len, self->stream);
+			return;
+		}
+	}
+
+	memcpy(self->buffer + self->len, data, len);
+	self->len += len;
+}
+
+static void WriterPutChar(json_writer *self, const char ch)
+{
+	assert(self);
+
+	if (self->len == JSON_WRITER_BUFFER) {
+		WriterFlush(self);
+	}
+
+	self->buffer[self->len++] = ch;
+}
+
+static void WriterNextLine(json_writer *self)
+{
+	assert(self);
+
+	WriterPutChar(self, '\n');
+
+	for (size_t i = 0; i < self->indent; i++) {
+		WriterPut(self, "    ", 4);
+	}
+}
+
+//every value is an item of its container unless it completes a key-value pair;
+//as in the serialiser, array items are separated by commas but not newlines
+static void WriterItem(json_writer *self)
+{
+	assert(self);
+
+	if (self->keyed) {
+		self->keyed = false;
+		return;
+	}
+
+	if (!self->fresh) {
+		WriterPutChar(self, ',');
+	}
+
+	self->fresh = false;
+}
+
+void JsonWriterObjectBegin(json_writer *self)
+{
+	WriterItem(self);
+	WriterPutChar(self, '{');
+
+	self->indent++;
+	self->fresh = true;
+}
+
+void JsonWriterObjectEnd(json_writer *self)
+{
+	assert(self);
+	assert(self->indent);
+	assert(!self->keyed);
+
+	self->indent--;
+	self->fresh = false;
+
+	WriterNextLine(self);
+	WriterPutChar(self, '}');
+}
+
+void JsonWriterArrayBegin(json_writer *self)
+{
+	WriterItem(self);
+	WriterPutChar(self, '[');
+
+	self->indent++;
+	self->fresh = true;
+}
+
+void JsonWriterArrayEnd(json_writer *self)
+{
+	assert(self);
+	assert(self->indent);
+	assert(!self->keyed);
+
+	self->indent--;
+	self->fresh = false;
+
+	WriterNextLine(self);
+	WriterPutChar(self, ']');
+}
+
+void JsonWriterKey(json_writer *self, const cstring *key)
+{
+	assert(self);
+	assert(key);
+	assert(!self->keyed);
+
+	WriterItem(self);
+	WriterNextLine(self);
+
+	WriterPutChar(self, '"');
+	WriterPut(self, key, strlen(key));
+	WriterPut(self, "\": ", 3);
+
+	self->keyed = true;
+}
+
+void JsonWriterString(json_writer *self, const cstring *cstr)
+{
+	assert(cstr);
+
+	WriterItem(self);
+
+	WriterPutChar(self, '"');
+	WriterPut(self, cstr, strlen(cstr));
+	WriterPutChar(self, '"');
+}
+
+void JsonWriterNumber(json_writer *self, const int64_t number)
+{
+	char digits[32] = {0};
+
+	int len = snprintf(digits, sizeof(digits), "%" PRId64 "", number);
+	assert(len > 0 && (size_t) len < sizeof(digits));
+
+	WriterItem(self);
+	WriterPut(self, digits, (size_t) len);
+}
+
+void JsonWriterBoolean(json_writer *self, bool flag)
+{
+	WriterItem(self);
+
+	if (flag) {
+		WriterPut(self, "true", 4);
+	} else {
+		WriterPut(self, "false", 5);
+	}
+}
+
+void JsonWriterNull(json_writer *self)
+{
+	WriterItem(self);
+	WriterPut(self, "null", 4);
+}
+
+bool JsonWriterFinish(json_writer *self)
+{
+	assert(self);
+	assert(self->indent == 0);
+	assert(!self->keyed);
+
+	WriterPutChar(self, '\n');
+	WriterFlush(self);
+
+	return fflush(self->stream) == 0 && !ferror(self->stream);
+}
@@ -2,12 +2,16 @@
 //
 // This API provides JSON serialisation utility functions. Application code may
 // use the API to construct JSON parse trees, which can be serialised to C null
-// terminated strings.
+// terminated strings, or it may stream a document directly to a file with the
+// writer API when the document is too large to hold in memory.
 
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
+#include "arena.h"
 #include "map.h"
 #include "str.h"
 #include "vector.h"
@@ -35,7 +39,7 @@ struct json_value {
 	union {
 		json_object *object;
 		json_array *array;
-		cstring *string;
+		const cstring *string;
 		int64_t number;
 	};
 };
@@ -72,3 +76,41 @@ void JsonArrayAdd(json_array *array, json_value value);
 
 cstring *JsonSerializeObject(const json_object *object);
 cstring *JsonSerializeArray(const json_array *array);
+
+//------------------------------------------------------------------------------
+//the writer emits JSON text with the same layout as the serialiser as soon as
+//each value is known; output is staged in a fixed-size buffer which is written
+//to the stream whenever it fills. The caller is responsible for well-formedness.
+//Object keys are emitted in the order they are given.
+
+#define JSON_WRITER_BUFFER KiB(4)
+
+//@fresh: the innermost open object or array has no items yet
+//@keyed: a key has been emitted and its value is pending
+typedef struct json_writer {
+	FILE *stream;
+	size_t len;
+	size_t indent;
+	bool fresh;
+	bool keyed;
+	char buffer[JSON_WRITER_BUFFER];
+} json_writer;
+
+void JsonWriterInit(json_writer *self, FILE *stream);
+
+void JsonWriterObjectBegin(json_writer *self);
+void JsonWriterObjectEnd(json_writer *self);
+void JsonWriterArrayBegin(json_writer *self);
+void JsonWriterArrayEnd(json_writer *self);
+
+//must be followed by exactly one value
+void JsonWriterKey(json_writer *self, const cstring *key);
+
+void JsonWriterString(json_writer *self, const cstring *cstr);
+void JsonWriterNumber(json_writer *self, const int64_t number);
+void JsonWriterBoolean(json_writer *self, bool flag);
+void JsonWriterNull(json_writer *self);
+
+//terminate the document with a newline and flush the buffer; returns false if
+//the stream reports an error
+bool JsonWriterFinish(json_writer *self);
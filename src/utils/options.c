@@ -27,10 +27,22 @@ struct options {
 		unsigned int tokens : 1;
 		unsigned int dependencies : 1;
 		unsigned int symbols : 1;
+		unsigned int stats : 1;
+		unsigned int profile : 1;
 	} diagnostic;
 	struct {
 		size_t arena_default;
 	} memory;
+	struct {
+		size_t threads;
+		size_t pipeline;
+	} concurrency;
+	struct {
+		const cstring *directory;
+	} cache;
+	struct {
+		unsigned int enabled : 1;
+	} watch;
 };
 
 static options opt = {
@@ -38,13 +50,32 @@ static options opt = {
 		.state = 0,
 		.tokens = 0,
 		.dependencies = 0,
-		.symbols = 0
+		.symbols = 0,
+		.stats = 0,
+		.profile = 0
 	},
 	.memory = {
 		.arena_default = MiB(1)
+	},
+	.concurrency = {
+		.threads = 1,
+		.pipeline = KiB(64)
+	},
+	.cache = {
+		.directory = NULL
+	},
+	.watch = {
+		.enabled = 0
 	}
 };
 
+//the parse and resolve worker pools must fit within the CException frame stacks
+//of the config file CExceptionConfig.h along with the main thread
+#define THREADS_MAX 32
+
+//the scanner pipeline threshold is given in KiB and may not exceed 1 GiB
+#define PIPELINE_MAX 1048576
+
 //------------------------------------------------------------------------------
 //gnu argp
 
@@ -52,6 +83,9 @@ enum argp_groups {
 	group_default = 0,
 	group_diagnostic,
 	group_memory,
+	group_concurrency,
+	group_cache,
+	group_watch,
 };
 
 enum argp_keys {
@@ -59,13 +93,21 @@ enum argp_keys {
 	key_diagnostic_tokens = 257,
 	key_diagnostic_dependencies = 258,
 	key_diagnostic_symbols = 259,
+	key_diagnostic_stats = 260,
+	key_diagnostic_profile = 261,
 	key_arena_default = 'a',
+	key_threads = 't',
+	key_pipeline = 'p',
+	key_cache = 'c',
+	key_watch = 'w',
 };
 
 const cstring *argp_program_version = LEMON_VERSION;
 const cstring *argp_program_bug_address = "github.com/birendpatel/lemon/issues";
-static char args_doc[] = "[filename]";
-static char doc[] = "\nThis is the C Lemon compiler for the Lemon language.";
+static char args_doc[] = "[filename...]";
+static char doc[] = "\nThis is the C Lemon compiler for the Lemon language. "
+		    "Every filename is a root module and all of them are "
+		    "compiled together; the default root is main.";
 
 static argp_option options_info[] = {
 	{
@@ -92,13 +134,52 @@ static argp_option options_info[] = {
 		.doc   = "Print the symbol table parent pointer tree.",
 		.group = group_diagnostic
 	},
+	{
+		.name  = "Dstats",
+		.key   = key_diagnostic_stats,
+		.doc   = "Print front-end throughput statistics as JSON.",
+		.group = group_diagnostic
+	},
+	{
+		.name  = "Dprofile",
+		.key   = key_diagnostic_profile,
+		.doc   = "Print time and memory used per phase and module as JSON.",
+		.group = group_diagnostic
+	},
 	{
 		.name  = "Arena",
 		.key   = key_arena_default,
 		.arg   = "megabytes",
-		.doc   = "Set the default arena size up to 1 GiB.",
+		.doc   = "Set the initial arena block size up to 1 GiB.",
 		.group = group_memory
 	},
+	{
+		.name  = "Threads",
+		.key   = key_threads,
+		.arg   = "count",
+		.doc   = "Parse and resolve modules with up to 32 worker threads.",
+		.group = group_concurrency
+	},
+	{
+		.name  = "Pipeline",
+		.key   = key_pipeline,
+		.arg   = "KiB",
+		.doc   = "Scan files of at least this size on a separate thread.",
+		.group = group_concurrency
+	},
+	{
+		.name  = "Cache",
+		.key   = key_cache,
+		.arg   = "directory",
+		.doc   = "Reuse the syntax trees of unchanged files across runs.",
+		.group = group_cache
+	},
+	{
+		.name  = "Watch",
+		.key   = key_watch,
+		.doc   = "Compile again whenever a module file changes.",
+		.group = group_watch
+	},
 
 	{0} //terminator required by GNU argp
 };
@@ -122,6 +203,14 @@ static error_t Parser(int key, char *arg, unused argp_state *state)
 		opt.diagnostic.symbols = 1;
 		break;
 
+	case key_diagnostic_stats:
+		opt.diagnostic.stats = 1;
+		break;
+
+	case key_diagnostic_profile:
+		opt.diagnostic.profile = 1;
+		break;
+
 	case key_arena_default: /* label bypass */ ;
 		char *endptr = NULL;
 		double value = strtod(arg, &endptr);
@@ -139,6 +228,53 @@ static error_t Parser(int key, char *arg, unused argp_state *state)
 		
 		break;
 
+	case key_pipeline: /* label bypass */ ;
+		char *last = NULL;
+		unsigned long kibibytes = strtoul(arg, &last, 10);
+
+		const cstring *msg5 = "bad pipeline size; using default";
+		const cstring *msg6 = "pipeline size out of range; using default";
+
+		if (arg == last || *last != '\0') {
+			xuser_warn(NULL, 0, msg5);
+		} else if (kibibytes > PIPELINE_MAX) {
+			xuser_warn(NULL, 0, msg6);
+		} else {
+			opt.concurrency.pipeline = KiB((size_t) kibibytes);
+		}
+
+		break;
+
+	case key_threads: /* label bypass */ ;
+		char *end = NULL;
+		unsigned long count = strtoul(arg, &end, 10);
+
+		const cstring *msg3 = "bad thread count; using default";
+		const cstring *msg4 = "thread count out of range; using default";
+
+		if (arg == end || *end != '\0') {
+			xuser_warn(NULL, 0, msg3);
+		} else if (count == 0 || count > THREADS_MAX) {
+			xuser_warn(NULL, 0, msg4);
+		} else {
+			opt.concurrency.threads = (size_t) count;
+		}
+
+		break;
+
+	case key_cache:
+		if (*arg == '\0') {
+			xuser_warn(NULL, 0, "empty cache directory; cache disabled");
+		} else {
+			opt.cache.directory = arg;
+		}
+
+		break;
+
+	case key_watch:
+		opt.watch.enabled = 1;
+		break;
+
 	default:
 		return ARGP_ERR_UNKNOWN;
 		break;
@@ -201,14 +337,22 @@ void OptionsDstate(void)
 		"Dstate: %d\n"
 		"Dtokens: %d\n"
 		"Ddeps: %d\n"
-		"Arena: %zu\n";
+		"Arena: %zu\n"
+		"Threads: %zu\n"
+		"Pipeline: %zu\n"
+		"Cache: %s\n"
+		"Watch: %d\n";
 
 	fprintf(stderr,
 		fmt,
 		(int) opt.diagnostic.state,
 		(int) OptionsDtokens(),
 		(int) OptionsDdeps(),
-		OptionsArena());
+		OptionsArena(),
+		OptionsThreads(),
+		OptionsPipeline(),
+		OptionsCache() ? OptionsCache() : "(none)",
+		(int) OptionsWatch());
 }
 
 bool OptionsDtokens(void)
@@ -226,7 +370,37 @@ bool OptionsDsym(void)
 	return opt.diagnostic.symbols;
 }
 
+bool OptionsDstats(void)
+{
+	return opt.diagnostic.stats;
+}
+
+bool OptionsDprofile(void)
+{
+	return opt.diagnostic.profile;
+}
+
 size_t OptionsArena(void)
 {
 	return opt.memory.arena_default;
 }
+
+size_t OptionsThreads(void)
+{
+	return opt.concurrency.threads;
+}
+
+size_t OptionsPipeline(void)
+{
+	return opt.concurrency.pipeline;
+}
+
+const cstring *OptionsCache(void)
+{
+	return opt.cache.directory;
+}
+
+bool OptionsWatch(void)
+{
+	return opt.watch.enabled;
+}
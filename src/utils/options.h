@@ -8,6 +8,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+#include "str.h"
+
 //------------------------------------------------------------------------------
 //on success returns true and modifies argv/argc such that (*argv)[0] thru
 //(*argv)[argc - 1] are the unparsed elements (if any) and (*argv)[argc] is
@@ -28,5 +30,16 @@ bool OptionsDdeps(void); //true if --Ddeps
 
 bool OptionsDsym(void); //true if --Dsym
 
+bool OptionsDstats(void); //true if --Dstats
+
+bool OptionsDprofile(void); //true if --Dprofile
+
 size_t OptionsArena(void); //returns a default size if --Arena not specified
 
+size_t OptionsThreads(void); //returns 1 if --Threads not specified
+
+size_t OptionsPipeline(void); //returns a default size if --Pipeline not given
+
+const cstring *OptionsCache(void); //returns NULL if --Cache not specified
+
+bool OptionsWatch(void); //true if --Watch
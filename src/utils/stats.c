@@ -0,0 +1,301 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "arena.h"
+#include "json.h"
+#include "map.h"
+#include "options.h"
+#include "stats.h"
+#include "xerror.h"
+
+typedef struct profile profile;
+
+static void PrintStatistics(void);
+static void PrintProfile(void);
+static json_object *SerializeProfile(const profile *);
+static void AddNumber(json_object *, const cstring *, const size_t);
+
+//------------------------------------------------------------------------------
+//counters are only read after every worker thread has been joined, so relaxed
+//ordering is sufficient for both the additions and the final loads
+
+static atomic_size_t counters[STAT_TOTAL];
+static atomic_uint_fast64_t stopwatches[WATCH_TOTAL];
+
+static const cstring *counter_names[STAT_TOTAL] = {
+	[STAT_MODULES] = "modules",
+	[STAT_TOKENS] = "tokens",
+	[STAT_NODES] = "nodes",
+	[STAT_SYMBOLS] = "symbols"
+};
+
+static const cstring *stopwatch_names[WATCH_TOTAL] = {
+	[WATCH_FRONTEND] = "frontend_ns",
+	[WATCH_SYMBOLS] = "symbols_ns"
+};
+
+//------------------------------------------------------------------------------
+//the ledger holds the phase totals and one profile per module; it is guarded by
+//a mutex because parse workers charge their modules concurrently. The profiles
+//are kept in the process arena since under --Watch they sum every compilation.
+
+struct profile {
+	sample phases[PHASE_TOTAL];
+};
+
+make_map(profile, Profile, static)
+
+static struct {
+	pthread_mutex_t mutex;
+	profile total;
+	map(Profile) modules;
+} ledger = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.total = {{{0}}},
+	.modules = {0}
+};
+
+static const cstring *phase_names[PHASE_TOTAL] = {
+	[PHASE_LOAD] = "load",
+	[PHASE_CACHE] = "cache",
+	[PHASE_SCAN] = "scan",
+	[PHASE_PARSE] = "parse",
+	[PHASE_SORT] = "sort",
+	[PHASE_SYMBOLS] = "symbols",
+	[PHASE_JSON] = "json"
+};
+
+//------------------------------------------------------------------------------
+
+void StatsCount(const statistic stat, const size_t n)
+{
+	assert(stat < STAT_TOTAL);
+
+	atomic_fetch_add_explicit(&counters[stat], n, memory_order_relaxed);
+}
+
+uint64_t StatsClock(void)
+{
+	struct timespec now = {0};
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+		xerror_issue("cannot read monotonic clock");
+		return 0;
+	}
+
+	const uint64_t seconds = (uint64_t) now.tv_sec;
+	const uint64_t nanoseconds = (uint64_t) now.tv_nsec;
+
+	return seconds * 1000000000 + nanoseconds;
+}
+
+void StatsTime(const stopwatch watch, const uint64_t start)
+{
+	assert(watch < WATCH_TOTAL);
+
+	const uint64_t elapsed = StatsClock() - start;
+	const memory_order relaxed = memory_order_relaxed;
+
+	atomic_fetch_add_explicit(&stopwatches[watch], elapsed, relaxed);
+}
+
+sample StatsSample(void)
+{
+	return (sample) {
+		.time = StatsClock(),
+		.bytes = ArenaUsed()
+	};
+}
+
+sample StatsSince(const sample start)
+{
+	const sample now = StatsSample();
+
+	return (sample) {
+		.time = now.time - start.time,
+		.bytes = now.bytes - start.bytes
+	};
+}
+
+void StatsProfile(const cstring *module, const phase stage, const sample cost)
+{
+	assert(stage < PHASE_TOTAL);
+
+	if (!OptionsDprofile()) {
+		return;
+	}
+
+	pthread_mutex_lock(&ledger.mutex);
+
+	ledger.total.phases[stage].time += cost.time;
+	ledger.total.phases[stage].bytes += cost.bytes;
+
+	if (module) {
+		ArenaShare();
+
+		if (!ledger.modules.buffer) {
+			ledger.modules = ProfileMapInit(MAP_DEFAULT_CAPACITY);
+		}
+
+		profile *entry = NULL;
+
+		if (!ProfileMapGetRef(&ledger.modules, module, &entry)) {
+			const profile empty = {{{0}}};
+			entry = ProfileMapInsert(&ledger.modules, module, empty);
+		}
+
+		entry->phases[stage].time += cost.time;
+		entry->phases[stage].bytes += cost.bytes;
+
+		ArenaUnshare();
+	}
+
+	pthread_mutex_unlock(&ledger.mutex);
+}
+
+//------------------------------------------------------------------------------
+
+//the reports are built in a scratch region since nothing outlives them
+void StatsPrint(void)
+{
+	if (!OptionsDstats() && !OptionsDprofile()) {
+		return;
+	}
+
+	ArenaPush();
+
+	if (OptionsDstats()) {
+		PrintStatistics();
+	}
+
+	if (OptionsDprofile()) {
+		PrintProfile();
+	}
+
+	ArenaPop();
+}
+
+static void PrintStatistics(void)
+{
+	size_t used = 0;
+	size_t mapped = 0;
+	size_t peak = 0;
+
+	//sampled before the report allocates anything
+	ArenaUsage(&used, &mapped, &peak);
+
+	json_object *object = JsonObjectInit();
+
+	for (size_t i = 0; i < STAT_TOTAL; i++) {
+		const size_t count = atomic_load(&counters[i]);
+		AddNumber(object, counter_names[i], count);
+	}
+
+	for (size_t i = 0; i < WATCH_TOTAL; i++) {
+		const uint64_t elapsed = atomic_load(&stopwatches[i]);
+		AddNumber(object, stopwatch_names[i], (size_t) elapsed);
+	}
+
+	AddNumber(object, "arena_used", used);
+	AddNumber(object, "arena_mapped", mapped);
+	AddNumber(object, "arena_peak", peak);
+
+	const cstring *json = JsonSerializeObject(object);
+
+	if (!json) {
+		xerror_issue("cannot serialize statistics");
+		return;
+	}
+
+	puts(json);
+}
+
+//worker threads have been joined by now, but the lock is cheap insurance
+static void PrintProfile(void)
+{
+	pthread_mutex_lock(&ledger.mutex);
+
+	json_object *object = JsonObjectInit();
+	json_object *modules = JsonObjectInit();
+
+	uint64_t cursor = 0;
+	const cstring *name = NULL;
+	profile record = {{{0}}};
+
+	while (ProfileMapNext(&ledger.modules, &cursor, &name, &record)) {
+		json_value value = {
+			.tag = JSON_VALUE_OBJECT,
+			.object = SerializeProfile(&record)
+		};
+
+		(void) JsonObjectAdd(modules, name, value);
+	}
+
+	json_value phases = {
+		.tag = JSON_VALUE_OBJECT,
+		.object = SerializeProfile(&ledger.total)
+	};
+
+	json_value children = {
+		.tag = JSON_VALUE_OBJECT,
+		.object = modules
+	};
+
+	(void) JsonObjectAdd(object, "phases", phases);
+	(void) JsonObjectAdd(object, "modules", children);
+
+	pthread_mutex_unlock(&ledger.mutex);
+
+	const cstring *json = JsonSerializeObject(object);
+
+	if (!json) {
+		xerror_issue("cannot serialize profile");
+		return;
+	}
+
+	puts(json);
+}
+
+//returns {"load": {"ns": 0, "bytes": 0}, "scan": ...}
+static json_object *SerializeProfile(const profile *record)
+{
+	assert(record);
+
+	json_object *object = JsonObjectInit();
+
+	for (size_t i = 0; i < PHASE_TOTAL; i++) {
+		json_object *cost = JsonObjectInit();
+
+		AddNumber(cost, "ns", (size_t) record->phases[i].time);
+		AddNumber(cost, "bytes", record->phases[i].bytes);
+
+		json_value value = {
+			.tag = JSON_VALUE_OBJECT,
+			.object = cost
+		};
+
+		(void) JsonObjectAdd(object, phase_names[i], value);
+	}
+
+	return object;
+}
+
+static void AddNumber(json_object *object, const cstring *key, const size_t n)
+{
+	assert(object);
+	assert(key);
+
+	json_value value = {
+		.tag = JSON_VALUE_NUMBER,
+		.number = (int64_t) n
+	};
+
+	__attribute__((unused)) bool ok = JsonObjectAdd(object, key, value);
+
+	assert(ok && "duplicate statistic");
+}
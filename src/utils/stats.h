@@ -0,0 +1,82 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// The stats module collects front-end throughput counters for the --Dstats
+// diagnostic and per-phase, per-module costs for the --Dprofile diagnostic.
+// Compiler phases accumulate counts in their own state and report them once
+// per module or per phase, so that the process-wide atomic counters are never
+// touched on a hot path.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "str.h"
+
+typedef enum statistic {
+	STAT_MODULES,
+	STAT_TOKENS,
+	STAT_NODES,
+	STAT_SYMBOLS,
+	STAT_TOTAL
+} statistic;
+
+//the front end stopwatch covers file loading, scanning, parsing, and the
+//dependency sort, which overlap in time when modules are parsed concurrently
+typedef enum stopwatch {
+	WATCH_FRONTEND,
+	WATCH_SYMBOLS,
+	WATCH_TOTAL
+} stopwatch;
+
+//thread-safe; adds n to the statistic
+void StatsCount(const statistic stat, const size_t n);
+
+//returns a monotonic timestamp in nanoseconds
+uint64_t StatsClock(void);
+
+//thread-safe; adds the nanoseconds elapsed since start to the stopwatch
+void StatsTime(const stopwatch watch, const uint64_t start);
+
+//------------------------------------------------------------------------------
+//the load, scan, and parse phases partition the time it takes to build the AST
+//of a module. When the module is scanned on a pipeline thread the scan phase is
+//the time that the parser stalled while it waited for tokens. Phase totals are
+//summed over all modules, so with --Threads they may exceed the wall time.
+//Under --Cache the cache phase is the time spent hashing the source and then
+//loading its tree from the cache, or storing the tree after a parse.
+
+typedef enum phase {
+	PHASE_LOAD,
+	PHASE_CACHE,
+	PHASE_SCAN,
+	PHASE_PARSE,
+	PHASE_SORT,
+	PHASE_SYMBOLS,
+	PHASE_JSON,
+	PHASE_TOTAL
+} phase;
+
+//a point in time and the thread-local arena usage at that point, or the
+//difference between two such points
+typedef struct sample {
+	uint64_t time;
+	size_t bytes;
+} sample;
+
+//returns the current time and thread-local arena usage
+sample StatsSample(void);
+
+//returns the time and thread-local arena bytes consumed since start
+sample StatsSince(const sample start);
+
+//thread-safe; charges the cost to the phase and, unless the module name is
+//NULL, to the module as well; no-op unless --Dprofile. The name is not copied,
+//so it must be interned or otherwise live until exit.
+void StatsProfile(const cstring *module, const phase stage, const sample cost);
+
+//------------------------------------------------------------------------------
+
+//prints the statistics and the arena usage to stdout as JSON if --Dstats and
+//then the profile as JSON if --Dprofile; must be called before ArenaFree
+void StatsPrint(void);
@@ -1,20 +1,33 @@
 // Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
 
 #include <assert.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "xerror.h"
 
+typedef struct message message;
+typedef struct ring ring;
+
 static const cstring *GetLevelName(const int);
 static void XerrorFlush__unsafe(void);
+static void XerrorTryFlush(void);
+static void PrintMessage(const message *, const size_t);
 static const cstring *RemoveFilePath(const cstring *);
-static void NewThreadID__unsafe(void);
-static size_t GetThreadID__unsafe(void);
+static size_t GetThreadID(void);
+static ring *GetRing(void);
+static ring *AdoptRing(void);
+static void InitRingKey(void);
+static void RetireRing(void *);
+static uint64_t GetTimestamp(void);
 
 //colours provided by @gon1332 at stackoverflow.com/questions/2616906/
 #ifdef COLOURS
@@ -61,31 +74,157 @@ static size_t GetThreadID__unsafe(void);
 #endif
 
 //------------------------------------------------------------------------------
-//A single queue is shared between all threads, rather than one queue per thread
-//local storage. Although there may be some mutex contention, a single queue 
-//means we can deliver the messages to stderr in psuedo-chronological order.
+//Each thread logs to its own ring buffer, so logging never takes a lock. The
+//owning thread is the only producer and the thread which holds the flush mutex
+//is the only consumer. Every message is stamped with the monotonic clock, and a
+//flush merges the rings in timestamp order, so the messages from all threads
+//are delivered to stderr in pseudo-chronological order.
+//
+//Rings are allocated on the first message of each thread and pushed onto a
+//lock-free list. They are never freed, so the messages of a thread which has
+//exited are still delivered by the next flush. Instead the destructor of a
+//pthread key retires the ring of an exiting thread, and a thread which logs for
+//the first time adopts a retired ring once all of its messages are flushed.
+//The list is therefore bounded by the threads which are alive at once rather
+//than every thread that the process has ever created.
 
 #define HEADER_LIMIT	64
 #define BODY_LIMIT      128
 #define BUFFER_CAPACITY 64
 
-typedef struct message {
+struct message {
+	uint64_t stamp;
 	char header[HEADER_LIMIT];
 	char body[BODY_LIMIT];
-} message;
+};
 
-typedef struct xerror_queue {
-	pthread_mutex_t mutex;
-	size_t len;
+//@head: first unflushed message; written by the consumer
+//@tail: one past the last message; written by the producer
+//@cursor: next message to merge; used by the consumer only
+//@limit: tail at the start of the current flush; used by the consumer only
+//@retired: set once the owner has exited; cleared by the thread which adopts it
+struct ring {
+	atomic_size_t head;
+	atomic_size_t tail;
+	atomic_bool retired;
+	size_t thread;
+	size_t cursor;
+	size_t limit;
+	ring *next;
 	message buffer[BUFFER_CAPACITY];
-} xerror_queue;
-
-static xerror_queue xqueue = {
-	.mutex = PTHREAD_MUTEX_INITIALIZER,
-	.len = 0,
-	.buffer = {{{0}, {0}}}
 };
 
+static _Atomic(ring *) rings = NULL;
+static pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread ring *local_ring = NULL;
+
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static bool ring_key_ready = false;
+
+//returns NULL if the ring cannot be allocated
+static ring *GetRing(void)
+{
+	if (local_ring) {
+		return local_ring;
+	}
+
+	(void) pthread_once(&ring_once, InitRingKey);
+
+	ring *new = AdoptRing();
+
+	if (!new) {
+		new = calloc(1, sizeof(ring));
+
+		if (!new) {
+			return NULL;
+		}
+
+		atomic_init(&new->head, 0);
+		atomic_init(&new->tail, 0);
+		atomic_init(&new->retired, false);
+		new->thread = GetThreadID();
+		new->next = atomic_load_explicit(&rings, memory_order_relaxed);
+
+		const memory_order release = memory_order_release;
+		const memory_order relaxed = memory_order_relaxed;
+
+		while (!atomic_compare_exchange_weak_explicit(&rings,
+							      &new->next, new,
+							      release,
+							      relaxed)) {
+			continue;
+		}
+	}
+
+	//without the key the ring is simply never retired
+	if (ring_key_ready) {
+		(void) pthread_setspecific(ring_key, new);
+	}
+
+	local_ring = new;
+
+	return new;
+}
+
+//returns NULL if no retired ring is empty. The consumer only reads the thread
+//of a ring which holds messages, and the new owner writes it before the release
+//store of its first message, so the field needs no atomic access.
+static ring *AdoptRing(void)
+{
+	const memory_order acquire = memory_order_acquire;
+	ring *list = atomic_load_explicit(&rings, acquire);
+
+	for (ring *curr = list; curr; curr = curr->next) {
+		bool retired = atomic_load_explicit(&curr->retired, acquire);
+
+		if (!retired) {
+			continue;
+		}
+
+		const size_t head = atomic_load_explicit(&curr->head, acquire);
+		const size_t tail = atomic_load_explicit(&curr->tail, acquire);
+
+		if (head != tail) {
+			continue;
+		}
+
+		if (atomic_compare_exchange_strong(&curr->retired, &retired,
+						   false)) {
+			curr->thread = GetThreadID();
+			return curr;
+		}
+	}
+
+	return NULL;
+}
+
+//the logger cannot report its own failure here, since the report would need a
+//ring of its own
+static void InitRingKey(void)
+{
+	ring_key_ready = !pthread_key_create(&ring_key, RetireRing);
+}
+
+//pthread_key_create argument; a message logged by a later destructor of the
+//exiting thread goes to a new ring rather than the retired one
+static void RetireRing(void *value)
+{
+	ring *self = (ring *) value;
+
+	local_ring = NULL;
+	atomic_store_explicit(&self->retired, true, memory_order_release);
+}
+
+static uint64_t GetTimestamp(void)
+{
+	struct timespec now = {0};
+	(void) clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
 //------------------------------------------------------------------------------
 //the compiler is multithreaded so the logger needs to report thread IDs. But,
 //pthread_self() is opaque and the gettid syscall results in a large integer
@@ -94,62 +233,192 @@ static xerror_queue xqueue = {
 
 static __thread size_t thread_id = 0;
 
-static void NewThreadID__unsafe(void)
+static size_t GetThreadID(void)
+{
+	static atomic_size_t key = 1;
+
+	if (thread_id == 0) {
+		thread_id = atomic_fetch_add(&key, 1);
+	}
+
+	return thread_id;
+}
+
+//------------------------------------------------------------------------------
+//CException indexes its frame stacks via CEXCEPTION_GET_ID (see the config file
+//CExceptionConfig.h). Every thread that uses Try or Throw claims a free index
+//the first time it asks for one. The index is returned to the free stack by the
+//destructor of a pthread key when the thread exits, so CEXCEPTION_NUM_ID bounds
+//the threads which are alive at once rather than every thread that the process
+//has ever created. The main thread keeps its index until exit.
+
+static void InitExceptionIDs(void);
+static void ReleaseExceptionID(void *);
+
+//@free: stack of released indices, top at free[len - 1]
+//@next: every index below next has been claimed at least once
+static struct {
+	pthread_once_t once;
+	pthread_key_t key;
+	pthread_mutex_t mutex;
+	unsigned int free[CEXCEPTION_NUM_ID];
+	unsigned int len;
+	unsigned int next;
+} exception_ids = {
+	.once = PTHREAD_ONCE_INIT,
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.free = {0},
+	.len = 0,
+	.next = 0
+};
+
+static __thread unsigned int exception_id = UINT_MAX;
+
+unsigned int XerrorExceptionID(void)
 {
-	assert(thread_id == 0 && "attempted to reconfigure thread ID");
+	if (exception_id != UINT_MAX) {
+		return exception_id;
+	}
+
+	(void) pthread_once(&exception_ids.once, InitExceptionIDs);
+
+	pthread_mutex_lock(&exception_ids.mutex);
+
+	unsigned int id = UINT_MAX;
 
-	static size_t key = 1;
-	thread_id = key++;
+	if (exception_ids.len) {
+		id = exception_ids.free[--exception_ids.len];
+	} else if (exception_ids.next < CEXCEPTION_NUM_ID) {
+		id = exception_ids.next++;
+	}
+
+	pthread_mutex_unlock(&exception_ids.mutex);
+
+	if (id == UINT_MAX) {
+		xerror_fatal("exception frame stacks exhausted");
+		abort();
+	}
+
+	//the value is offset by one since a destructor never sees a NULL value
+	void *value = (void *) ((uintptr_t) id + 1);
+
+	if (pthread_setspecific(exception_ids.key, value)) {
+		xerror_issue("exception frame stack %u will not be recycled", id);
+	}
+
+	exception_id = id;
+
+	return exception_id;
 }
 
-static size_t GetThreadID__unsafe(void)
+static void InitExceptionIDs(void)
 {
-	if (thread_id == 0) {
-		NewThreadID__unsafe();
+	if (pthread_key_create(&exception_ids.key, ReleaseExceptionID)) {
+		xerror_fatal("cannot create exception frame stack key");
+		abort();
 	}
+}
 
-	return thread_id;
+//pthread_key_create argument; a thread which exits has left every Try block
+static void ReleaseExceptionID(void *value)
+{
+	const unsigned int id = (unsigned int) ((uintptr_t) value - 1);
+
+	assert(id < CEXCEPTION_NUM_ID);
+	assert(!CExceptionFrames[id].pFrame && "thread exited within Try");
+
+	pthread_mutex_lock(&exception_ids.mutex);
+
+	assert(exception_ids.len < CEXCEPTION_NUM_ID);
+	exception_ids.free[exception_ids.len++] = id;
+
+	pthread_mutex_unlock(&exception_ids.mutex);
 }
 
 //------------------------------------------------------------------------------
 
 void XerrorFlush(void)
 {
-	pthread_mutex_lock(&xqueue.mutex);
+	pthread_mutex_lock(&flush_mutex);
 
 	XerrorFlush__unsafe();
 
-	pthread_mutex_unlock(&xqueue.mutex);
+	pthread_mutex_unlock(&flush_mutex);
 }
 
-static void XerrorFlush__unsafe(void)
+//if another thread is flushing then the caller's messages are left for a later
+//flush rather than waiting on the mutex
+static void XerrorTryFlush(void)
+{
+	if (pthread_mutex_trylock(&flush_mutex)) {
+		return;
+	}
+
+	XerrorFlush__unsafe();
+
+	pthread_mutex_unlock(&flush_mutex);
+}
+
+//colour of the header changes when the thread id of the next message is
+//different than the previous message.
+static void PrintMessage(const message *msg, const size_t curr_thread_id)
 {
-	//colour of the header changes when the thread id of the next message
-	//is different than the previous message.
 	static size_t prev_thread_id = 0;
-	size_t curr_thread_id = 0;
 
-	for (size_t i = 0; i < xqueue.len; i++) {
-		message *msg = &xqueue.buffer[i];
+	cstring *fmt = "0x%s";
 
-		//use sscanf because the input is santised, well-defined, and
-		//created by a trusted source.
-		(void) sscanf(msg->header, "%zu", &curr_thread_id);
+	if (curr_thread_id != prev_thread_id && prev_thread_id) {
+		fmt = YELLOW("0x%s");
+	}
 
-		cstring *fmt = "0x%s";
+	(void) fprintf(stderr, fmt, msg->header);
+	(void) fprintf(stderr, CYAN("\n\t-> %s\n"), msg->body);
 
-		if (curr_thread_id != prev_thread_id && prev_thread_id) {
-			fmt = YELLOW("0x%s");
-		} 
-		
-		(void) fprintf(stderr, fmt, msg->header);
-		(void) fprintf(stderr, CYAN("\n\t-> %s\n"), msg->body);
+	prev_thread_id = curr_thread_id;
+}
+
+//k-way merge of the rings; messages published after the flush begins are left
+//for the next flush
+static void XerrorFlush__unsafe(void)
+{
+	const memory_order acquire = memory_order_acquire;
+	ring *list = atomic_load_explicit(&rings, acquire);
+
+	for (ring *curr = list; curr; curr = curr->next) {
+		curr->cursor = atomic_load_explicit(&curr->head, acquire);
+		curr->limit = atomic_load_explicit(&curr->tail, acquire);
+	}
+
+	while (true) {
+		ring *next = NULL;
+		const message *first = NULL;
+
+		for (ring *curr = list; curr; curr = curr->next) {
+			if (curr->cursor == curr->limit) {
+				continue;
+			}
 
-		prev_thread_id = curr_thread_id;
+			const size_t slot = curr->cursor % BUFFER_CAPACITY;
+			const message *msg = &curr->buffer[slot];
 
+			if (!first || msg->stamp < first->stamp) {
+				next = curr;
+				first = msg;
+			}
+		}
+
+		if (!next) {
+			break;
+		}
+
+		PrintMessage(first, next->thread);
+		next->cursor++;
 	}
 
-	xqueue.len = 0;
+	for (ring *curr = list; curr; curr = curr->next) {
+		const memory_order release = memory_order_release;
+		atomic_store_explicit(&curr->head, curr->cursor, release);
+	}
 }
 
 static const cstring *GetLevelName(const int level)
@@ -199,27 +468,47 @@ void XerrorLog
 	va_list args;
 	va_start(args, txt);
 
-	pthread_mutex_lock(&xqueue.mutex);
+	message overflow = {0};
+	message *msg = &overflow;
+	ring *self = GetRing();
+	size_t tail = 0;
 
-	if (xqueue.len == BUFFER_CAPACITY) {
-		XerrorFlush__unsafe();
-	}
+	//a full ring is drained by a blocking flush, which always includes the
+	//calling thread's ring
+	if (self) {
+		const memory_order acquire = memory_order_acquire;
+		tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
 
-	message *msg = &xqueue.buffer[xqueue.len];
-	assert(msg->header[HEADER_LIMIT - 1] == '\0' && "check xqueue init");
-	assert(msg->body[BODY_LIMIT - 1] == '\0' && "check xqueue init");
+		if (tail - atomic_load_explicit(&self->head, acquire)
+		    == BUFFER_CAPACITY) {
+			XerrorFlush();
+		}
+
+		msg = &self->buffer[tail % BUFFER_CAPACITY];
+	}
 
 	const cstring *fmt = "%zu %s %s %s";
 	char *header = msg->header;
 	char *body = msg->body;
 	const cstring *fname = RemoveFilePath(file);
-	const size_t tid = GetThreadID__unsafe();
+	const size_t tid = GetThreadID();
 	const cstring *lname = GetLevelName(level);
 
+	msg->stamp = GetTimestamp();
 	(void) snprintf(header, HEADER_LIMIT, fmt, tid, lname, fname, func);
 	(void) vsnprintf(body, BODY_LIMIT, txt, args);
 
-	xqueue.len++;
+	va_end(args);
+
+	//without a ring the message cannot be deferred
+	if (!self) {
+		pthread_mutex_lock(&flush_mutex);
+		PrintMessage(msg, tid);
+		pthread_mutex_unlock(&flush_mutex);
+		return;
+	}
+
+	atomic_store_explicit(&self->tail, tail + 1, memory_order_release);
 
 #ifdef XERROR_DEBUG
 	const int threshold = XTRACE;
@@ -227,14 +516,13 @@ void XerrorLog
 	const int threshold = XFATAL;
 #endif
 	assert(XFATAL > XTRACE);
-	
-	if (level >= threshold) {
-		XerrorFlush__unsafe();
-	}
 
-	pthread_mutex_unlock(&xqueue.mutex);
-
-	va_end(args);
+	//fatal messages are delivered before the caller can terminate
+	if (level == XFATAL) {
+		XerrorFlush();
+	} else if (level >= threshold) {
+		XerrorTryFlush();
+	}
 }
 
 //------------------------------------------------------------------------------
@@ -13,9 +13,11 @@
 typedef char cstring;
 
 //------------------------------------------------------------------------------
-//XerrorLog enqueues a new error message to an internal thread-safe buffer. The
-//buffer will automatically flush to stderr when full, when the level is XFATAL,
-//or if XERROR_DEBUG is defined. All messages are newline terminated.
+//XerrorLog enqueues a new error message to a lock-free buffer owned by the
+//calling thread. The buffers are merged in timestamp order and flushed to
+//stderr when the caller's buffer is full or the level is XFATAL. If
+//XERROR_DEBUG is defined they are also flushed after every message, unless
+//another thread is already flushing. All messages are newline terminated.
 
 __attribute__((__format__(__printf__, 4, 5)))
 void XerrorLog
@@ -0,0 +1,238 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// The watch list polls with stat rather than inotify so that it needs nothing
+// beyond POSIX. A poll of a few hundred files costs a few hundred system calls,
+// which is negligible at the poll interval, while a rebuild of the same network
+// costs far more, so a change is only acted upon once the files are quiet; an
+// editor or a version control tool which writes several files at once then
+// triggers one compilation rather than one for each file.
+//
+// The stamp of a file is taken before its tree is built whenever it is known,
+// so a write which races with the parser is seen by the next poll. Only the
+// stamp of a module which a build imports for the first time is taken after
+// its tree.
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "cache.h"
+#include "file.h"
+#include "map.h"
+#include "watch.h"
+#include "xerror.h"
+
+typedef struct entry entry;
+
+#define WATCH_INTERVAL_NS 100000000L
+
+static void WatchSignal(int);
+static void WatchInstall(void);
+static bool WatchSleep(void);
+static bool WatchPoll(watchlist *);
+static entry EntryInit(const cstring *, module *);
+
+//------------------------------------------------------------------------------
+
+//@path: disk name of the module, computed once since FileGetDiskName allocates
+//@ast: NULL if the file has changed since the tree was parsed
+struct entry {
+	const cstring *path;
+	stamp version;
+	module *ast;
+};
+
+make_map(entry, Entry, static)
+
+struct watchlist {
+	map(Entry) files;
+};
+
+//set by the signal handler; the watch stops at the next poll
+static volatile sig_atomic_t stopped = 0;
+
+//------------------------------------------------------------------------------
+
+watchlist *WatchInit
+(
+	const cstring **filenames,
+	const size_t total,
+	network *net
+)
+{
+	assert(filenames);
+
+	ArenaShare();
+	watchlist *list = allocate(sizeof(watchlist));
+	ArenaUnshare();
+
+	list->files = EntryMapInit(MAP_DEFAULT_CAPACITY);
+
+	if (net) {
+		WatchUpdate(list, net);
+	} else {
+		for (size_t i = 0; i < total; i++) {
+			const cstring *name = filenames[i];
+			const entry file = EntryInit(name, NULL);
+			(void) EntryMapInsert(&list->files, name, file);
+		}
+	}
+
+	WatchInstall();
+
+	return list;
+}
+
+bool WatchWait(watchlist *list)
+{
+	assert(list);
+
+	bool changed = false;
+
+	while (WatchSleep()) {
+		if (WatchPoll(list)) {
+			changed = true;
+		} else if (changed) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+graph(Module) WatchReuse(watchlist *list)
+{
+	assert(list);
+
+	graph(Module) reused = ModuleGraphInit();
+
+	uint64_t cursor = 0;
+	const cstring *name = NULL;
+	entry file = {0};
+
+	while (EntryMapNext(&list->files, &cursor, &name, &file)) {
+		module *copy = file.ast ? CacheCopy(file.ast) : NULL;
+
+		if (copy) {
+			(void) ModuleGraphInsert(&reused, name, copy);
+		}
+	}
+
+	return reused;
+}
+
+//the list is rebuilt so that a module which is no longer imported is dropped;
+//the stamps of modules which were already watched are carried over, and their
+//paths are copied since the previous map is released with its network
+void WatchUpdate(watchlist *list, network *net)
+{
+	assert(list);
+
+	if (!net) {
+		return;
+	}
+
+	map(Entry) files = EntryMapInit(MAP_DEFAULT_CAPACITY);
+
+	for (module *node = net->head; node; node = node->next) {
+		entry *prev = NULL;
+		entry file = {0};
+
+		if (EntryMapGetRef(&list->files, node->alias, &prev)) {
+			file = *prev;
+			file.path = cStringDuplicate(prev->path);
+			file.ast = node;
+		} else {
+			file = EntryInit(node->alias, node);
+		}
+
+		(void) EntryMapInsert(&files, node->alias, file);
+	}
+
+	list->files = files;
+}
+
+//------------------------------------------------------------------------------
+
+static void WatchSignal(__attribute__((unused)) int signum)
+{
+	stopped = 1;
+}
+
+//without SA_RESTART the signal also cuts the current sleep short
+static void WatchInstall(void)
+{
+	struct sigaction action;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = WatchSignal;
+	(void) sigemptyset(&action.sa_mask);
+
+	if (sigaction(SIGINT, &action, NULL) == -1
+	    || sigaction(SIGTERM, &action, NULL) == -1) {
+		xerror_issue("sigaction: %s", strerror(errno));
+	}
+}
+
+//returns false once the watch is stopped
+static bool WatchSleep(void)
+{
+	const struct timespec interval = {
+		.tv_sec = 0,
+		.tv_nsec = WATCH_INTERVAL_NS
+	};
+
+	if (!stopped) {
+		(void) nanosleep(&interval, NULL);
+	}
+
+	return !stopped;
+}
+
+//restamps every file; returns true if any stamp changed
+static bool WatchPoll(watchlist *list)
+{
+	assert(list);
+
+	bool changed = false;
+
+	uint64_t cursor = 0;
+	const cstring *name = NULL;
+
+	while (EntryMapNext(&list->files, &cursor, &name, NULL)) {
+		entry *file = NULL;
+
+		bool found = EntryMapGetRef(&list->files, name, &file);
+		assert(found);
+		(void) found;
+
+		const stamp version = FileStamp(file->path);
+
+		if (!FileStampMatch(version, file->version)) {
+			file->version = version;
+			file->ast = NULL;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+static entry EntryInit(const cstring *name, module *ast)
+{
+	assert(name);
+
+	const cstring *path = FileGetDiskName(name);
+
+	entry file = {
+		.path = path,
+		.version = FileStamp(path),
+		.ast = ast
+	};
+
+	return file;
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// With --Watch the compiler stays resident after the first compilation and
+// polls the file of every module in the last network that was built without
+// error. When any of them changes the network is built again by ResolverReuse.
+// The trees of the unchanged modules are kept in memory between compilations,
+// so only the changed files and any modules which they newly import are
+// scanned and parsed again.
+//
+// Each compilation allocates from its own arena generation, and main releases
+// the generation of a network once a newer one has replaced it. The reused
+// trees are therefore copied into the new generation rather than shared, and
+// the watch list is rebuilt there as well.
+//
+// The symbol tables are always resolved again from the beginning. An importer
+// sets the referenced flags of the symbols in the modules it imports, so the
+// tables of an unchanged module would keep the marks of a reference that has
+// since been edited out of one of its importers.
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "resolver.h"
+#include "str.h"
+
+typedef struct watchlist watchlist;
+
+//watches the modules of the network, or only the total root files if the
+//network is NULL because the first compilation failed. Until WatchWait returns
+//false, SIGINT and SIGTERM stop the watch instead of the process.
+watchlist *WatchInit
+(
+	const cstring **filenames,
+	const size_t total,
+	network *net
+);
+
+//blocks until at least one watched file has changed and then stays silent
+//for one poll interval; returns false if SIGINT or SIGTERM arrives first
+bool WatchWait(watchlist *list);
+
+//returns copies, in the arena of the calling thread, of the trees of the
+//watched modules whose files have not changed since they were last parsed
+graph(Module) WatchReuse(watchlist *list);
+
+//watches the modules of a network built since the last WatchWait. If net is
+//NULL then the build failed and the watch list is unchanged, so the files that
+//changed are parsed again by every build until one succeeds. A module which
+//the failed build imported for the first time is not watched until then.
+//Otherwise the list no longer refers to the previous network, which may then
+//be released.
+void WatchUpdate(watchlist *list, network *net);
@@ -0,0 +1,35 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Minimal assertions for the C unit tests in this directory. A failed check is
+// reported with its location and the test carries on, so one run lists every
+// failure; main returns TestExit. The tests are built and run by the test rule
+// of the build script.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+#define check(condition)						       \
+do {									       \
+	if (!(condition)) {						       \
+		fprintf(stderr, "%s:%d: check failed: %s\n",		       \
+			__FILE__, __LINE__, #condition);		       \
+		test_failures++;					       \
+	}								       \
+} while (0)
+
+//returns the exit status of the test named name
+static int TestExit(const char *name)
+{
+	if (test_failures) {
+		fprintf(stderr, "%s: %d checks failed\n", name, test_failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("%s: all checks passed\n", name);
+
+	return EXIT_SUCCESS;
+}
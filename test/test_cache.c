@@ -0,0 +1,300 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Checks that the argument vectors of call and rvar literal nodes survive the
+// cache in both of their layouts. The calls in test_cache.lem have argument
+// lists below, at, and past ARGS_INLINE; the tree is stored in a temporary
+// --Cache directory, loaded back, and copied, and every argument is compared
+// with the parsed tree. The entry is then damaged a byte at a time, through the
+// header, the node bodies, and the tables, and no damaged entry may load. The
+// test is linked with every compiler source except main.c and is run from the
+// root of the repository.
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "cache.h"
+#include "file.h"
+#include "options.h"
+#include "parser.h"
+#include "test.h"
+
+#define FILENAME "./test/test_cache.lem"
+
+//number of bytes of the entry which are damaged in turn
+#define DAMAGED 16
+
+//argument counts of the calls and rvar literals in test_cache.lem, in order
+static const size_t counts[] = {0, 1, 3, 4, 9, 3, 4};
+
+#define COUNT (sizeof(counts) / sizeof(counts[0]))
+
+static bool Collect(module *, vector(Args) **);
+static void Compare(vector(Args) *, vector(Args) *);
+static void CheckStoreLoad(module *, vector(Args) **);
+static void CheckShrunk(module *, vector(Args) **);
+static bool Rewrite(const char *, const char *, const size_t);
+static void CheckDamaged(void);
+static void RemoveDirectory(const char *);
+
+//------------------------------------------------------------------------------
+
+//places the argument vector of every call and rvar literal in the calls
+//function into lists, in source order; returns false if the tree does not
+//have the shape of test_cache.lem
+static bool Collect(module *root, vector(Args) **lists)
+{
+	check(root->declarations.len == 1);
+
+	if (root->declarations.len != 1) {
+		return false;
+	}
+
+	decl node = DeclVectorGet(&root->declarations, 0);
+	check(node.tag == NODE_FUNCTION);
+
+	vector(Fiat) *fiats = &node.function.block->block.fiats;
+	check(fiats->len == COUNT);
+
+	if (node.tag != NODE_FUNCTION || fiats->len != COUNT) {
+		return false;
+	}
+
+	for (size_t i = 0; i < COUNT; i++) {
+		fiat *item = fiats->buffer + i;
+		expr *value = NULL;
+
+		if (item->tag == NODE_STMT) {
+			value = item->statement.exprstmt;
+			check(value->tag == NODE_CALL);
+			lists[i] = &value->call.args;
+		} else {
+			value = item->declaration.variable.value;
+			check(value->tag == NODE_RVARLIT);
+			lists[i] = &value->rvarlit.args;
+		}
+	}
+
+	return true;
+}
+
+//the copy must hold the same literals; a list of at most ARGS_INLINE elements
+//must be inline in the copy whatever its layout in the original
+static void Compare(vector(Args) *original, vector(Args) *copy)
+{
+	check(copy->len == original->len);
+	check((copy->cap == ARGS_INLINE) == (copy->len <= ARGS_INLINE));
+
+	for (size_t i = 0; i < copy->len && i < original->len; i++) {
+		const expr *a = ArgsVectorGet(original, i);
+		const expr *b = ArgsVectorGet(copy, i);
+
+		check(a != b);
+		check(b->tag == NODE_LIT);
+		check(a->line == b->line);
+		check(!strcmp(a->lit.rep, b->lit.rep));
+	}
+}
+
+//------------------------------------------------------------------------------
+
+//the parse has already stored the tree, so the load must find it
+static void CheckStoreLoad(module *root, vector(Args) **parsed)
+{
+	source src = {0};
+	size_t nodes = 0;
+
+	check(FileMap(FILENAME, &src));
+
+	const uint64_t key = CacheKey(&src);
+	FileUnmap(&src);
+
+	module *loaded = CacheLoad(FILENAME, key, &nodes);
+	check(loaded != NULL);
+
+	if (!loaded) {
+		return;
+	}
+
+	vector(Args) *lists[COUNT] = {0};
+
+	if (!Collect(loaded, lists)) {
+		return;
+	}
+
+	for (size_t i = 0; i < COUNT; i++) {
+		check(parsed[i]->len == counts[i]);
+		Compare(parsed[i], lists[i]);
+	}
+
+	check(loaded->alias && !strcmp(loaded->alias, root->alias));
+}
+
+//a list which spilled to the arena and then shrank to ARGS_INLINE elements is
+//written back into the node
+static void CheckShrunk(module *root, vector(Args) **parsed)
+{
+	vector(Args) *spilled = parsed[3];
+
+	check(spilled->len == ARGS_INLINE + 1);
+	(void) ArgsVectorPop(spilled);
+	check(spilled->len == ARGS_INLINE && spilled->cap > ARGS_INLINE);
+
+	module *copy = CacheCopy(root);
+	check(copy != NULL);
+
+	if (!copy) {
+		return;
+	}
+
+	vector(Args) *lists[COUNT] = {0};
+
+	if (!Collect(copy, lists)) {
+		return;
+	}
+
+	for (size_t i = 0; i < COUNT; i++) {
+		Compare(parsed[i], lists[i]);
+	}
+
+	check(lists[3]->cap == ARGS_INLINE);
+}
+
+//returns false if the file cannot be overwritten with len bytes of the buffer
+static bool Rewrite(const char *path, const char *buffer, const size_t len)
+{
+	FILE *handle = fopen(path, "wb");
+
+	if (!handle) {
+		return false;
+	}
+
+	const bool ok = fwrite(buffer, 1, len, handle) == len;
+
+	return !fclose(handle) && ok;
+}
+
+//an entry with one byte flipped is rejected whether the byte is in the header,
+//in a node, or in a table; most of an image is node bodies, so the evenly
+//spaced bytes past the first land mostly in nodes
+static void CheckDamaged(void)
+{
+	source src = {0};
+	size_t nodes = 0;
+	char path[4096] = {0};
+
+	check(FileMap(FILENAME, &src));
+
+	const uint64_t key = CacheKey(&src);
+	FileUnmap(&src);
+
+	const char *fmt = "%s/%016" PRIx64 ".ast";
+	(void) snprintf(path, sizeof(path), fmt, OptionsCache(), key);
+
+	char *image = NULL;
+	long len = 0;
+	FILE *handle = fopen(path, "rb");
+	check(handle != NULL);
+
+	if (handle && !fseek(handle, 0, SEEK_END) && (len = ftell(handle)) > 0) {
+		image = malloc((size_t) len);
+		rewind(handle);
+		check(image && fread(image, 1, (size_t) len, handle) == (size_t) len);
+	}
+
+	if (handle) {
+		(void) fclose(handle);
+	}
+
+	if (!image) {
+		check(image != NULL);
+		return;
+	}
+
+	const size_t size = (size_t) len;
+
+	for (size_t i = 0; i < DAMAGED; i++) {
+		const size_t at = i * size / DAMAGED;
+
+		image[at] ^= 0x40;
+		check(Rewrite(path, image, size));
+		check(CacheLoad(FILENAME, key, &nodes) == NULL);
+		image[at] ^= 0x40;
+	}
+
+	check(Rewrite(path, image, size));
+	check(CacheLoad(FILENAME, key, &nodes) != NULL);
+
+	free(image);
+}
+
+//removes the entries of the temporary --Cache directory and then the directory
+static void RemoveDirectory(const char *path)
+{
+	DIR *handle = opendir(path);
+
+	if (!handle) {
+		return;
+	}
+
+	struct dirent *entry = NULL;
+
+	while ((entry = readdir(handle))) {
+		char name[4096] = {0};
+
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		const char *file = entry->d_name;
+		(void) snprintf(name, sizeof(name), "%s/%s", path, file);
+		(void) unlink(name);
+	}
+
+	(void) closedir(handle);
+	(void) rmdir(path);
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+	char directory[] = "/tmp/lemon-test-cache-XXXXXX";
+
+	if (!mkdtemp(directory)) {
+		fprintf(stderr, "cannot create cache directory\n");
+		return EXIT_FAILURE;
+	}
+
+	char *arguments[] = {"test_cache", "--Cache", directory, NULL};
+	char **argv = arguments;
+	int argc = 3;
+
+	if (!OptionsParse(&argc, &argv) || !ArenaInit(OptionsArena())) {
+		fprintf(stderr, "cannot initialize compiler\n");
+		RemoveDirectory(directory);
+		return EXIT_FAILURE;
+	}
+
+	module *root = SyntaxTreeInit(FILENAME);
+	check(root != NULL);
+
+	vector(Args) *parsed[COUNT] = {0};
+
+	if (root && Collect(root, parsed)) {
+		CheckStoreLoad(root, parsed);
+		CheckShrunk(root, parsed);
+		CheckDamaged();
+	}
+
+	RemoveDirectory(directory);
+	ArenaFree();
+
+	return TestExit("cache");
+}
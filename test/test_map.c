@@ -0,0 +1,293 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Behaviour checks of the map.h hash table, or of the flatmap.h table when the
+// test is compiled with -DFLATMAP: lookups after insertions, cycles of removal
+// and reinsertion, lookups after the table is compacted at its own capacity,
+// and lookups which end at map.probe rather than at an open slot.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "flatmap.h"
+#include "test.h"
+
+make_table(size_t, Number, static)
+
+//HOME_WIDTH is the number of slots that share a home, where every probe
+//sequence starts, and FILLED_HOMES is the number of full homes at the load
+//factor threshold
+#ifdef FLATMAP
+	#define HOME_WIDTH FLATMAP_GROUP
+	#define FILLED_HOMES(homes) ((homes) - (homes) / 8)
+	#define TEST_NAME "flatmap"
+#else
+	#define HOME_WIDTH ((uint64_t) 1)
+	#define FILLED_HOMES(homes) ((homes) / 2)
+	#define TEST_NAME "map"
+#endif
+
+#define KEYS ((size_t) 1000)
+#define WINDOW ((size_t) 20)
+#define ROUNDS ((size_t) 200)
+
+static const cstring *Key(const char *, const size_t);
+static const cstring *KeyAt(const uint64_t, const uint64_t, size_t *);
+static size_t Count(const map(Number) *);
+static void CheckInsertions(void);
+static void CheckCycles(void);
+static void CheckCompaction(void);
+static void CheckProbeLimit(void);
+
+//------------------------------------------------------------------------------
+
+//returns a new key with the given prefix and number
+static const cstring *Key(const char *prefix, const size_t n)
+{
+	cstring *key = allocate(32);
+
+	(void) snprintf(key, 32, "%s%zu", prefix, n);
+
+	return key;
+}
+
+//returns the first key after *seed whose probe sequence starts at the home of
+//a table with the given number of homes
+static const cstring *KeyAt(const uint64_t home, const uint64_t homes,
+			    size_t *seed)
+{
+	while (true) {
+		const cstring *key = Key("p", (*seed)++);
+
+		if (MapScale(MapHash(key), homes) == home) {
+			return key;
+		}
+	}
+}
+
+//returns the number of entries visited by MapNext
+static size_t Count(const map(Number) *table)
+{
+	uint64_t cursor = 0;
+	size_t total = 0;
+
+	while (NumberMapNext(table, &cursor, NULL, NULL)) {
+		total++;
+	}
+
+	return total;
+}
+
+//------------------------------------------------------------------------------
+
+static void CheckInsertions(void)
+{
+	map(Number) table = NumberMapInit(MAP_DEFAULT_CAPACITY);
+	const cstring *keys[KEYS];
+
+	for (size_t i = 0; i < KEYS; i++) {
+		keys[i] = Key("k", i);
+		check(NumberMapInsert(&table, keys[i], i) != NULL);
+	}
+
+	check(NumberMapInsert(&table, keys[0], 0) == NULL);
+	check(table.len == KEYS);
+	check(Count(&table) == KEYS);
+
+	for (size_t i = 0; i < KEYS; i++) {
+		size_t value = KEYS;
+
+		//a copy of the key is found through strcmp
+		check(NumberMapGet(&table, Key("k", i), &value));
+		check(value == i);
+		check(!NumberMapGet(&table, Key("m", i), NULL));
+	}
+
+	check(NumberMapSet(&table, keys[7], 70));
+	check(!NumberMapSet(&table, "m7", 70));
+
+	size_t *ref = NULL;
+	check(NumberMapGetRef(&table, keys[7], &ref) && *ref == 70);
+}
+
+//each round inserts the keys of a window and removes those of the previous
+//window, then reinserts one of the removed keys under a new value
+static void CheckCycles(void)
+{
+	map(Number) table = NumberMapInit(MAP_DEFAULT_CAPACITY);
+	const cstring *keys[WINDOW * (ROUNDS + 1)];
+
+	for (size_t i = 0; i < WINDOW * (ROUNDS + 1); i++) {
+		keys[i] = Key("c", i);
+	}
+
+	for (size_t round = 0; round < ROUNDS; round++) {
+		const size_t first = round * WINDOW;
+
+		for (size_t i = first + WINDOW; i < first + 2 * WINDOW; i++) {
+			check(NumberMapInsert(&table, keys[i], i) != NULL);
+		}
+
+		for (size_t i = first; i < first + WINDOW; i++) {
+			bool removed = NumberMapRemove(&table, keys[i]);
+			check(removed == (round > 0));
+			check(!NumberMapRemove(&table, keys[i]));
+		}
+
+		if (round) {
+			check(NumberMapInsert(&table, keys[first], round));
+		}
+
+		check(table.len - table.removed == WINDOW + (round > 0));
+		check(Count(&table) == WINDOW + (round > 0));
+
+		for (size_t i = first + WINDOW; i < first + 2 * WINDOW; i++) {
+			size_t value = 0;
+			bool found = NumberMapGet(&table, keys[i], &value);
+			check(found && value == i);
+		}
+
+		for (size_t i = first + 1; i < first + WINDOW; i++) {
+			check(!NumberMapGet(&table, keys[i], NULL));
+		}
+
+		size_t value = 0;
+		bool found = NumberMapGet(&table, keys[first], &value);
+		check(found == (round > 0) && (!found || value == round));
+
+		if (round) {
+			check(NumberMapRemove(&table, keys[first]));
+		}
+	}
+}
+
+//the first homes are filled until one more entry would exceed the load factor
+//and all but the last of them are then removed. Every removal leaves a removed
+//slot behind, since the slot after it or its group is full, and so the next
+//insertions rehash the table at its own capacity.
+static void CheckCompaction(void)
+{
+	const uint64_t homes = 16 * HOME_WIDTH;
+	const uint64_t filled = FILLED_HOMES(homes);
+	const size_t total = filled * HOME_WIDTH;
+	const size_t dropped = total - HOME_WIDTH;
+
+	map(Number) table = NumberMapInit(homes * HOME_WIDTH);
+	const cstring *keys[total];
+	const cstring *fresh[2 * HOME_WIDTH + 1];
+	size_t seed = 0;
+
+	for (size_t i = 0; i < total; i++) {
+		keys[i] = KeyAt(i / HOME_WIDTH, homes, &seed);
+		check(NumberMapInsert(&table, keys[i], i) != NULL);
+	}
+
+	check(table.len == total);
+	check(table.probe == 0);
+
+	for (size_t i = 0; i < dropped; i++) {
+		check(NumberMapRemove(&table, keys[i]));
+	}
+
+	check(table.removed == dropped);
+
+	//the new keys start at the last home, which is open, so they do not
+	//recycle removed slots before the load factor is exceeded
+	size_t inserted = 0;
+	bool compacted = false;
+
+	while (!compacted && inserted < 2 * HOME_WIDTH + 1) {
+		const uint64_t len = table.len;
+
+		fresh[inserted] = KeyAt(homes - 1, homes, &seed);
+		check(NumberMapInsert(&table, fresh[inserted], inserted));
+
+		compacted = table.len < len;
+		inserted++;
+	}
+
+	check(compacted);
+	check(table.cap == homes * HOME_WIDTH);
+	check(table.removed == 0);
+	check(table.len == total - dropped + inserted);
+	check(Count(&table) == total - dropped + inserted);
+
+	for (size_t i = 0; i < total; i++) {
+		size_t value = total;
+		bool found = NumberMapGet(&table, keys[i], &value);
+		check(found == (i >= dropped) && (!found || value == i));
+	}
+
+	for (size_t i = 0; i < inserted; i++) {
+		size_t value = inserted;
+		check(NumberMapGet(&table, fresh[i], &value) && value == i);
+	}
+}
+
+//the last home is filled and its overflow wraps around to fill the first home,
+//so a lookup from the last home examines two full homes and then stops at the
+//distance map.probe although the table has open slots elsewhere
+static void CheckProbeLimit(void)
+{
+	const uint64_t homes = 8;
+	const uint64_t last = homes - 1;
+	const size_t total = 2 * HOME_WIDTH;
+
+	map(Number) table = NumberMapInit(homes * HOME_WIDTH);
+	const cstring *keys[total];
+	size_t seed = 0;
+
+	for (size_t i = 0; i < total; i++) {
+		keys[i] = KeyAt(last, homes, &seed);
+		check(NumberMapInsert(&table, keys[i], i) != NULL);
+	}
+
+	check(table.probe == 1);
+
+	for (size_t i = 0; i < total; i++) {
+		size_t value = total;
+		check(NumberMapGet(&table, keys[i], &value) && value == i);
+	}
+
+	for (size_t i = 0; i < 16; i++) {
+		check(!NumberMapGet(&table, KeyAt(last, homes, &seed), NULL));
+		check(!NumberMapGet(&table, KeyAt(0, homes, &seed), NULL));
+	}
+
+	//the removed slot is passed over by the lookups that reach the overflow
+	//and is recycled by the reinsertion
+	check(NumberMapRemove(&table, keys[0]));
+	check(table.removed == 1);
+
+	for (size_t i = 1; i < total; i++) {
+		check(NumberMapGet(&table, keys[i], NULL));
+	}
+
+	check(!NumberMapGet(&table, keys[0], NULL));
+	check(NumberMapInsert(&table, keys[0], total) != NULL);
+	check(table.removed == 0);
+	check(table.len == total);
+
+	size_t value = 0;
+	check(NumberMapGet(&table, keys[0], &value) && value == total);
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+	if (!ArenaInit(MiB(16))) {
+		fprintf(stderr, "cannot initialize arena\n");
+		return EXIT_FAILURE;
+	}
+
+	CheckInsertions();
+	CheckCycles();
+	CheckCompaction();
+	CheckProbeLimit();
+
+	ArenaFree();
+
+	return TestExit(TEST_NAME);
+}
@@ -0,0 +1,347 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Producer and consumer checks of the spsc.h channel: a producer suspended on
+// a full ring, a consumer suspended on an empty ring, a close while the
+// consumer is suspended, and batches which are split by the ring boundary or
+// by the maximum the consumer accepts. Each check runs its producer or its
+// consumer on a second thread and the other end on the main thread.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "arena.h"
+#include "spsc.h"
+#include "test.h"
+
+make_spsc_channel(uint64_t, Word, static)
+
+//longest wait for a thread to suspend on the futex, in milliseconds
+#define SUSPEND_TIMEOUT 5000
+
+#define STREAM ((uint64_t) 100000)
+
+//@data: elements sent by a producer or received by a consumer
+//@n: number of elements to send, or received
+//@status: return value of the last channel operation
+typedef struct endpoint {
+	Word_channel *chan;
+	uint64_t *data;
+	size_t n;
+	int status;
+	atomic_bool done;
+} endpoint;
+
+static void Sleep(void);
+static bool Suspended(Word_channel *);
+static void *SendAll(void *);
+static void *RecvOne(void *);
+static void *SendStream(void *);
+static void CheckFull(void);
+static void CheckEmpty(void);
+static void CheckClose(void);
+static void CheckBatches(void);
+static void CheckStream(void);
+
+//------------------------------------------------------------------------------
+
+static void Sleep(void)
+{
+	const struct timespec millisecond = {.tv_nsec = 1000000};
+
+	(void) nanosleep(&millisecond, NULL);
+}
+
+//returns true once a thread is suspended on the channel, or false if none is
+//within SUSPEND_TIMEOUT
+static bool Suspended(Word_channel *chan)
+{
+	for (int i = 0; i < SUSPEND_TIMEOUT; i++) {
+		if (atomic_load(&chan->waiters)) {
+			return true;
+		}
+
+		Sleep();
+	}
+
+	return false;
+}
+
+//pthread_create argument; sends every element as one batch
+static void *SendAll(void *pthread_payload)
+{
+	endpoint *self = (endpoint *) pthread_payload;
+
+	self->status = WordChannelSendBatch(self->chan, self->data, self->n);
+	atomic_store(&self->done, true);
+
+	return NULL;
+}
+
+//pthread_create argument; receives at most one element
+static void *RecvOne(void *pthread_payload)
+{
+	endpoint *self = (endpoint *) pthread_payload;
+
+	Word_channel *chan = self->chan;
+
+	self->status = WordChannelRecvBatch(chan, self->data, 1, &self->n);
+	atomic_store(&self->done, true);
+
+	return NULL;
+}
+
+//pthread_create argument; sends 0 to STREAM - 1 in batches of 1 to 13 elements
+//and then closes the channel
+static void *SendStream(void *pthread_payload)
+{
+	endpoint *self = (endpoint *) pthread_payload;
+	uint64_t batch[13] = {0};
+	uint64_t next = 0;
+	size_t len = 1;
+
+	self->status = CHANNEL_ESUCCESS;
+
+	while (next < STREAM && self->status == CHANNEL_ESUCCESS) {
+		size_t n = 0;
+
+		while (n < len && next < STREAM) {
+			batch[n++] = next++;
+		}
+
+		self->status = WordChannelSendBatch(self->chan, batch, n);
+		len = len % 13 + 1;
+	}
+
+	WordChannelClose(self->chan);
+	atomic_store(&self->done, true);
+
+	return NULL;
+}
+
+//------------------------------------------------------------------------------
+
+//the producer cannot complete while the ring is full and completes once the
+//consumer has drained enough of it
+static void CheckFull(void)
+{
+	const size_t cap = 4;
+	Word_channel chan;
+	WordChannelInit(&chan, cap);
+
+	for (uint64_t i = 0; i < cap; i++) {
+		check(WordChannelSend(&chan, i) == CHANNEL_ESUCCESS);
+	}
+
+	uint64_t extra[] = {cap, cap + 1};
+	endpoint producer = {&chan, extra, 2, -1, false};
+	pthread_t thread;
+
+	check(!pthread_create(&thread, NULL, SendAll, &producer));
+	check(Suspended(&chan));
+	check(!atomic_load(&producer.done));
+	check(WordChannelShutdown(&chan) == CHANNEL_EBUSY);
+
+	for (uint64_t i = 0; i < cap + 2; i++) {
+		uint64_t datum = UINT64_MAX;
+		check(WordChannelRecv(&chan, &datum) == CHANNEL_ESUCCESS);
+		check(datum == i);
+	}
+
+	(void) pthread_join(thread, NULL);
+
+	check(producer.status == CHANNEL_ESUCCESS);
+	check(WordChannelShutdown(&chan) == CHANNEL_ESUCCESS);
+}
+
+//the consumer waits on an empty ring for exactly one element; a suspension has
+//no timeout, so the check hangs unless one element on a large ring is enough
+//to wake the consumer
+static void CheckEmpty(void)
+{
+	Word_channel chan;
+	WordChannelInit(&chan, 64);
+
+	uint64_t datum = UINT64_MAX;
+	endpoint consumer = {&chan, &datum, 0, -1, false};
+	pthread_t thread;
+
+	check(!pthread_create(&thread, NULL, RecvOne, &consumer));
+	check(Suspended(&chan));
+	check(!atomic_load(&consumer.done));
+
+	check(WordChannelSend(&chan, 42) == CHANNEL_ESUCCESS);
+
+	(void) pthread_join(thread, NULL);
+
+	check(consumer.status == CHANNEL_ESUCCESS);
+	check(consumer.n == 1);
+	check(datum == 42);
+	check(atomic_load(&chan.head) == atomic_load(&chan.tail));
+
+	WordChannelClose(&chan);
+}
+
+//a close wakes the consumer suspended on an empty ring, and a consumer on a
+//closed ring still receives what was sent before the close
+static void CheckClose(void)
+{
+	Word_channel chan;
+	WordChannelInit(&chan, 4);
+
+	uint64_t datum = UINT64_MAX;
+	endpoint consumer = {&chan, &datum, 1, -1, false};
+	pthread_t thread;
+
+	check(!pthread_create(&thread, NULL, RecvOne, &consumer));
+	check(Suspended(&chan));
+
+	WordChannelClose(&chan);
+
+	(void) pthread_join(thread, NULL);
+
+	check(consumer.status == CHANNEL_ECLOSED);
+	check(consumer.n == 0);
+	check(datum == UINT64_MAX);
+	check(WordChannelSend(&chan, 0) == CHANNEL_ECLOSED);
+
+	WordChannelInit(&chan, 4);
+
+	uint64_t sent[] = {7, 8, 9};
+	uint64_t received[4] = {0};
+	size_t n = 0;
+
+	check(WordChannelSendBatch(&chan, sent, 3) == CHANNEL_ESUCCESS);
+	WordChannelClose(&chan);
+
+	check(WordChannelRecvBatch(&chan, received, 2, &n) == CHANNEL_ESUCCESS);
+	check(n == 2 && received[0] == 7 && received[1] == 8);
+	check(WordChannelRecvBatch(&chan, received, 4, &n) == CHANNEL_ESUCCESS);
+	check(n == 1 && received[0] == 9);
+	check(WordChannelRecvBatch(&chan, received, 4, &n) == CHANNEL_ECLOSED);
+	check(n == 0);
+}
+
+//batches shorter than the ring, batches cut short by the consumer maximum,
+//batches which wrap around the end of the ring, and a batch longer than the
+//ring which the producer must publish in parts
+static void CheckBatches(void)
+{
+	const int ok = CHANNEL_ESUCCESS;
+	const size_t cap = 8;
+	Word_channel chan;
+	WordChannelInit(&chan, cap);
+
+	uint64_t sent[1000] = {0};
+	uint64_t received[8] = {0};
+	size_t n = 0;
+
+	for (uint64_t i = 0; i < 1000; i++) {
+		sent[i] = i;
+	}
+
+	check(WordChannelSendBatch(&chan, sent, 3) == ok);
+	check(WordChannelRecvBatch(&chan, received, cap, &n) == ok);
+	check(n == 3 && received[0] == 0 && received[2] == 2);
+
+	check(WordChannelSendBatch(&chan, sent + 3, 5) == ok);
+	check(WordChannelRecvBatch(&chan, received, 2, &n) == ok);
+	check(n == 2 && received[0] == 3 && received[1] == 4);
+	check(WordChannelRecvBatch(&chan, received, cap, &n) == ok);
+	check(n == 3 && received[0] == 5 && received[2] == 7);
+
+	//the second batch of six starts at slot 6 and wraps around to slot 0
+	check(WordChannelSendBatch(&chan, sent + 8, 6) == ok);
+	check(WordChannelRecvBatch(&chan, received, 4, &n) == ok);
+	check(n == 4 && received[0] == 8 && received[3] == 11);
+	check(WordChannelSendBatch(&chan, sent + 14, 6) == ok);
+	check(WordChannelRecvBatch(&chan, received, cap, &n) == ok);
+	check(n == cap);
+
+	for (size_t i = 0; i < n; i++) {
+		check(received[i] == 12 + i);
+	}
+
+	endpoint producer = {&chan, sent + 20, 1000 - 20, -1, false};
+	pthread_t thread;
+	uint64_t expected = 20;
+	size_t max = 1;
+
+	check(!pthread_create(&thread, NULL, SendAll, &producer));
+
+	while (expected < 1000) {
+		check(WordChannelRecvBatch(&chan, received, max, &n) == ok);
+		check(n >= 1 && n <= max);
+
+		for (size_t i = 0; i < n; i++) {
+			check(received[i] == expected++);
+		}
+
+		max = max % 5 + 1;
+	}
+
+	(void) pthread_join(thread, NULL);
+
+	check(producer.status == ok);
+	check(expected == 1000);
+	check(atomic_load(&chan.head) == atomic_load(&chan.tail));
+
+	WordChannelClose(&chan);
+}
+
+//a long run of uneven batches on both sides with the end of the stream marked
+//by the close
+static void CheckStream(void)
+{
+	const int ok = CHANNEL_ESUCCESS;
+	Word_channel chan;
+	WordChannelInit(&chan, 16);
+
+	endpoint producer = {&chan, NULL, 0, -1, false};
+	pthread_t thread;
+	uint64_t received[11] = {0};
+	uint64_t expected = 0;
+	size_t max = 1;
+	size_t n = 0;
+
+	check(!pthread_create(&thread, NULL, SendStream, &producer));
+
+	while (WordChannelRecvBatch(&chan, received, max, &n) == ok) {
+		check(n >= 1 && n <= max);
+
+		for (size_t i = 0; i < n; i++) {
+			check(received[i] == expected++);
+		}
+
+		max = max % 11 + 1;
+	}
+
+	(void) pthread_join(thread, NULL);
+
+	check(producer.status == ok);
+	check(expected == STREAM);
+	check(n == 0);
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+	if (!ArenaInit(MiB(1))) {
+		fprintf(stderr, "cannot initialize arena\n");
+		return EXIT_FAILURE;
+	}
+
+	CheckFull();
+	CheckEmpty();
+	CheckClose();
+	CheckBatches();
+	CheckStream();
+
+	ArenaFree();
+
+	return TestExit("spsc");
+}
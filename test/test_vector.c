@@ -0,0 +1,152 @@
+// Copyright (C) 2021 Biren Patel. GNU General Public License v3.0.
+//
+// Boundary checks of the vector.h small vector: a vector of exactly its inline
+// capacity, the push of one element past it, removals and resets after the
+// elements have moved to the arena, and copies by value of both layouts.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "test.h"
+#include "vector.h"
+
+#define INLINE 3
+
+make_small_vector(uint64_t, Small, INLINE, static)
+
+static bool Inline(vector(Small) *);
+static void CheckExactlyInline(void);
+static void CheckOnePastInline(void);
+static void CheckSpilled(void);
+
+//------------------------------------------------------------------------------
+
+//true if the elements are stored in the struct itself
+static bool Inline(vector(Small) *v)
+{
+	const char *data = (const char *) SmallVectorData_private(v, 0);
+	const char *self = (const char *) v;
+
+	return data >= self && data < self + sizeof(*v);
+}
+
+//------------------------------------------------------------------------------
+
+static void CheckExactlyInline(void)
+{
+	const size_t used = ArenaUsed();
+	vector(Small) v = SmallVectorInit();
+
+	check(v.len == 0 && v.cap == INLINE);
+
+	for (uint64_t i = 0; i < INLINE; i++) {
+		SmallVectorPush(&v, i);
+	}
+
+	check(v.len == INLINE && v.cap == INLINE);
+	check(Inline(&v));
+	check(ArenaUsed() == used);
+
+	for (size_t i = 0; i < INLINE; i++) {
+		check(SmallVectorGet(&v, i) == i);
+	}
+
+	//an inline copy owns its elements
+	vector(Small) copy = v;
+	check(SmallVectorSet(&copy, 0, 42) == 0);
+	check(SmallVectorGet(&v, 0) == 0);
+	check(SmallVectorGet(&copy, 0) == 42);
+
+	check(SmallVectorPop(&v) == INLINE - 1);
+	check(v.len == INLINE - 1 && v.cap == INLINE);
+
+	SmallVectorPush(&v, 7);
+	check(SmallVectorGet(&v, INLINE - 1) == 7);
+	check(Inline(&v));
+}
+
+static void CheckOnePastInline(void)
+{
+	const size_t used = ArenaUsed();
+	vector(Small) v = SmallVectorInit();
+
+	for (uint64_t i = 0; i <= INLINE; i++) {
+		SmallVectorPush(&v, i);
+	}
+
+	check(v.len == INLINE + 1 && v.cap > INLINE);
+	check(!Inline(&v));
+	check(ArenaUsed() > used);
+
+	for (size_t i = 0; i <= INLINE; i++) {
+		check(SmallVectorGet(&v, i) == i);
+	}
+
+	//a spilled copy shares the arena buffer, as any other vector does
+	vector(Small) copy = v;
+	check(SmallVectorSet(&copy, INLINE, 42) == INLINE);
+	check(SmallVectorGet(&v, INLINE) == 42);
+}
+
+//a vector which spilled stays in the arena when it shrinks or is reset
+static void CheckSpilled(void)
+{
+	vector(Small) v = SmallVectorInit();
+
+	for (uint64_t i = 0; i < 100; i++) {
+		SmallVectorPush(&v, i);
+	}
+
+	check(v.len == 100 && v.cap >= 100);
+
+	for (size_t i = 0; i < 100; i++) {
+		check(SmallVectorGet(&v, i) == i);
+	}
+
+	while (v.len > INLINE) {
+		const uint64_t top = SmallVectorPop(&v);
+		check(top == v.len);
+	}
+
+	const size_t cap = v.cap;
+
+	check(!Inline(&v));
+
+	for (size_t i = 0; i < INLINE; i++) {
+		check(SmallVectorGet(&v, i) == i);
+	}
+
+	SmallVectorReset(&v);
+	check(v.len == 0 && v.cap == cap);
+
+	for (uint64_t i = 0; i <= INLINE; i++) {
+		SmallVectorPush(&v, 10 + i);
+	}
+
+	check(v.cap == cap);
+	check(!Inline(&v));
+
+	for (size_t i = 0; i <= INLINE; i++) {
+		check(SmallVectorGet(&v, i) == 10 + i);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+int main(void)
+{
+	if (!ArenaInit(MiB(1))) {
+		fprintf(stderr, "cannot initialize arena\n");
+		return EXIT_FAILURE;
+	}
+
+	CheckExactlyInline();
+	CheckOnePastInline();
+	CheckSpilled();
+
+	ArenaFree();
+
+	return TestExit("vector");
+}